@@ -0,0 +1,38 @@
+#ifndef IMU_ALLOC_GUARD_H
+#define IMU_ALLOC_GUARD_H
+
+#include <stdint.h>
+
+// Checks that a section of code never allocates, compiled in with
+// `make ALLOC_GUARD=enabled` (-DIMU_ALLOC_GUARD). The build then replaces
+// operator new and, on glibc, malloc, calloc, realloc and memalign; an
+// allocation on a thread that is inside a guarded section prints what
+// allocated and aborts, so the core dump shows where. Without the flag the
+// macros expand to nothing.
+//
+//   ALLOC_GUARD_ARM();      // after warmup, before the steady-state loop
+//   ...
+//   ALLOC_GUARD_DISARM();
+//
+// Sections are per thread and nest; other threads allocate freely.
+
+#ifdef IMU_ALLOC_GUARD
+
+void allocGuardArm();
+void allocGuardDisarm();
+
+// allocations seen inside guarded sections (only ever 0 or 1, as the
+// first one aborts)
+uint64_t allocGuardViolations();
+
+#define ALLOC_GUARD_ARM() allocGuardArm()
+#define ALLOC_GUARD_DISARM() allocGuardDisarm()
+
+#else
+
+#define ALLOC_GUARD_ARM() do {} while (0)
+#define ALLOC_GUARD_DISARM() do {} while (0)
+
+#endif // IMU_ALLOC_GUARD
+
+#endif // IMU_ALLOC_GUARD_H
@@ -0,0 +1,111 @@
+#ifndef IMU_ASYNC_LOG_WRITER_H
+#define IMU_ASYNC_LOG_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "log_sink.h"
+
+// Moves file output off the acquisition thread.
+//
+// The producer copies bytes into one of a small set of preallocated,
+// page-aligned buffers. A full buffer is handed to a background thread that
+// writes it to the LogSink in one call, so a file grows in whole buffers
+// and every write but the last lands on a buffer-size aligned offset. The
+// producer never waits for the disk and never allocates; if the writer
+// thread falls so far behind that no buffer is free, the producer drops
+// the data and counts the overrun instead of blocking.
+//
+// write() is meant to be called from a single producer thread.
+class AsyncLogWriter
+{
+  public:
+
+    // buffer_size is rounded up to a multiple of the page size.
+    // buffer_count is at least 2 (double buffering); 3 absorbs longer stalls.
+    explicit AsyncLogWriter(size_t buffer_size = 64 * 1024, unsigned buffer_count = 3);
+    ~AsyncLogWriter();
+
+    // Creates (or truncates) path and starts the writer thread.
+    bool open(const char* path);
+
+    // Starts the writer thread on an opened sink, which must outlive
+    // close(). close() closes it.
+    bool open(LogSink* sink);
+
+    // Copies len bytes for the writer thread. A write is either queued whole
+    // or dropped whole, so fixed-size records are never split by an overrun.
+    // Returns false if it was dropped (overrun, len larger than a buffer, or
+    // not open).
+    bool write(const void* data, size_t len);
+
+    // Hands the partly filled buffer to the writer thread without waiting.
+    void flush();
+
+    // Ends the current segment: everything written so far goes to it and
+    // the next write() starts a new one (LogSink::nextSegment).
+    void endSegment();
+
+    // Flushes, waits for the writer thread to finish and closes the sink.
+    // Returns false if any write to the sink failed.
+    bool close();
+
+    bool isOpen() const
+    {
+        return sink_ != 0;
+    }
+
+    // A write to the sink has failed. The writer thread keeps taking
+    // buffers, so everything written after that is lost as well.
+    bool failed() const
+    {
+        return failed_.load(std::memory_order_relaxed);
+    }
+
+    // number of write() calls dropped because no buffer was free
+    uint64_t overruns() const
+    {
+        return overruns_;
+    }
+
+    uint64_t droppedBytes() const
+    {
+        return dropped_bytes_;
+    }
+
+  private:
+    void claim(uint64_t head);
+    void publish();
+    void run();
+
+    size_t buffer_size_;
+    unsigned buffer_count_;
+    char* memory_;                  // buffer_count_ buffers of buffer_size_
+    size_t* lengths_;               // bytes used in each buffer once published
+    bool* starts_;                  // buffer begins a new segment
+    FileSink file_;                 // the sink for open(path)
+    LogSink* sink_;
+    bool segment_pending_;          // the next buffer filled begins a new segment
+
+    // buffers [tail_, head_) (mod buffer_count_) are waiting for the writer;
+    // buffer head_ is the one the producer is filling
+    std::atomic<uint64_t> head_;
+    std::atomic<uint64_t> tail_;
+    size_t fill_;                   // bytes in the producer's buffer
+    bool stop_;
+    std::atomic<bool> failed_;
+    uint64_t overruns_;
+    uint64_t dropped_bytes_;
+
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::thread thread_;
+
+    AsyncLogWriter(const AsyncLogWriter&);
+    AsyncLogWriter& operator=(const AsyncLogWriter&);
+};
+
+#endif // IMU_ASYNC_LOG_WRITER_H
@@ -0,0 +1,56 @@
+#ifndef IMU_ATTITUDE_RESAMPLE_H
+#define IMU_ATTITUDE_RESAMPLE_H
+
+#include <cstddef>
+
+// A timestamped attitude track, one array per component (ImuFilter order:
+// q0 is the scalar part). Timestamps must be non-decreasing.
+struct AttitudeTrack
+{
+    size_t count;
+    const double* t;
+    const double* q0;
+    const double* q1;
+    const double* q2;
+    const double* q3;
+};
+
+// Interpolates an attitude track onto an arbitrary target time grid.
+//
+// The target grid must be non-decreasing too, which lets the resampler
+// walk both arrays with a cursor instead of searching for every target.
+// The cursor persists between calls, so a long target grid can be fed in
+// consecutive chunks against the same track. Targets before the first or
+// after the last sample hold the end sample.
+//
+// Interpolation is slerp along the shortest path. Neighbouring samples
+// of a densely sampled track are only a small angle apart, and there
+// normalised linear interpolation (nlerp) is indistinguishable from slerp
+// and needs no trigonometry, so those targets go through a vectorized
+// nlerp loop and only the rest through tf2::Quaternion::slerp.
+class AttitudeResampler
+{
+  public:
+
+    // max_nlerp_error is the largest angular deviation from true slerp,
+    // in radians, that the nlerp path may introduce.
+    explicit AttitudeResampler(double max_nlerp_error = 1e-9);
+
+    // Writes count_out interpolated quaternions for t_out[0..count_out).
+    // Returns false (and writes nothing) if the track is empty.
+    bool resample(const AttitudeTrack& track,
+                  size_t count_out, const double* t_out,
+                  double* q0_out, double* q1_out, double* q2_out, double* q3_out);
+
+    // restart from the beginning of the track, e.g. for a new target grid
+    void reset()
+    {
+        cursor_ = 0;
+    }
+
+  private:
+    double nlerp_min_dot_;  // |q_a . q_b| above which nlerp is used
+    size_t cursor_;         // index of the track sample at or before the last target
+};
+
+#endif // IMU_ATTITUDE_RESAMPLE_H
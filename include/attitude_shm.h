@@ -0,0 +1,80 @@
+#ifndef IMU_ATTITUDE_SHM_H
+#define IMU_ATTITUDE_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Latest attitude for other flight processes (pointing control, payload),
+// published in a POSIX shared memory segment under a seqlock: reading it
+// takes no system call and no lock, and the publisher never waits for a
+// reader.
+#define ATTITUDE_SHM_NAME "/imu_attitude"
+
+#define ATTITUDE_FLAG_VALID 0x0001      // the filter has processed at least one sample
+#define ATTITUDE_FLAG_WARM_START 0x0002 // the filter was restored from a snapshot
+#define ATTITUDE_FLAG_READ_ERROR 0x0004 // a register read failed for the last sample
+#define ATTITUDE_FLAG_STOPPED 0x0008    // the publisher has exited; the state is its last
+
+struct AttitudeState
+{
+    uint64_t t_ns;                  // CLOCK_MONOTONIC of the sample, comparable across processes
+    uint64_t sample;                // samples published so far
+    double q[4];                    // w, x, y, z, body to world frame
+    float rate[3];                  // calibrated body rates, rad/s
+    uint32_t flags;                 // ATTITUDE_FLAG_*
+};
+
+struct AttitudeShm;
+
+// The one process that writes the segment.
+class AttitudePublisher
+{
+  public:
+
+    AttitudePublisher();
+    ~AttitudePublisher();
+
+    // Creates (or takes over) the segment.
+    bool open(const char* name = ATTITUDE_SHM_NAME);
+
+    // Replaces the published state; a few stores, no system call.
+    void publish(const AttitudeState& state);
+
+    // Republishes the last state with ATTITUDE_FLAG_STOPPED and unmaps the
+    // segment. The segment itself stays so that readers keep working.
+    void close();
+
+  private:
+    AttitudeShm* shm_;
+    AttitudeState last_;
+
+    AttitudePublisher(const AttitudePublisher&);
+    AttitudePublisher& operator=(const AttitudePublisher&);
+};
+
+// Any number of readers, in any process.
+class AttitudeSubscriber
+{
+  public:
+
+    AttitudeSubscriber();
+    ~AttitudeSubscriber();
+
+    // Maps the segment read-only. Fails until a publisher has created it.
+    bool open(const char* name = ATTITUDE_SHM_NAME);
+
+    // Copies a consistent snapshot of the latest state. Returns false if
+    // nothing has been published yet, or if the publisher kept rewriting
+    // the state through every retry (or died in the middle of a write).
+    bool read(AttitudeState& state) const;
+
+    void close();
+
+  private:
+    const AttitudeShm* shm_;
+
+    AttitudeSubscriber(const AttitudeSubscriber&);
+    AttitudeSubscriber& operator=(const AttitudeSubscriber&);
+};
+
+#endif // IMU_ATTITUDE_SHM_H
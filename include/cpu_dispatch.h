@@ -0,0 +1,36 @@
+#ifndef IMU_CPU_DISPATCH_H
+#define IMU_CPU_DISPATCH_H
+
+// Instruction set levels the batch kernels of dsp_kernels.h are compiled
+// for. x86 builds carry every x86 level and use the best one the CPU has,
+// so one x86_64.gcc binary is fast on any ground machine without a
+// rebuild. ARM builds have the single level their BUILD_CONFIG targets.
+enum CpuIsa
+{
+    ISA_SCALAR,                     // no vector unit (x86_32 without SSE2, ARM without NEON)
+    ISA_SSE2,                       // the x86_64 baseline
+    ISA_AVX2,
+    ISA_AVX512,                     // AVX-512F
+    ISA_NEON,                       // aarch64, or 32-bit ARM built with -mfpu=neon
+    ISA_COUNT
+};
+
+// The level the kernels use, chosen by the first call: the best one the
+// CPU and the build support, or a lower one named by the IMU_ISA
+// environment variable ("sse2", "avx2", ...).
+CpuIsa cpuIsa();
+
+// whether this build has kernels for isa and the CPU can run them
+bool cpuSupports(CpuIsa isa);
+
+// Makes the kernels use isa, to compare levels in benchmarks and checks.
+// Returns false, changing nothing, if isa is not supported. Call it
+// before starting threads that use the kernels.
+bool setCpuIsa(CpuIsa isa);
+
+const char* cpuIsaName(CpuIsa isa);
+
+// ISA_COUNT if name is not a level
+CpuIsa parseCpuIsa(const char* name);
+
+#endif // IMU_CPU_DISPATCH_H
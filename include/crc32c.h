@@ -0,0 +1,15 @@
+#ifndef IMU_CRC32C_H
+#define IMU_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32C (Castagnoli, the CRC of iSCSI and ext4 metadata). Calls chain:
+// crc32c(b, nb, crc32c(a, na)) is the CRC of a followed by b.
+//
+// Uses the SSE4.2 crc32 instruction when the CPU has it and the ARMv8 CRC
+// instructions when the build targets them (-march=armv8-a+crc), a
+// slicing-by-8 table otherwise.
+uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0);
+
+#endif // IMU_CRC32C_H
@@ -0,0 +1,63 @@
+#ifndef IMU_CSV_READER_H
+#define IMU_CSV_READER_H
+
+#include <stddef.h>
+#include <vector>
+
+// One column to extract from a CSV file: the header names it may appear
+// under and the array its values are appended to.
+struct CsvColumn
+{
+    const char* const* names;       // 0-terminated list; "*suffix" matches any header ending in suffix
+    bool required;                  // findHeader() fails if the column is missing
+    std::vector<float>* out;        // exactly one of out and out_double is set
+    std::vector<double>* out_double;
+    int field;                      // set by findHeader(), -1 if the column is absent
+};
+
+// Columnar reader for large CSV captures (our imu_data*.csv files, IMUv2
+// and Shimmer exports).
+//
+// The file is mapped rather than read, and the numeric fields of the
+// requested columns are parsed in place straight into one array per
+// column; nothing is copied into intermediate strings. Fields are parsed
+// with an exact fast path for the short decimals these files contain,
+// falling back to strtod for anything else.
+class CsvReader
+{
+  public:
+
+    CsvReader();
+    ~CsvReader();
+
+    // Maps path. Returns false if it cannot be opened or is empty.
+    bool open(const char* path);
+
+    void close();
+
+    // Finds the header: the first line that names every required column.
+    // Lines before it (e.g. a "sep=," preamble) are skipped. Resolves the
+    // field index of every column and leaves the reader on the next line.
+    bool findHeader(CsvColumn* columns, size_t count);
+
+    // Parses every remaining line into the columns found by findHeader().
+    // A line is skipped if any present column is missing or not a number
+    // (e.g. the units line of a Shimmer export). Returns the number of
+    // rows appended.
+    size_t readRows(const CsvColumn* columns, size_t count);
+
+    size_t fileSize() const
+    {
+        return size_;
+    }
+
+  private:
+    const char* data_;
+    size_t size_;
+    const char* pos_;
+
+    CsvReader(const CsvReader&);
+    CsvReader& operator=(const CsvReader&);
+};
+
+#endif // IMU_CSV_READER_H
@@ -0,0 +1,49 @@
+#ifndef IMU_DSP_KERNELS_H
+#define IMU_DSP_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flight_log.h"
+#include "world_frame.h"
+
+// Batch kernels of the host tools and benchmarks. Each is compiled once
+// per instruction set level of cpu_dispatch.h and calls go to the variant
+// for cpuIsa(). Every variant gives bit-identical results: none of them
+// contracts multiply-adds into FMAs, so a sweep or a regression run prints
+// the same numbers on every machine.
+
+// out[i] = raw[i] * scale, raw counts to physical units.
+void scaleRaw(size_t n, const int16_t* __restrict raw, float scale, float* __restrict out);
+
+// Flight log records to physical units, column by column: seconds, g, and
+// deg/s times gyro_unit, the same values FlightLogReader::time(), accel()
+// and gyro() give.
+void convertRecords(size_t n, const FlightLogRecord* records, const FlightLogHeader& header,
+                    float gyro_unit, double* t, float* ax, float* ay, float* az,
+                    float* gx, float* gy, float* gz);
+
+// Running median over MEDIAN_WINDOW (sample_filters.h): out[i] is the
+// median of in[i] .. in[i + MEDIAN_WINDOW - 1], for the n - MEDIAN_WINDOW
+// + 1 full windows of in. The same values as MedianWindow::median().
+void medianFilter(size_t n, const float* in, float* out);
+
+// ImuFilter::madgwickAHRSupdateIMU for a bank of filters that see the same
+// samples: lane k has algorithm gain gain[k] and orientation q0[k] ..
+// q3[k], all lanes the same world frame. The state is stored lane by lane
+// so that the update vectorizes across the filters. Each lane follows an
+// ImuFilter with the same settings, bit for bit where ImuFilter itself is
+// built without multiply-add contraction (x86).
+void filterBankUpdateIMU(size_t lanes, double* q0, double* q1, double* q2, double* q3,
+                         const double* gain, WorldFrame::WorldFrame frame,
+                         float gx, float gy, float gz, float ax, float ay, float az, float dt);
+
+// Attitude error statistics of a filter bank: the angle in degrees between
+// each lane's orientation, normalised like ImuFilter::getOrientation(), and
+// the truth t0 .. t3 is stored in last[k] and added to sum[k], sum_sq[k]
+// and max[k]. A non-finite angle counts as 180 degrees.
+void accumulateAngleError(size_t lanes, const double* q0, const double* q1,
+                          const double* q2, const double* q3,
+                          double t0, double t1, double t2, double t3,
+                          double* sum, double* sum_sq, double* max, double* last);
+
+#endif // IMU_DSP_KERNELS_H
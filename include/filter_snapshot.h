@@ -0,0 +1,45 @@
+#ifndef IMU_FILTER_SNAPSHOT_H
+#define IMU_FILTER_SNAPSHOT_H
+
+#include <stdint.h>
+#include "imu_filter.h"
+
+#define FILTER_SNAPSHOT_VERSION 1
+
+// Everything needed to resume attitude estimation after a processor reset
+// without reconverging from identity.
+struct FilterSnapshot
+{
+    uint64_t timestamp_ns;          // CLOCK_REALTIME when the snapshot was taken
+    double gain;
+    double zeta;
+    WorldFrame::WorldFrame frame;
+    double q0, q1, q2, q3;
+    float w_bx, w_by, w_bz;         // gyro drift bias, rad/s
+};
+
+void captureSnapshot(ImuFilter& filter, FilterSnapshot& snapshot);
+
+// Restores the state only: orientation and gyro drift bias. The filter
+// keeps the gain, zeta and world frame it was configured with; the
+// snapshot's copies of them are for warmStart to check against.
+void restoreSnapshot(const FilterSnapshot& snapshot, ImuFilter& filter);
+
+// Writes the snapshot to path through a temporary file and rename(), so a
+// reset in the middle of a write leaves the previous snapshot intact, and
+// syncs the directory so the rename itself survives a reset. Blocks on the
+// disk: the flight loop hands snapshots to a housekeeping thread for this.
+bool saveSnapshot(const char* path, const FilterSnapshot& snapshot);
+
+// Reads and validates (magic, version, length, checksum) a snapshot.
+// Returns false if the file is missing, truncated or corrupt.
+bool loadSnapshot(const char* path, FilterSnapshot& snapshot);
+
+// Loads the snapshot at path into filter if it is valid, at most max_age_s
+// old and taken in the world frame filter is configured for (an
+// orientation in another frame is meaningless to it). A snapshot dated
+// after the current time is refused: the clock has been reset since it was
+// taken, so its age is unknown. Leaves filter untouched otherwise.
+bool warmStart(const char* path, double max_age_s, ImuFilter& filter);
+
+#endif // IMU_FILTER_SNAPSHOT_H
@@ -0,0 +1,303 @@
+#ifndef IMU_FLIGHT_LOG_H
+#define IMU_FLIGHT_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "async_log_writer.h"
+#include "ring_storage.h"
+
+#define FLIGHT_LOG_MAGIC "IMUL"
+#define FLIGHT_LOG_VERSION 2
+
+// A flight log is one FlightLogHeader followed by FlightLogBlocks of
+// FLIGHT_LOG_BLOCK_SIZE bytes, little endian (every supported BUILD_CONFIG
+// is), in the same layout as the structs below so that a reader can use
+// the mapped file directly. Every block but the last in a file is full, so
+// record i is always at the same place.
+//
+// A block carries its record count, a sequence number and a CRC32C. It is
+// queued whole, but the 64-byte header keeps blocks off the boundaries of
+// the writer's buffers, so one block may reach the file in two writes; a
+// block torn by a power loss is recognised by its CRC all the same: the
+// reader ends the log at the last block whose CRC checks out, found by
+// stepping back from the end of the file.
+
+// Everything needed to turn the raw counts in the records into physical
+// units, plus the ICM-20602 register configuration they were taken with.
+struct FlightLogHeader
+{
+    char magic[4];                  // FLIGHT_LOG_MAGIC
+    uint16_t version;               // FLIGHT_LOG_VERSION
+    uint16_t header_size;           // sizeof(FlightLogHeader)
+    uint16_t record_size;           // sizeof(FlightLogRecord)
+    uint16_t sample_rate_hz;        // nominal, 0 if free running
+    uint32_t segment;               // sequence number within a RingStorage, 0 for a single file
+    uint64_t start_ns;              // CLOCK_REALTIME when the log was opened
+    float accel_scale;              // g per LSB
+    float gyro_scale;               // deg/s per LSB
+    float temp_scale;               // degC per LSB
+    float temp_offset;              // degC at a reading of 0
+    uint8_t smplrt_div;             // register 0x19
+    uint8_t config;                 // register 0x1A (DLPF)
+    uint8_t gyro_config;            // register 0x1B
+    uint8_t accel_config;           // register 0x1C
+    uint8_t accel_config2;          // register 0x1D
+    uint8_t reserved1[19];
+};
+
+// Counts at full scale: accel_scale is the AFS_SEL range over
+// FLIGHT_LOG_ACCEL_COUNTS and gyro_scale the FS_SEL range over
+// FLIGHT_LOG_GYRO_COUNTS, as the flight software has always written them.
+// The simulator quantizes with the same values, so its logs decode alike.
+#define FLIGHT_LOG_ACCEL_COUNTS 32768.0
+#define FLIGHT_LOG_GYRO_COUNTS 32767.0
+
+// One sample exactly as read from the sensor registers.
+struct FlightLogRecord
+{
+    uint64_t t_ns;                  // CLOCK_MONOTONIC since FlightLogHeader::start_ns
+    int16_t accel[3];
+    int16_t gyro[3];
+    int16_t temp;
+    uint16_t flags;                 // FLIGHT_LOG_FLAG_*
+};
+
+#define FLIGHT_LOG_FLAG_READ_ERROR 0x0001   // a register read failed; the sample is not valid
+
+#define FLIGHT_LOG_BLOCK_MAGIC "IMUB"
+#define FLIGHT_LOG_BLOCK_SIZE 4096
+#define FLIGHT_LOG_BLOCK_RECORDS 170
+
+struct FlightLogBlockHeader
+{
+    char magic[4];                  // FLIGHT_LOG_BLOCK_MAGIC
+    uint32_t sequence;              // blocks written before this one, counted across ring segments
+    uint16_t count;                 // records in the block
+    uint16_t reserved;
+    uint32_t crc;                   // crc32c of the fields above and the records
+};
+
+struct FlightLogBlock
+{
+    FlightLogBlockHeader header;
+    FlightLogRecord records[FLIGHT_LOG_BLOCK_RECORDS];
+};
+
+// A log at path is accompanied by a sparse time index at path + ".idx":
+// a FlightLogIndexHeader, then one entry for every interval-th record
+// written. It lets a reader find a time in a multi-day log by touching a
+// couple of pages instead of searching the whole file.
+#define FLIGHT_LOG_INDEX_MAGIC "IMUI"
+#define FLIGHT_LOG_INDEX_SUFFIX ".idx"
+#define FLIGHT_LOG_INDEX_VERSION 1
+#define FLIGHT_LOG_INDEX_INTERVAL 1024
+#define FLIGHT_LOG_WAIT_MS 10000            // appendWaiting() and close() give up on a writer stalled this long
+
+struct FlightLogIndexHeader
+{
+    char magic[4];                  // FLIGHT_LOG_INDEX_MAGIC
+    uint16_t version;               // FLIGHT_LOG_INDEX_VERSION
+    uint16_t entry_size;            // sizeof(FlightLogIndexEntry)
+    uint32_t interval;              // records between entries
+    uint32_t reserved;
+};
+
+struct FlightLogIndexEntry
+{
+    uint64_t t_ns;                  // FlightLogRecord::t_ns of the record
+    uint64_t record;                // its position in the log
+};
+
+static_assert(sizeof(FlightLogHeader) == 64, "flight log header layout changed");
+static_assert(sizeof(FlightLogRecord) == 24, "flight log record layout changed");
+static_assert(sizeof(FlightLogBlockHeader) == 16, "flight log block header layout changed");
+static_assert(sizeof(FlightLogBlock) == FLIGHT_LOG_BLOCK_SIZE, "flight log block layout changed");
+static_assert(sizeof(FlightLogIndexHeader) == 16, "flight log index header layout changed");
+static_assert(sizeof(FlightLogIndexEntry) == 16, "flight log index entry layout changed");
+
+// Fills the magic, version and sizes of header and zeroes everything else.
+void initFlightLogHeader(FlightLogHeader& header);
+
+// Appends records to a new flight log and its time index. Records are
+// collected into a block, and a full block goes to an AsyncLogWriter
+// thread, so append() is a copy and never waits for the disk; records it
+// has to drop because the writer fell behind are counted in overruns().
+// Record timestamps must not decrease.
+class FlightLogWriter
+{
+  public:
+
+    FlightLogWriter();
+    ~FlightLogWriter();
+
+    // Creates (or truncates) path and writes header. The index is written
+    // alongside unless index is false. Returns false if the log cannot be
+    // created; a missing index only costs readers the fast seek.
+    bool open(const char* path, const FlightLogHeader& header, bool index = true);
+
+    // Writes into the segments of ring instead, which must be open and
+    // outlive close(). Each segment is a complete flight log: a copy of
+    // header, with FlightLogHeader::segment numbering the segments, and as
+    // many records as fit in ring.segmentBytes(). Segments have no index.
+    bool open(RingStorage& ring, const FlightLogHeader& header);
+
+    // Returns false if the record was dropped. A full block the writer
+    // thread had no room for is kept and offered again with the next
+    // append(), which drops its own record until the block is taken.
+    bool append(const FlightLogRecord& record);
+
+    // Like append(), but waits for the writer thread instead of dropping
+    // the record, for tools that write a whole log at once. Returns false
+    // if the writer has failed or made no room for FLIGHT_LOG_WAIT_MS.
+    bool appendWaiting(const FlightLogRecord& record);
+
+    // Hands the full blocks to the writer thread. The block being filled
+    // is only written once it is full, or by close() as the last block.
+    void flush();
+
+    // Writes out everything appended so far and closes the file. Returns
+    // false if a write to the file failed.
+    bool close();
+
+    bool isOpen() const
+    {
+        return out_.isOpen();
+    }
+
+    // a write to the file has failed; nothing appended since is kept
+    bool failed() const
+    {
+        return out_.failed();
+    }
+
+    // sequence number of the ring segment being appended to
+    uint32_t segment() const
+    {
+        return header_.segment;
+    }
+
+    // number of records dropped because the writer thread fell behind
+    uint64_t overruns() const
+    {
+        return dropped_;
+    }
+
+  private:
+    bool writeBlock();
+    bool waitBlock();
+
+    AsyncLogWriter out_;
+    AsyncLogWriter index_;
+    uint64_t records_;              // records written so far
+    FlightLogHeader header_;        // header of the segment being written
+    bool header_pending_;           // header_ still has to be written
+    uint64_t segment_blocks_;       // blocks per ring segment, 0 for a single file
+    uint64_t segment_fill_;         // blocks in the segment being written
+    FlightLogBlock block_;          // the block being filled
+    uint32_t sequence_;             // blocks written
+    uint64_t dropped_;
+
+    FlightLogWriter(const FlightLogWriter&);
+    FlightLogWriter& operator=(const FlightLogWriter&);
+};
+
+// Maps a flight log read-only. The records are used in place, without a
+// copy, for as long as the reader is open.
+class FlightLogReader
+{
+  public:
+
+    FlightLogReader();
+    ~FlightLogReader();
+
+    // Maps path and validates its header, and maps the time index next to
+    // it if there is one. The log ends at the last block that passes its
+    // CRC check; only the blocks after it are read for that. Returns false
+    // if the log cannot be mapped or is not a flight log.
+    bool open(const char* path);
+
+    void close();
+
+    const FlightLogHeader& header() const
+    {
+        return *header_;
+    }
+
+    size_t size() const
+    {
+        return count_;
+    }
+
+    const FlightLogRecord& operator[](size_t i) const
+    {
+        return blocks_[i / FLIGHT_LOG_BLOCK_RECORDS].records[i % FLIGHT_LOG_BLOCK_RECORDS];
+    }
+
+    // blocks in the log and block k's frame
+    size_t blockCount() const
+    {
+        return block_count_;
+    }
+
+    const FlightLogBlockHeader& block(size_t k) const
+    {
+        return blocks_[k].header;
+    }
+
+    // Recomputes the CRC of block k, which open() only does for the last.
+    bool checkBlock(size_t k) const;
+
+    // bytes at the end of the file that are not part of the log: a torn
+    // or unwritten tail left by a power loss
+    size_t tornBytes() const
+    {
+        return torn_bytes_;
+    }
+
+    // First record with t_ns >= t_ns (size() if there is none), found by
+    // binary search: within one index interval if the log has an index,
+    // over the whole log otherwise.
+    size_t lowerBound(uint64_t t_ns) const;
+
+    // Records [begin, end) with from_ns <= t_ns < to_ns.
+    void range(uint64_t from_ns, uint64_t to_ns, size_t& begin, size_t& end) const
+    {
+        begin = lowerBound(from_ns);
+        end = lowerBound(to_ns);
+        if (end < begin) end = begin;
+    }
+
+    bool hasIndex() const
+    {
+        return index_count_ > 0;
+    }
+
+    // record i in physical units: g, deg/s, degC, seconds since start
+    void accel(size_t i, float& x, float& y, float& z) const;
+    void gyro(size_t i, float& x, float& y, float& z) const;
+    float temperature(size_t i) const;
+    double time(size_t i) const;
+
+  private:
+    void* map_;
+    size_t map_size_;
+    const FlightLogHeader* header_;
+    const FlightLogBlock* blocks_;
+    size_t block_count_;
+    size_t count_;
+    size_t torn_bytes_;
+    void* index_map_;
+    size_t index_map_size_;
+    const FlightLogIndexEntry* index_;
+    size_t index_count_;
+
+    void openIndex(const char* path);
+
+    FlightLogReader(const FlightLogReader&);
+    FlightLogReader& operator=(const FlightLogReader&);
+};
+
+// Tells whether path starts with the flight log magic.
+bool isFlightLog(const char* path);
+
+#endif // IMU_FLIGHT_LOG_H
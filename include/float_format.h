@@ -0,0 +1,21 @@
+#ifndef IMU_FLOAT_FORMAT_H
+#define IMU_FLOAT_FORMAT_H
+
+// Shortest round-trip formatting of floating point numbers.
+//
+// Writes the shortest decimal that strtof/strtod (and CsvReader) read back
+// as exactly v, without a terminator, and returns the end of it. Numbers
+// with a decimal exponent in [-4, 15) are written in fixed notation
+// ("0.0123", "1500"), others in exponent notation ("1.5e-07"); nan and
+// infinities as "nan", "inf", "-inf". At most FLOAT_FORMAT_MAX chars.
+//
+// Uses Grisu2 (Loitsch, "Printing floating-point numbers quickly and
+// accurately with integers"), which needs only 64-bit integer arithmetic
+// and always round-trips; about one value in 500 gets one digit more
+// than the shortest.
+#define FLOAT_FORMAT_MAX 32
+
+char* formatFloat(char* p, float v);
+char* formatDouble(char* p, double v);
+
+#endif // IMU_FLOAT_FORMAT_H
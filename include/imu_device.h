@@ -0,0 +1,157 @@
+#ifndef IMU_DEVICE_H
+#define IMU_DEVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flight_log.h"
+#include "tumble_sim.h"
+
+// ICM-20602 registers used by the flight software
+#define ICM_SMPLRT_DIV 0x19
+#define ICM_CONFIG 0x1A
+#define ICM_GYRO_CONFIG 0x1B
+#define ICM_ACCEL_CONFIG 0x1C
+#define ICM_ACCEL_CONFIG2 0x1D
+#define ICM_ACCEL_XOUT_H 0x3B           // accel X, Y, Z, temp, gyro X, Y, Z: big-endian pairs
+#define ICM_TEMP_OUT_H 0x41
+#define ICM_GYRO_XOUT_H 0x43
+#define ICM_GYRO_ZOUT_L 0x48
+#define ICM_REGISTERS 0x80
+
+// The IMU as the acquisition loop sees it: a bank of ICM-20602 registers.
+// SidekiqDevice reaches the real sensor through libsidekiq; ReplayDevice
+// and SyntheticDevice present the same registers on a workstation, so the
+// loop, its logging and its filters run unchanged without the hardware.
+class ImuDevice
+{
+  public:
+    virtual ~ImuDevice() {}
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+
+    // len consecutive registers starting at reg. Returns false if the
+    // transfer failed.
+    virtual bool readRegisters(uint8_t reg, uint8_t* data, size_t len) = 0;
+    virtual bool writeRegisters(uint8_t reg, const uint8_t* data, size_t len) = 0;
+
+    // True once the device has no more samples (the end of a replay); the
+    // output registers then fail to read.
+    virtual bool finished() const
+    {
+        return false;
+    }
+
+    // one register, 0 if it could not be read
+    uint8_t readRegister(uint8_t reg)
+    {
+        uint8_t value = 0;
+        readRegisters(reg, &value, 1);
+        return value;
+    }
+};
+
+// The sensor on a Sidekiq card. open() initialises libsidekiq for the
+// card, close() releases it.
+class SidekiqDevice : public ImuDevice
+{
+  public:
+    explicit SidekiqDevice(uint8_t card = 0) : card_(card), open_(false) {}
+    ~SidekiqDevice();
+
+    bool open();
+    void close();
+    bool readRegisters(uint8_t reg, uint8_t* data, size_t len);
+    bool writeRegisters(uint8_t reg, const uint8_t* data, size_t len);
+
+  private:
+    uint8_t card_;
+    bool open_;
+
+    SidekiqDevice(const SidekiqDevice&);
+    SidekiqDevice& operator=(const SidekiqDevice&);
+};
+
+// An emulated ICM-20602 register file, the base of the host backends.
+// A read that covers ACCEL_XOUT_H latches the next sample into the output
+// registers, the way a new sample appears on the sensor between two reads
+// of the loop; the other registers read back what was last written.
+class EmulatedDevice : public ImuDevice
+{
+  public:
+    EmulatedDevice();
+
+    bool readRegisters(uint8_t reg, uint8_t* data, size_t len);
+    bool writeRegisters(uint8_t reg, const uint8_t* data, size_t len);
+    bool finished() const
+    {
+        return finished_;
+    }
+
+  protected:
+    // The next sample's raw outputs. Returns false if there is none
+    // (finished) or, with finished still false, if it is a read error.
+    virtual bool nextSample(FlightLogRecord& record) = 0;
+
+    void setRegister(uint8_t reg, uint8_t value)
+    {
+        registers_[reg & (ICM_REGISTERS - 1)] = value;
+    }
+
+    bool finished_;
+
+  private:
+    void latch();
+
+    uint8_t registers_[ICM_REGISTERS];
+    bool valid_;                    // the latched sample can be read
+
+    EmulatedDevice(const EmulatedDevice&);
+    EmulatedDevice& operator=(const EmulatedDevice&);
+};
+
+// Replays a flight log at the speed the loop reads it. The configuration
+// registers hold the values recorded in its header, and samples flagged
+// as read errors fail to read again.
+class ReplayDevice : public EmulatedDevice
+{
+  public:
+    explicit ReplayDevice(const char* path) : path_(path), next_(0) {}
+
+    bool open();
+    void close();
+
+  protected:
+    bool nextSample(FlightLogRecord& record);
+
+  private:
+    const char* path_;
+    FlightLogReader log_;
+    size_t next_;
+};
+
+// An endless tumbling CubeSat from TumbleSim, with the configuration
+// registers set to its full scale ranges and sample rate.
+class SyntheticDevice : public EmulatedDevice
+{
+  public:
+    explicit SyntheticDevice(const TumbleConfig& config) : config_(config), sim_(0) {}
+    ~SyntheticDevice();
+
+    bool open();
+    void close();
+
+  protected:
+    bool nextSample(FlightLogRecord& record);
+
+  private:
+    TumbleConfig config_;
+    TumbleSim* sim_;
+};
+
+// The host backend named by spec: "replay:<flight.log>" or
+// "synthetic[:<seed>]". Returns 0 for anything else. The device is not
+// opened yet, and keeps pointing into spec.
+ImuDevice* createHostDevice(const char* spec);
+
+#endif // IMU_DEVICE_H
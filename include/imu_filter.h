@@ -62,6 +62,21 @@ public:
         world_frame_ = frame;
     }
 
+    double getAlgorithmGain() const
+    {
+        return gain_;
+    }
+
+    double getDriftBiasGain() const
+    {
+        return zeta_;
+    }
+
+    WorldFrame::WorldFrame getWorldFrame() const
+    {
+        return world_frame_;
+    }
+
     void getOrientation(double& q0, double& q1, double& q2, double& q3)
     {
         q0 = this->q0;
@@ -91,6 +106,22 @@ public:
         w_bz_ = 0;
     }
 
+    // gyro drift bias estimated by madgwickAHRSupdate, in rad/s
+    void getDriftBias(float& w_bx, float& w_by, float& w_bz) const
+    {
+        w_bx = w_bx_;
+        w_by = w_by_;
+        w_bz = w_bz_;
+    }
+
+    // must be called after setOrientation(), which resets the bias
+    void setDriftBias(float w_bx, float w_by, float w_bz)
+    {
+        w_bx_ = w_bx;
+        w_by_ = w_by;
+        w_bz_ = w_bz;
+    }
+
     void madgwickAHRSupdate(float gx, float gy, float gz,
                             float ax, float ay, float az,
                             float mx, float my, float mz,
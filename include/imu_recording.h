@@ -0,0 +1,43 @@
+#ifndef IMU_RECORDING_H
+#define IMU_RECORDING_H
+
+#include <cstddef>
+#include <vector>
+
+// A recorded capture held entirely in memory, column by column, so that it
+// can be replayed through any number of filter configurations without
+// going back to the disk.
+struct ImuRecording
+{
+    std::vector<double> t;              // seconds, empty if the file has no time column
+    std::vector<float> ax, ay, az;      // accelerometer, any unit (the filter normalises)
+    std::vector<float> gx, gy, gz;      // gyroscope, rad/s
+    std::vector<float> mx, my, mz;      // magnetometer, any unit, empty if not recorded
+    std::vector<float> q0, q1, q2, q3;  // truth orientation, empty if not recorded
+
+    size_t size() const { return ax.size(); }
+    bool hasTime() const { return !t.empty(); }
+    bool hasTruth() const { return !q0.empty(); }
+    bool hasMag() const { return !mx.empty(); }
+
+    // time step between sample i-1 and i, or fallback_dt without a time column
+    float dt(size_t i, float fallback_dt) const
+    {
+        if (t.empty() || i == 0) return fallback_dt;
+        return (float)(t[i] - t[i - 1]);
+    }
+};
+
+// Loads a capture into rec. Columns are resolved by header name so both
+// our own imu_data*.csv files ("Median Accel X", "Raw Gyro X", ...) and
+// Shimmer exports ("..._Accel_LN_X_CAL", "..._Gyro_X_CAL") are understood.
+// Optional columns are "Time" (seconds), "Mag X".."Mag Z" and
+// "Truth Q0".."Truth Q3".
+// Binary flight logs (flight_log.h) are recognised by their magic and
+// loaded in g and deg/s, skipping samples flagged as read errors.
+// gyro_scale converts the recorded gyro unit to rad/s.
+// Returns false if the file cannot be read or lacks accel/gyro columns.
+bool loadImuRecording(const char* path, ImuRecording& rec,
+                      float gyro_scale = 3.14159265358979f / 180.0f);
+
+#endif // IMU_RECORDING_H
@@ -0,0 +1,91 @@
+#ifndef IMU_LATENCY_HISTOGRAM_H
+#define IMU_LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+// Log-linear (HDR style) histogram of latencies in nanoseconds: every
+// power of two is split into LATENCY_SUB_BUCKETS linear buckets, so any
+// value from 1 ns to about 18 minutes is counted with a relative error
+// below 1/32 in a fixed 9 KiB table. record() is a few instructions and
+// never allocates, so it can sit on the acquisition thread.
+//
+// record() is meant to be called from a single thread. The counters are
+// atomics so that another thread may read them at any time (e.g. to dump
+// them on a signal); such a reader sees each counter whole, though not
+// necessarily all of them at the same instant.
+#define LATENCY_SUB_BITS 5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BITS 40             // values from 2^40 ns on go into the last bucket
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+class LatencyHistogram
+{
+  public:
+
+    LatencyHistogram();
+
+    void record(uint64_t ns)
+    {
+      if (ns >= (1ull << LATENCY_MAX_BITS)) ns = (1ull << LATENCY_MAX_BITS) - 1;
+      bump(counts_[bucket(ns)]);
+      bump(count_);
+      sum_.store(sum_.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+      if (ns > max_.load(std::memory_order_relaxed)) max_.store(ns, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const
+    {
+      return count_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t max() const
+    {
+      return max_.load(std::memory_order_relaxed);
+    }
+
+    double mean() const;
+
+    // The smallest value that at least fraction p (0..1) of the recorded
+    // values do not exceed, rounded up to the top of its bucket so that it
+    // never understates a latency. 0 if nothing was recorded.
+    uint64_t percentile(double p) const;
+
+    // number of recorded values above the bucket holding ns, i.e. above ns
+    // give or take the bucket width
+    uint64_t countAbove(uint64_t ns) const;
+
+    // One line: count, p50, p99, p99.9, max and mean in microseconds.
+    void print(FILE* out, const char* name) const;
+
+    // Only while no thread is recording.
+    void reset();
+
+    static size_t bucket(uint64_t ns)
+    {
+      if (ns < LATENCY_SUB_BUCKETS) return (size_t)ns;
+      unsigned shift = 63 - __builtin_clzll(ns) - LATENCY_SUB_BITS;
+      return (size_t)shift * LATENCY_SUB_BUCKETS + (size_t)(ns >> shift);
+    }
+
+    // largest value counted in bucket b
+    static uint64_t bucketTop(size_t b);
+
+  private:
+    static void bump(std::atomic<uint64_t>& counter)
+    {
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts_[LATENCY_BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+
+    LatencyHistogram(const LatencyHistogram&);
+    LatencyHistogram& operator=(const LatencyHistogram&);
+};
+
+#endif // IMU_LATENCY_HISTOGRAM_H
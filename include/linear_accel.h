@@ -0,0 +1,78 @@
+#ifndef IMU_LINEAR_ACCEL_H
+#define IMU_LINEAR_ACCEL_H
+
+#include <cstddef>
+#include "world_frame.h"
+
+// A batch of orientation + accelerometer samples, stored as separate
+// arrays (structure of arrays) so the gravity removal loop vectorizes.
+// Orientations use the ImuFilter convention; accelerations are specific
+// force in m/s^2 as the accelerometer reports it (+g "up" at rest).
+// Any output pointer may be null to skip that output. Arrays must not
+// overlap.
+struct LinearAccelBatch
+{
+    size_t count;
+    const float* q0;
+    const float* q1;
+    const float* q2;
+    const float* q3;
+    const float* ax;
+    const float* ay;
+    const float* az;
+    float* body_x;      // linear acceleration in the sensor frame
+    float* body_y;
+    float* body_z;
+    float* world_x;     // linear acceleration in the world frame
+    float* world_y;
+    float* world_z;
+};
+
+// Batch equivalent of subtracting ImuFilter::getGravity() from every sample.
+void removeGravity(const LinearAccelBatch& batch, WorldFrame::WorldFrame frame,
+                   float gravity = 9.80665f);
+
+// Integrates world-frame linear acceleration into velocity and position.
+// Plain integration drifts without bound on any accelerometer bias, so two
+// optional bounds are provided: a leak that decays velocity and position
+// towards zero with the given time constant (a first order high-pass), and
+// a clamp on the magnitude of each velocity component.
+class LinearAccelIntegrator
+{
+  public:
+
+    LinearAccelIntegrator(float time_constant = 0.0f, float max_velocity = 0.0f);
+
+    void reset();
+
+    // Any of the velocity / position output arrays may be null.
+    void integrate(size_t count, const float* wx, const float* wy, const float* wz,
+                   float dt,
+                   float* vx, float* vy, float* vz,
+                   float* px, float* py, float* pz);
+
+    // The same with the time step of every sample, dt[i] being the time
+    // since sample i - 1, for recordings with a time column (jitter, gaps).
+    void integrate(size_t count, const float* wx, const float* wy, const float* wz,
+                   const float* dt,
+                   float* vx, float* vy, float* vz,
+                   float* px, float* py, float* pz);
+
+    void getVelocity(float& vx, float& vy, float& vz) const
+    {
+        vx = v_[0]; vy = v_[1]; vz = v_[2];
+    }
+
+    void getPosition(float& px, float& py, float& pz) const
+    {
+        px = p_[0]; py = p_[1]; pz = p_[2];
+    }
+
+  private:
+    float time_constant_;   // seconds, 0 disables the leak
+    float max_velocity_;    // m/s, 0 disables the clamp
+    float v_[3];
+    float p_[3];
+};
+
+#endif // IMU_LINEAR_ACCEL_H
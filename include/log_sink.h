@@ -0,0 +1,54 @@
+#ifndef IMU_LOG_SINK_H
+#define IMU_LOG_SINK_H
+
+#include <stddef.h>
+
+// Destination of the bytes an AsyncLogWriter thread writes out. All calls
+// come from the writer thread.
+class LogSink
+{
+  public:
+
+    virtual ~LogSink() {}
+
+    // Appends len bytes. Returns false on a write error.
+    virtual bool write(const void* data, size_t len) = 0;
+
+    // Called before the first write of a new segment (see
+    // AsyncLogWriter::endSegment); sinks without segments ignore it.
+    // Returns false on an error; a sink with no room for the segment may
+    // instead drop it and return true, since a false return (like one
+    // from write) fails the writer for good.
+    virtual bool nextSegment()
+    {
+        return true;
+    }
+
+    virtual bool close() = 0;
+};
+
+// A single file that grows without bound.
+class FileSink : public LogSink
+{
+  public:
+
+    FileSink();
+    ~FileSink();
+
+    // Creates (or truncates) path.
+    bool open(const char* path);
+
+    bool write(const void* data, size_t len);
+    bool close();
+
+  private:
+    int fd_;
+
+    FileSink(const FileSink&);
+    FileSink& operator=(const FileSink&);
+};
+
+// write() until everything is out or an error other than EINTR
+bool writeAll(int fd, const void* data, size_t len);
+
+#endif // IMU_LOG_SINK_H
@@ -0,0 +1,117 @@
+#ifndef IMU_RING_STORAGE_H
+#define IMU_RING_STORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "log_sink.h"
+
+// Bounded log storage for long missions: a fixed set of segment files in
+// one directory, used as a ring.
+//
+// Every segment is preallocated to its full size when it is (re)started,
+// so the writes that fill it never allocate blocks or update extent
+// metadata, and the storage never grows past segments * segment_bytes.
+// When the ring wraps, the oldest segment is overwritten, except for
+// segments that were pinned (e.g. because they hold an event) which are
+// skipped until they are unpinned. A segment change that finds every
+// segment pinned is not a write error: that segment's data is dropped and
+// the next segment change tries again, so logging resumes at the first
+// segment boundary after a segment is unpinned.
+//
+// Segment i is the file "seg_<i>.log" in the directory; a pinned segment
+// has a "seg_<i>.log.pin" marker next to it so the pin survives a reset.
+class RingStorage : public LogSink
+{
+  public:
+
+    RingStorage();
+    ~RingStorage();
+
+    // Creates dir and the segment files as needed and starts writing in the
+    // segment after the one most recently written (by sequence number, see
+    // nextSequence()).
+    bool open(const char* dir, unsigned segments, size_t segment_bytes);
+
+    size_t segmentBytes() const
+    {
+        return segment_bytes_;
+    }
+
+    unsigned segmentCount() const
+    {
+        return (unsigned)paths_.size();
+    }
+
+    std::string segmentPath(unsigned segment) const
+    {
+        return paths_[segment];
+    }
+
+    // One more than the highest sequence number found in the segment
+    // headers at open() (FlightLogHeader::segment), so that numbering
+    // continues across resets and readers can order the segments.
+    uint32_t nextSequence() const
+    {
+        return next_sequence_;
+    }
+
+    // Pins the segment with this sequence number once the writer thread
+    // gets to it (FlightLogWriter::segment() is the one being appended to,
+    // which the writer thread may not have started yet). Safe to call from
+    // the acquisition thread: it only stores the request, the marker is
+    // written by the writer thread. One request is held at a time. A
+    // request for a segment the writer has already passed pins it if it
+    // is still in the ring and is rejected (rejectedPins()) if it has been
+    // overwritten or was dropped.
+    void pin(uint32_t sequence)
+    {
+        pin_request_.store((uint64_t)sequence + 1, std::memory_order_relaxed);
+    }
+
+    bool unpin(unsigned segment);
+    bool isPinned(unsigned segment);
+
+    // number of segment changes that found every segment pinned; the data
+    // for such a segment is dropped
+    uint64_t refused() const
+    {
+        return refused_;
+    }
+
+    // number of pin requests for segments no longer in the ring
+    uint64_t rejectedPins() const
+    {
+        return rejected_pins_.load(std::memory_order_relaxed);
+    }
+
+    bool write(const void* data, size_t len);
+    bool nextSegment();
+    bool close();
+
+  private:
+    bool startSegment(unsigned segment);
+    void applyPin();
+
+    std::vector<std::string> paths_;
+    std::vector<bool> pinned_;
+    std::vector<int64_t> sequences_;    // sequence number each segment holds, -1 if none
+    size_t segment_bytes_;
+    uint32_t next_sequence_;
+    uint32_t sequence_;             // sequence number of the segment being written
+    unsigned current_;
+    int fd_;
+    bool refusing_;                 // every segment was pinned at the last segment change
+    uint64_t refused_;
+    std::atomic<uint64_t> rejected_pins_;
+    std::atomic<uint64_t> pin_request_;  // sequence + 1 to pin, 0 for none
+    std::mutex lock_;               // pinned_, shared with unpin() and isPinned()
+
+    RingStorage(const RingStorage&);
+    RingStorage& operator=(const RingStorage&);
+};
+
+#endif // IMU_RING_STORAGE_H
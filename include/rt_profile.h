@@ -0,0 +1,57 @@
+#ifndef IMU_RT_PROFILE_H
+#define IMU_RT_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Real-time execution profile of the acquisition process: memory locked
+// and prefaulted so the loops never take a page fault, and the time
+// critical threads pinned to their own cores at SCHED_FIFO priorities.
+// Each call asks the kernel, reads back what it actually applied and
+// reports that on the given stream, so a flight log shows whether the
+// process ran with the profile or without it (no CAP_SYS_NICE or
+// CAP_IPC_LOCK, RLIMIT_RTPRIO or RLIMIT_MEMLOCK too low, RT throttling).
+// Nothing here allocates once the profile is applied.
+//
+//   rtReportLimits(stderr);
+//   rtLockMemory(stderr);                      // before the buffers are made
+//   ...
+//   // first thing on each real-time thread:
+//   rtApplyThread("fusion", fusion_profile, stderr);
+//   rtPrefaultStack(RT_STACK_PREFAULT);
+
+#define RT_STACK_PREFAULT (256 << 10) // stack touched by rtPrefaultStack, well above the loops' use
+
+struct RtThreadProfile
+{
+    int cpu;                        // core to pin to, -1 to leave the affinity alone
+    int priority;                   // SCHED_FIFO priority 1-99, 0 to stay SCHED_OTHER
+};
+
+// RLIMIT_RTPRIO, RLIMIT_MEMLOCK and the kernel's RT throttling
+// (sched_rt_runtime_us), the settings that decide what the calls below
+// are allowed to do.
+void rtReportLimits(FILE* report);
+
+// Locks every current and future page of the process into RAM and keeps
+// the heap from handing memory back to the kernel, so freed blocks are
+// reused without faulting. Returns false if the kernel refused.
+bool rtLockMemory(FILE* report);
+
+// Touches bytes of the calling thread's stack, so that the pages are
+// resident before the loop first needs them.
+void rtPrefaultStack(size_t bytes);
+
+// Touches every page of a buffer, writing it unchanged.
+void rtPrefault(void* buffer, size_t bytes);
+
+// Pins the calling thread and sets its scheduling as profile asks, then
+// reads both back. Returns true if the thread got everything it asked for.
+bool rtApplyThread(const char* name, const RtThreadProfile& profile, FILE* report);
+
+// minor + major page faults of the calling thread so far (of the process
+// where the C library has no RUSAGE_THREAD)
+uint64_t rtPageFaults();
+
+#endif // IMU_RT_PROFILE_H
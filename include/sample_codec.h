@@ -0,0 +1,76 @@
+#ifndef IMU_SAMPLE_CODEC_H
+#define IMU_SAMPLE_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Lossless compression of raw 6-axis int16 sample streams for downlink.
+//
+// Each axis is predicted from its previous sample and only the zigzag
+// mapped difference is coded. Samples are grouped into blocks that start
+// with a sync word, the first sample in full and a CRC, so every block
+// decodes on its own and a decoder that lost data resynchronises at the
+// next block.
+//
+// Block layout, little endian:
+//
+//   0  sync 0xEB 0x90    2  coding u8      3  axes u8 (6)
+//   4  count u16         6  payload bytes u16
+//   8  first sample int16[6]
+//  20  per-axis parameter u8[6] (bit width or Rice k)
+//  26  payload: the count-1 deltas of axis 0, then axis 1, ...
+//      crc16 (CCITT) of everything before it
+
+#define SAMPLE_AXES 6
+#define SAMPLE_BLOCK_MAX 1024       // samples per block
+
+enum SampleCoding
+{
+    SAMPLE_CODING_VARINT = 0,       // LEB128 bytes, 1 byte for |delta| < 64
+    SAMPLE_CODING_BITPACK = 1,      // fixed width per axis and block
+    SAMPLE_CODING_RICE = 2          // Rice code, parameter per axis and block
+};
+
+// Collects interleaved samples (ax ay az gx gy gz) and emits a block every
+// block_samples samples.
+class SampleEncoder
+{
+  public:
+
+    explicit SampleEncoder(SampleCoding coding = SAMPLE_CODING_RICE,
+                           size_t block_samples = 256);
+
+    // Adds count samples; every block completed is appended to out.
+    void write(const int16_t* samples, size_t count, std::vector<uint8_t>& out);
+
+    // Adds a batch read from the ICM-20602 FIFO: per sample the big-endian
+    // accel X/Y/Z, the temperature if has_temp, then gyro X/Y/Z. A trailing
+    // partial sample is ignored.
+    void writeFifo(const uint8_t* fifo, size_t bytes, bool has_temp,
+                   std::vector<uint8_t>& out);
+
+    // Emits the samples collected so far as a (short) block.
+    void flush(std::vector<uint8_t>& out);
+
+  private:
+    void encodeBlock(std::vector<uint8_t>& out);
+
+    SampleCoding coding_;
+    size_t block_samples_;
+    size_t count_;
+    std::vector<int16_t> axes_[SAMPLE_AXES];    // pending samples, one array per axis
+    std::vector<uint16_t> deltas_;              // scratch, zigzag deltas of one axis
+};
+
+// Decodes the block at in[0..len) into interleaved samples. Returns the
+// number of bytes the block occupies, or 0 if in does not start with a
+// complete, valid block.
+size_t decodeSampleBlock(const uint8_t* in, size_t len, std::vector<int16_t>& samples);
+
+// Decodes every valid block in in[0..len), skipping bytes that are not
+// part of one (lost or corrupted data). Returns the number of bytes
+// skipped.
+size_t decodeSampleStream(const uint8_t* in, size_t len, std::vector<int16_t>& samples);
+
+#endif // IMU_SAMPLE_CODEC_H
@@ -0,0 +1,52 @@
+#ifndef IMU_SAMPLE_FILTERS_H
+#define IMU_SAMPLE_FILTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The per-sample filters of the flight loop in IMU.cpp, kept apart from
+// the sensor code so that they can be benchmarked and replayed on a host.
+
+#define MEDIAN_WINDOW 5             // samples the accel median is taken over
+#define COMP_GYRO_WEIGHT 0.98
+#define COMP_ACCEL_WEIGHT 0.02
+
+// Complementary filter of a gyro-integrated and an accel-derived angle.
+double compFilter(double accel_data, double gyro_data);
+
+// Median of the last MEDIAN_WINDOW values pushed, kept in fixed storage so
+// that the flight loop never allocates for it.
+class MedianWindow
+{
+  public:
+    MedianWindow() : count_(0), next_(0) {}
+
+    void push(double value)
+    {
+      values_[next_] = value;
+      next_ = next_ + 1 == MEDIAN_WINDOW ? 0 : next_ + 1;
+      if (count_ < MEDIAN_WINDOW) count_++;
+    }
+
+    // whether MEDIAN_WINDOW values have been pushed
+    bool ready() const
+    {
+      return count_ == MEDIAN_WINDOW;
+    }
+
+    // 0 until ready()
+    double median() const;
+
+  private:
+    double values_[MEDIAN_WINDOW];
+    unsigned count_;
+    unsigned next_;
+};
+
+// Signed value of a big-endian register pair as read from the ICM-20602.
+static inline int16_t rawValue(uint8_t high, uint8_t low)
+{
+    return (int16_t)(uint16_t)(high << 8 | low);
+}
+
+#endif // IMU_SAMPLE_FILTERS_H
@@ -0,0 +1,100 @@
+#ifndef IMU_SAMPLE_RING_H
+#define IMU_SAMPLE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "flight_log.h"
+
+// A sample as the acquisition loop hands it on: the raw registers as
+// logged and the fused attitude after it.
+struct RingSample
+{
+    FlightLogRecord raw;
+    float q[4];                     // w, x, y, z
+};
+
+// Single-producer single-consumer ring between two threads of the
+// acquisition process (e.g. the fusion loop and TelemetryPacketizer).
+// push() is a copy and two atomic operations; it never blocks and never
+// allocates, and an entry that finds the ring full is dropped and counted.
+// The consumer reads entries in place through peek() and releases them
+// with consume().
+template <typename T>
+class SpscRing
+{
+  public:
+
+    // capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity = 1024) :
+        head_(0), overruns_(0), tail_(0)
+    {
+      size_t size = 2;
+      while (size < capacity) size <<= 1;
+      mask_ = size - 1;
+      // value-initialized, so touched here and the producer does not
+      // take the page faults
+      slots_ = new T[size]();
+    }
+
+    ~SpscRing()
+    {
+      delete[] slots_;
+    }
+
+    // Producer. Returns false if the ring is full.
+    bool push(const T& entry)
+    {
+      uint64_t head = head_.load(std::memory_order_relaxed);
+      if (head - tail_.load(std::memory_order_acquire) > mask_)
+      {
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      slots_[head & mask_] = entry;
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer. The oldest unread entries: n contiguous slots starting at
+    // the returned pointer (n == 0 if the ring is empty). Slots that wrap
+    // around are returned by the next peek() after consume().
+    const T* peek(size_t& n) const
+    {
+      uint64_t tail = tail_.load(std::memory_order_relaxed);
+      uint64_t available = head_.load(std::memory_order_acquire) - tail;
+      size_t to_end = mask_ + 1 - (tail & mask_);
+      n = available < to_end ? available : to_end;
+      return slots_ + (tail & mask_);
+    }
+
+    void consume(size_t n)
+    {
+      tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    // number of push() calls that found the ring full
+    uint64_t overruns() const
+    {
+      return overruns_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    T* slots_;
+    size_t mask_;
+
+    // producer and consumer indexes on their own cache lines
+    char pad0_[64];
+    std::atomic<uint64_t> head_;
+    std::atomic<uint64_t> overruns_;
+    char pad1_[64];
+    std::atomic<uint64_t> tail_;
+    char pad2_[64];
+
+    SpscRing(const SpscRing&);
+    SpscRing& operator=(const SpscRing&);
+};
+
+typedef SpscRing<RingSample> SampleRing;
+
+#endif // IMU_SAMPLE_RING_H
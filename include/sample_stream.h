@@ -0,0 +1,91 @@
+#ifndef IMU_SAMPLE_STREAM_H
+#define IMU_SAMPLE_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "sample_ring.h"
+
+// Live stream of samples and attitude to ground-support tools over a
+// Unix-domain or loopback TCP socket.
+//
+// The stream is a sequence of frames: a StreamFrameHeader followed by
+// count RingSamples, in host byte order and the layout of the structs.
+// The frame sequence number counts every frame built, so a client sees
+// the frames it missed as a gap.
+#define STREAM_MAGIC "IMUS"
+#define STREAM_VERSION 1
+#define STREAM_DEFAULT_BATCH 64
+
+struct StreamFrameHeader
+{
+    char magic[4];                  // STREAM_MAGIC
+    uint16_t version;               // STREAM_VERSION
+    uint16_t sample_size;           // sizeof(RingSample)
+    uint32_t sequence;
+    uint32_t count;                 // samples that follow
+};
+
+// Serves the samples in a SampleRing to any number of local clients. A
+// client that does not keep up loses whole frames: sockets are non-blocking
+// and a frame is only started while the client's previous one has been
+// sent completely, so the streamer never waits and a slow display never
+// holds up the others. Without clients the samples are discarded.
+//
+// All calls come from one thread, the ring's consumer.
+class SampleStreamer
+{
+  public:
+
+    // batch is the most samples per frame
+    explicit SampleStreamer(size_t batch = STREAM_DEFAULT_BATCH);
+    ~SampleStreamer();
+
+    // Listens on a Unix-domain socket at path (replacing a stale one).
+    bool openUnix(const char* path);
+
+    // Listens on 127.0.0.1:port.
+    bool openTcp(uint16_t port);
+
+    // Accepts new clients, finishes frames left half sent and sends the
+    // samples waiting in ring as frames of up to batch samples.
+    void poll(SampleRing& ring);
+
+    void close();
+
+    // frames a client had to miss because it was not reading fast enough
+    uint64_t droppedFrames() const
+    {
+        return dropped_;
+    }
+
+    size_t clients() const
+    {
+        return clients_.size();
+    }
+
+  private:
+    struct Client
+    {
+        int fd;
+        std::vector<uint8_t> pending;   // rest of a frame the socket did not take
+        size_t sent;                    // bytes of pending already sent
+    };
+
+    bool listen(int fd);
+    void accept();
+    bool finish(Client& client);
+    bool send(Client& client, const StreamFrameHeader& header, const RingSample* samples);
+    void drop(size_t i);
+
+    size_t batch_;
+    int listen_fd_;
+    std::vector<Client> clients_;
+    uint32_t sequence_;
+    uint64_t dropped_;
+
+    SampleStreamer(const SampleStreamer&);
+    SampleStreamer& operator=(const SampleStreamer&);
+};
+
+#endif // IMU_SAMPLE_STREAM_H
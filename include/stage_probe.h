@@ -0,0 +1,82 @@
+#ifndef IMU_STAGE_PROBE_H
+#define IMU_STAGE_PROBE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// CPU counters per stage of the flight code, compiled in with
+// `make PROBES=enabled` (-DIMU_PROBES). Without it the macros below expand
+// to nothing, so a flight build carries no trace of them.
+//
+//   STAGE_PROBE(PROBE_MEDIAN);     // counts to the end of the enclosing scope
+//   STAGE_PROBE_REPORT(stderr);    // calls and counts per call of each stage
+//
+// Every thread that enters a probe opens its own perf_event group counting
+// user-space cycles, instructions and cache misses. Where the kernel has
+// no perf events or perf_event_paranoid forbids them, probes count cycles
+// alone: rdtsc on x86, PMCCNTR on ARMv7 if the kernel has enabled user
+// access to it, and nanoseconds otherwise. Probes nest; an inner stage is
+// counted in the outer one as well.
+enum ProbeStage
+{
+    PROBE_READ_IMU,                 // one register pair over the sidekiq accel interface
+    PROBE_MEDIAN,
+    PROBE_FILTER_IMU,               // ImuFilter::madgwickAHRSupdateIMU
+    PROBE_FILTER_MARG,              // ImuFilter::madgwickAHRSupdate
+    PROBE_LOG_APPEND,               // FlightLogWriter::append, acquisition thread
+    PROBE_LOG_WRITE,                // AsyncLogWriter buffer to sink, writer thread
+    PROBE_STAGES
+};
+
+#ifdef IMU_PROBES
+
+struct ProbeCounts
+{
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t cache_misses;
+};
+
+// the calling thread's counters
+void stageProbeRead(ProbeCounts& counts);
+
+// adds the counts since begin to stage; safe from any thread
+void stageProbeAdd(ProbeStage stage, const ProbeCounts& begin);
+
+void stageProbeReport(FILE* out);
+
+class StageProbe
+{
+  public:
+
+    explicit StageProbe(ProbeStage stage) : stage_(stage)
+    {
+      stageProbeRead(begin_);
+    }
+
+    ~StageProbe()
+    {
+      stageProbeAdd(stage_, begin_);
+    }
+
+  private:
+    ProbeStage stage_;
+    ProbeCounts begin_;
+
+    StageProbe(const StageProbe&);
+    StageProbe& operator=(const StageProbe&);
+};
+
+#define STAGE_PROBE_JOIN2(a, b) a##b
+#define STAGE_PROBE_JOIN(a, b) STAGE_PROBE_JOIN2(a, b)
+#define STAGE_PROBE(stage) StageProbe STAGE_PROBE_JOIN(stage_probe_, __LINE__)(stage)
+#define STAGE_PROBE_REPORT(out) stageProbeReport(out)
+
+#else
+
+#define STAGE_PROBE(stage) do {} while (0)
+#define STAGE_PROBE_REPORT(out) do {} while (0)
+
+#endif // IMU_PROBES
+
+#endif // IMU_STAGE_PROBE_H
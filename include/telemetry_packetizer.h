@@ -0,0 +1,84 @@
+#ifndef IMU_TELEMETRY_PACKETIZER_H
+#define IMU_TELEMETRY_PACKETIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "log_sink.h"
+#include "sample_ring.h"
+
+// CCSDS space packets (CCSDS 133.0-B) of attitude and raw IMU telemetry.
+//
+// Every packet is a 6-byte primary header (version 0, telemetry, secondary
+// header present, unsegmented, a 14-bit sequence count per APID), an
+// 8-byte secondary header with the absolute time of the first entry, then
+// whole entries, all big endian. The time is a CCSDS unsegmented time code
+// (CCSDS 301.0-B) with its P-field: TM_TIME_PFIELD, then 4 octets of
+// seconds and 3 octets of 2^-24 s since the agency-defined epoch
+// 1970-01-01 00:00:00 UTC, counted without leap seconds as CLOCK_REALTIME
+// counts them.
+//
+//   TM_APID_ATTITUDE  uint32 us since the packet time, int16 q[4] (w x y z, Q15)
+//   TM_APID_RAW       uint32 us since the packet time, int16 accel[3],
+//                     gyro[3], temp, uint16 flags (raw counts as logged)
+#define TM_APID_ATTITUDE 0x101
+#define TM_APID_RAW 0x102
+
+#define TM_PRIMARY_HEADER_SIZE 6
+#define TM_SECONDARY_HEADER_SIZE 8
+#define TM_TIME_PFIELD 0x2F                 // CUC, agency-defined epoch, 4 coarse + 3 fine octets
+#define TM_ATTITUDE_ENTRY_SIZE 12
+#define TM_RAW_ENTRY_SIZE 20
+#define TM_DEFAULT_PACKET_SIZE 1024
+
+// Turns the samples in a SampleRing into packets. Each stream takes every
+// decimation-th sample (0 turns the stream off), which sets its output
+// rate; a packet goes out as soon as another entry would not fit in
+// packet_size bytes. The packet buffers are sized once and reused, and
+// entries are encoded straight from the ring slots into them.
+class TelemetryPacketizer
+{
+  public:
+
+    // start_ns is the CLOCK_REALTIME the sample times count from
+    // (FlightLogHeader::start_ns).
+    TelemetryPacketizer(uint64_t start_ns, unsigned attitude_decimation, unsigned raw_decimation,
+                        size_t packet_size = TM_DEFAULT_PACKET_SIZE);
+
+    // Packs and consumes every sample waiting in ring, writing the packets
+    // that fill up to out. Returns false if a write to out failed.
+    bool drain(SampleRing& ring, LogSink& out);
+
+    // Writes out the partly filled packets.
+    bool flush(LogSink& out);
+
+    uint64_t packets() const
+    {
+        return packets_;
+    }
+
+  private:
+    struct Stream
+    {
+        uint16_t apid;
+        unsigned decimation;
+        unsigned phase;             // samples until the next one is taken
+        size_t entry_size;
+        std::vector<uint8_t> packet;
+        size_t fill;                // bytes used in packet
+        uint16_t sequence;
+        uint64_t t0_ns;             // time of the first entry
+    };
+
+    void init(Stream& stream, uint16_t apid, unsigned decimation, size_t entry_size, size_t packet_size);
+    uint8_t* entry(Stream& stream, uint64_t t_ns, LogSink& out);
+    bool send(Stream& stream, LogSink& out);
+
+    uint64_t start_ns_;
+    Stream attitude_;
+    Stream raw_;
+    uint64_t packets_;
+    bool failed_;
+};
+
+#endif // IMU_TELEMETRY_PACKETIZER_H
@@ -0,0 +1,52 @@
+#ifndef IMU_TEXT_WRITER_H
+#define IMU_TEXT_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Buffered text output for CSV exports and reports. Numbers are formatted
+// straight into a large preallocated buffer (floating point with
+// float_format.h, so they read back bit-exactly) and the buffer goes to
+// the file in one write when it fills, so exporting a long capture costs
+// little more than the disk.
+class TextWriter
+{
+  public:
+
+    explicit TextWriter(size_t buffer_size = 1 << 20);
+    ~TextWriter();
+
+    // Creates (or truncates) path; a null path writes to stdout.
+    bool open(const char* path);
+
+    void put(const char* text);
+    void put(char c);
+    void put(float v);
+    void put(double v);
+    void putInt(long long v);
+
+    // Writes out the buffer; close() flushes too.
+    bool flush();
+
+    // Returns false if any write failed.
+    bool close();
+
+  private:
+    // room for one more number
+    void reserve()
+    {
+        if (fill_ + 32 > size_) flush();
+    }
+
+    char* buffer_;
+    size_t size_;
+    size_t fill_;
+    int fd_;
+    bool owned_;                    // fd_ was opened by open()
+    bool failed_;
+
+    TextWriter(const TextWriter&);
+    TextWriter& operator=(const TextWriter&);
+};
+
+#endif // IMU_TEXT_WRITER_H
@@ -145,17 +145,14 @@ public:
    * Equivilant to this = this * q */
 	Quaternion& operator*=(const Quaternion& q)
 	{
-		setValue(m_floats[3] * q.x() + m_floats[0] * q.m_floats[3] + m_floats[1] * q.z() - m_floats[2] * q.y(),
-			m_floats[3] * q.y() + m_floats[1] * q.m_floats[3] + m_floats[2] * q.x() - m_floats[0] * q.z(),
-			m_floats[3] * q.z() + m_floats[2] * q.m_floats[3] + m_floats[0] * q.y() - m_floats[1] * q.x(),
-			m_floats[3] * q.m_floats[3] - m_floats[0] * q.x() - m_floats[1] * q.y() - m_floats[2] * q.z());
+		tf2SimdQuatMul(m_floats, q.m_floats, m_floats);
 		return *this;
 	}
   /**@brief Return the dot product between this quaternion and another
    * @param q The other quaternion */
 	tf2Scalar dot(const Quaternion& q) const
 	{
-		return m_floats[0] * q.x() + m_floats[1] * q.y() + m_floats[2] * q.z() + m_floats[3] * q.m_floats[3];
+		return tf2SimdDot4(m_floats, q.m_floats);
 	}
 
   /**@brief Return the length squared of the quaternion */
@@ -363,10 +360,9 @@ operator-(const Quaternion& q)
 /**@brief Return the product of two quaternions */
 TF2SIMD_FORCE_INLINE Quaternion
 operator*(const Quaternion& q1, const Quaternion& q2) {
-	return Quaternion(q1.w() * q2.x() + q1.x() * q2.w() + q1.y() * q2.z() - q1.z() * q2.y(),
-		q1.w() * q2.y() + q1.y() * q2.w() + q1.z() * q2.x() - q1.x() * q2.z(),
-		q1.w() * q2.z() + q1.z() * q2.w() + q1.x() * q2.y() - q1.y() * q2.x(),
-		q1.w() * q2.w() - q1.x() * q2.x() - q1.y() * q2.y() - q1.z() * q2.z()); 
+	Quaternion r;
+	tf2SimdQuatMul(q1, q2, r);
+	return r;
 }
 
 TF2SIMD_FORCE_INLINE Quaternion
@@ -437,9 +433,10 @@ slerp(const Quaternion& q1, const Quaternion& q2, const tf2Scalar& t)
 TF2SIMD_FORCE_INLINE Vector3 
 quatRotate(const Quaternion& rotation, const Vector3& v) 
 {
-	Quaternion q = rotation * v;
-	q *= rotation.inverse();
-	return Vector3(q.getX(),q.getY(),q.getZ());
+	// rotation * v * rotation.inverse()
+	Vector3 r;
+	tf2SimdQuatRotate(rotation, v, r);
+	return r;
 }
 
 TF2SIMD_FORCE_INLINE Quaternion 
@@ -0,0 +1,252 @@
+/*
+Copyright (c) 2003-2006 Gino van den Bergen / Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+
+#ifndef TF2_SIMD_H
+#define TF2_SIMD_H
+
+#include "Scalar.h"
+
+///Compile time selection of the vector unit used by Vector3 and Quaternion.
+///tf2Scalar is double, so every backend works on pairs (SSE2, NEON on aarch64)
+///or quads (AVX2) of doubles. 32 bit ARM NEON has no double precision lanes
+///and uses the scalar code. Define TF2_NO_SIMD to force the scalar code.
+///
+///The AVX2 helpers (tf2SimdCross3Avx2, tf2SimdQuatMulAvx2) are compiled on
+///every x86 GCC build under a target pragma, like the dsp_kernels.h
+///levels, so they are built and checked without -mavx2. Vector3 and
+///Quaternion only use them when the whole build targets AVX2; other code
+///may call them after cpuSupports(ISA_AVX2).
+#ifndef TF2_NO_SIMD
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+	#define TF2_HAVE_AVX2
+	#include <immintrin.h>
+#endif
+#if defined(__AVX2__)
+	#define TF2_USE_AVX2
+#endif
+#if defined(__SSE2__)
+	#define TF2_USE_SSE2
+	#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define TF2_USE_NEON
+	#include <arm_neon.h>
+#endif
+#endif //TF2_NO_SIMD
+
+///All helpers take pointers to the 4 element m_floats array of a Vector3 or
+///Quaternion (x, y, z, w). Every backend keeps the order of additions of the
+///scalar expression it replaces, so results match the scalar code bit for
+///bit unless the compiler contracts the scalar code into FMAs.
+///tf2SimdQuatRotate uses a shorter expansion, see below.
+
+#if defined(TF2_HAVE_AVX2)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+/**@brief tf2SimdCross3 on the AVX2 unit */
+inline void tf2SimdCross3Avx2(const tf2Scalar* a, const tf2Scalar* b, tf2Scalar* r)
+{
+	__m256d va = _mm256_loadu_pd(a);
+	__m256d vb = _mm256_loadu_pd(b);
+	__m256d a_yzx = _mm256_permute4x64_pd(va, _MM_SHUFFLE(3, 0, 2, 1));
+	__m256d b_zxy = _mm256_permute4x64_pd(vb, _MM_SHUFFLE(3, 1, 0, 2));
+	__m256d a_zxy = _mm256_permute4x64_pd(va, _MM_SHUFFLE(3, 1, 0, 2));
+	__m256d b_yzx = _mm256_permute4x64_pd(vb, _MM_SHUFFLE(3, 0, 2, 1));
+	__m256d c = _mm256_sub_pd(_mm256_mul_pd(a_yzx, b_zxy), _mm256_mul_pd(a_zxy, b_yzx));
+	_mm256_storeu_pd(r, _mm256_blend_pd(c, _mm256_setzero_pd(), 0x8));
+}
+
+/**@brief tf2SimdQuatMul on the AVX2 unit */
+inline void tf2SimdQuatMulAvx2(const tf2Scalar* a, const tf2Scalar* b, tf2Scalar* r)
+{
+	const __m256d sign_w = _mm256_set_pd(-0.0, 0.0, 0.0, 0.0);
+	__m256d va = _mm256_loadu_pd(a);
+	__m256d vb = _mm256_loadu_pd(b);
+	__m256d t = _mm256_mul_pd(_mm256_permute4x64_pd(va, _MM_SHUFFLE(3, 3, 3, 3)), vb);
+	t = _mm256_add_pd(t, _mm256_mul_pd(
+		_mm256_xor_pd(_mm256_permute4x64_pd(va, _MM_SHUFFLE(0, 2, 1, 0)), sign_w),
+		_mm256_permute4x64_pd(vb, _MM_SHUFFLE(0, 3, 3, 3))));
+	t = _mm256_add_pd(t, _mm256_mul_pd(
+		_mm256_xor_pd(_mm256_permute4x64_pd(va, _MM_SHUFFLE(1, 0, 2, 1)), sign_w),
+		_mm256_permute4x64_pd(vb, _MM_SHUFFLE(1, 1, 0, 2))));
+	t = _mm256_sub_pd(t, _mm256_mul_pd(
+		_mm256_permute4x64_pd(va, _MM_SHUFFLE(2, 1, 0, 2)),
+		_mm256_permute4x64_pd(vb, _MM_SHUFFLE(2, 0, 2, 1))));
+	_mm256_storeu_pd(r, t);
+}
+
+#pragma GCC pop_options
+#endif //TF2_HAVE_AVX2
+
+/**@brief Return a.x*b.x + a.y*b.y + a.z*b.z */
+TF2SIMD_FORCE_INLINE tf2Scalar tf2SimdDot3(const tf2Scalar* a, const tf2Scalar* b)
+{
+#if defined(TF2_USE_SSE2)
+	__m128d m = _mm_mul_pd(_mm_loadu_pd(a), _mm_loadu_pd(b));
+	__m128d s = _mm_add_sd(m, _mm_unpackhi_pd(m, m));
+	s = _mm_add_sd(s, _mm_mul_sd(_mm_load_sd(a + 2), _mm_load_sd(b + 2)));
+	return _mm_cvtsd_f64(s);
+#elif defined(TF2_USE_NEON)
+	float64x2_t m = vmulq_f64(vld1q_f64(a), vld1q_f64(b));
+	return vpaddd_f64(m) + a[2] * b[2];
+#else
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+#endif
+}
+
+/**@brief Return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w */
+TF2SIMD_FORCE_INLINE tf2Scalar tf2SimdDot4(const tf2Scalar* a, const tf2Scalar* b)
+{
+#if defined(TF2_USE_SSE2)
+	__m128d m01 = _mm_mul_pd(_mm_loadu_pd(a), _mm_loadu_pd(b));
+	__m128d m23 = _mm_mul_pd(_mm_loadu_pd(a + 2), _mm_loadu_pd(b + 2));
+	__m128d s = _mm_add_sd(m01, _mm_unpackhi_pd(m01, m01));
+	s = _mm_add_sd(s, m23);
+	s = _mm_add_sd(s, _mm_unpackhi_pd(m23, m23));
+	return _mm_cvtsd_f64(s);
+#elif defined(TF2_USE_NEON)
+	float64x2_t m01 = vmulq_f64(vld1q_f64(a), vld1q_f64(b));
+	float64x2_t m23 = vmulq_f64(vld1q_f64(a + 2), vld1q_f64(b + 2));
+	return vpaddd_f64(m01) + vgetq_lane_f64(m23, 0) + vgetq_lane_f64(m23, 1);
+#else
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+#endif
+}
+
+/**@brief r = a x b, r.w = 0. r may alias neither a nor b */
+TF2SIMD_FORCE_INLINE void tf2SimdCross3(const tf2Scalar* a, const tf2Scalar* b, tf2Scalar* r)
+{
+#if defined(TF2_USE_AVX2)
+	tf2SimdCross3Avx2(a, b, r);
+#elif defined(TF2_USE_SSE2)
+	__m128d a01 = _mm_loadu_pd(a), a12 = _mm_loadu_pd(a + 1), a23 = _mm_loadu_pd(a + 2);
+	__m128d b01 = _mm_loadu_pd(b), b12 = _mm_loadu_pd(b + 1), b23 = _mm_loadu_pd(b + 2);
+	// (a1 b2 - a2 b1, a2 b0 - a0 b2)
+	__m128d xy = _mm_sub_pd(_mm_mul_pd(a12, _mm_shuffle_pd(b23, b01, 0)),
+		_mm_mul_pd(_mm_shuffle_pd(a23, a01, 0), b12));
+	// a0 b1 - a1 b0
+	__m128d z = _mm_sub_sd(_mm_mul_sd(a01, _mm_unpackhi_pd(b01, b01)),
+		_mm_mul_sd(_mm_unpackhi_pd(a01, a01), b01));
+	_mm_storeu_pd(r, xy);
+	_mm_storeu_pd(r + 2, _mm_move_sd(_mm_setzero_pd(), z));
+#elif defined(TF2_USE_NEON)
+	float64x2_t a01 = vld1q_f64(a), a12 = vld1q_f64(a + 1), a23 = vld1q_f64(a + 2);
+	float64x2_t b01 = vld1q_f64(b), b12 = vld1q_f64(b + 1), b23 = vld1q_f64(b + 2);
+	float64x2_t xy = vsubq_f64(vmulq_f64(a12, vzip1q_f64(b23, b01)),
+		vmulq_f64(vzip1q_f64(a23, a01), b12));
+	vst1q_f64(r, xy);
+	r[2] = a[0] * b[1] - a[1] * b[0];
+	r[3] = tf2Scalar(0.);
+#else
+	r[0] = a[1] * b[2] - a[2] * b[1];
+	r[1] = a[2] * b[0] - a[0] * b[2];
+	r[2] = a[0] * b[1] - a[1] * b[0];
+	r[3] = tf2Scalar(0.);
+#endif
+}
+
+/**@brief a.xyz *= s, a.w untouched */
+TF2SIMD_FORCE_INLINE void tf2SimdScale3(tf2Scalar* a, tf2Scalar s)
+{
+#if defined(TF2_USE_SSE2)
+	_mm_storeu_pd(a, _mm_mul_pd(_mm_loadu_pd(a), _mm_set1_pd(s)));
+	a[2] *= s;
+#elif defined(TF2_USE_NEON)
+	vst1q_f64(a, vmulq_n_f64(vld1q_f64(a), s));
+	a[2] *= s;
+#else
+	a[0] *= s; a[1] *= s; a[2] *= s;
+#endif
+}
+
+/**@brief r = a * b (Hamilton product, xyzw layout). r may alias a or b */
+TF2SIMD_FORCE_INLINE void tf2SimdQuatMul(const tf2Scalar* a, const tf2Scalar* b, tf2Scalar* r)
+{
+#if defined(TF2_USE_AVX2)
+	tf2SimdQuatMulAvx2(a, b, r);
+#elif defined(TF2_USE_SSE2)
+	const __m128d sign_hi = _mm_set_pd(-0.0, 0.0);
+	__m128d a01 = _mm_loadu_pd(a), a23 = _mm_loadu_pd(a + 2);
+	__m128d b01 = _mm_loadu_pd(b), b23 = _mm_loadu_pd(b + 2);
+	__m128d aw = _mm_unpackhi_pd(a23, a23);
+	__m128d a_yz = _mm_shuffle_pd(a01, a23, 1);
+	// x = aw bx + ax bw + ay bz - az by,  y = aw by + ay bw + az bx - ax bz
+	__m128d xy = _mm_mul_pd(aw, b01);
+	xy = _mm_add_pd(xy, _mm_mul_pd(a01, _mm_unpackhi_pd(b23, b23)));
+	xy = _mm_add_pd(xy, _mm_mul_pd(a_yz, _mm_shuffle_pd(b23, b01, 0)));
+	xy = _mm_sub_pd(xy, _mm_mul_pd(_mm_shuffle_pd(a23, a01, 0), _mm_shuffle_pd(b01, b23, 1)));
+	// z = aw bz + az bw + ax by - ay bx,  w = aw bw - ax bx - ay by - az bz
+	__m128d zw = _mm_mul_pd(aw, b23);
+	zw = _mm_add_pd(zw, _mm_mul_pd(_mm_xor_pd(_mm_shuffle_pd(a23, a01, 0), sign_hi), _mm_shuffle_pd(b23, b01, 1)));
+	zw = _mm_add_pd(zw, _mm_mul_pd(_mm_xor_pd(a01, sign_hi), _mm_unpackhi_pd(b01, b01)));
+	zw = _mm_sub_pd(zw, _mm_mul_pd(a_yz, _mm_unpacklo_pd(b01, b23)));
+	_mm_storeu_pd(r, xy);
+	_mm_storeu_pd(r + 2, zw);
+#elif defined(TF2_USE_NEON)
+	const float64x2_t sign_hi = { 1.0, -1.0 };
+	float64x2_t a01 = vld1q_f64(a), a23 = vld1q_f64(a + 2);
+	float64x2_t b01 = vld1q_f64(b), b23 = vld1q_f64(b + 2);
+	float64x2_t aw = vdupq_laneq_f64(a23, 1);
+	float64x2_t a_yz = vextq_f64(a01, a23, 1);
+	float64x2_t a_zx = vzip1q_f64(a23, a01);
+	float64x2_t xy = vmulq_f64(aw, b01);
+	xy = vaddq_f64(xy, vmulq_f64(a01, vdupq_laneq_f64(b23, 1)));
+	xy = vaddq_f64(xy, vmulq_f64(a_yz, vzip1q_f64(b23, b01)));
+	xy = vsubq_f64(xy, vmulq_f64(a_zx, vextq_f64(b01, b23, 1)));
+	float64x2_t zw = vmulq_f64(aw, b23);
+	zw = vaddq_f64(zw, vmulq_f64(vmulq_f64(a_zx, sign_hi), vextq_f64(b23, b01, 1)));
+	zw = vaddq_f64(zw, vmulq_f64(vmulq_f64(a01, sign_hi), vdupq_laneq_f64(b01, 1)));
+	zw = vsubq_f64(zw, vmulq_f64(a_yz, vzip1q_f64(b01, b23)));
+	vst1q_f64(r, xy);
+	vst1q_f64(r + 2, zw);
+#else
+	tf2Scalar x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+	tf2Scalar y = a[3] * b[1] + a[1] * b[3] + a[2] * b[0] - a[0] * b[2];
+	tf2Scalar z = a[3] * b[2] + a[2] * b[3] + a[0] * b[1] - a[1] * b[0];
+	tf2Scalar w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+	r[0] = x; r[1] = y; r[2] = z; r[3] = w;
+#endif
+}
+
+/**@brief r = q v q^* for any (not necessarily unit) quaternion q, r.w = 0.
+ * Uses (w^2 - u.u) v + 2 (u.v) u + 2 w (u x v) with u = q.xyz, which is
+ * what q * v * q.inverse() expands to, without the two full products. */
+TF2SIMD_FORCE_INLINE void tf2SimdQuatRotate(const tf2Scalar* q, const tf2Scalar* v, tf2Scalar* r)
+{
+	tf2Scalar uxv[4];
+	tf2SimdCross3(q, v, uxv);
+	tf2Scalar w = q[3];
+	tf2Scalar sv = w * w - tf2SimdDot3(q, q);
+	tf2Scalar su = tf2Scalar(2.) * tf2SimdDot3(q, v);
+	tf2Scalar sc = tf2Scalar(2.) * w;
+#if defined(TF2_USE_SSE2)
+	__m128d xy = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(sv), _mm_loadu_pd(v)),
+		_mm_mul_pd(_mm_set1_pd(su), _mm_loadu_pd(q))),
+		_mm_mul_pd(_mm_set1_pd(sc), _mm_loadu_pd(uxv)));
+	_mm_storeu_pd(r, xy);
+#elif defined(TF2_USE_NEON)
+	float64x2_t xy = vaddq_f64(vaddq_f64(vmulq_n_f64(vld1q_f64(v), sv),
+		vmulq_n_f64(vld1q_f64(q), su)), vmulq_n_f64(vld1q_f64(uxv), sc));
+	vst1q_f64(r, xy);
+#else
+	r[0] = sv * v[0] + su * q[0] + sc * uxv[0];
+	r[1] = sv * v[1] + su * q[1] + sc * uxv[1];
+#endif
+	r[2] = sv * v[2] + su * q[2] + sc * uxv[2];
+	r[3] = tf2Scalar(0.);
+}
+
+#endif //TF2_SIMD_H
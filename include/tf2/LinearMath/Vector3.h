@@ -20,6 +20,7 @@ subject to the following restrictions:
 
 #include "Scalar.h"
 #include "MinMax.h"
+#include "Simd.h"
 
 namespace tf2
 {
@@ -106,7 +107,7 @@ public:
    * @param s Scale factor */
 	TF2SIMD_FORCE_INLINE Vector3& operator*=(const tf2Scalar& s)
 	{
-		m_floats[0] *= s; m_floats[1] *= s;m_floats[2] *= s;
+		tf2SimdScale3(m_floats, s);
 		return *this;
 	}
 
@@ -122,7 +123,7 @@ public:
    * @param v The other vector in the dot product */
 	TF2SIMD_FORCE_INLINE tf2Scalar dot(const Vector3& v) const
 	{
-		return m_floats[0] * v.m_floats[0] + m_floats[1] * v.m_floats[1] +m_floats[2] * v.m_floats[2];
+		return tf2SimdDot3(m_floats, v.m_floats);
 	}
 
   /**@brief Return the length of the vector squared */
@@ -180,10 +181,9 @@ public:
    * @param v The other vector */
 	TF2SIMD_FORCE_INLINE Vector3 cross(const Vector3& v) const
 	{
-		return Vector3(
-			m_floats[1] * v.m_floats[2] -m_floats[2] * v.m_floats[1],
-			m_floats[2] * v.m_floats[0] - m_floats[0] * v.m_floats[2],
-			m_floats[0] * v.m_floats[1] - m_floats[1] * v.m_floats[0]);
+		Vector3 r;
+		tf2SimdCross3(m_floats, v.m_floats, r.m_floats);
+		return r;
 	}
 
 	TF2SIMD_FORCE_INLINE tf2Scalar triple(const Vector3& v1, const Vector3& v2) const
@@ -0,0 +1,119 @@
+#ifndef IMU_TUMBLE_SIM_H
+#define IMU_TUMBLE_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "imu_recording.h"
+
+// Deterministic Gaussian noise (xorshift64 and Box-Muller), so that a
+// simulation with the same seed produces the same data on every host.
+class GaussianNoise
+{
+  public:
+    explicit GaussianNoise(uint64_t seed) : state_(seed ? seed : 1), spare_(0), has_spare_(false) {}
+
+    // uniform in (0, 1)
+    double uniform()
+    {
+      state_ ^= state_ << 13;
+      state_ ^= state_ >> 7;
+      state_ ^= state_ << 17;
+      return ((state_ >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    }
+
+    double gauss(double sigma);
+
+  private:
+    uint64_t state_;
+    double spare_;
+    bool has_spare_;
+};
+
+// Error model of one three-axis sensor. Units are those of the sensor:
+// rad/s for the gyro, g for the accelerometer.
+struct SensorModel
+{
+    double noise_density;           // white noise, units/sqrt(Hz), over the Nyquist band
+    double bias_instability;        // 1 sigma of the wandering bias (first-order Gauss-Markov)
+    double bias_tau;                // s, correlation time of the wandering bias
+    double offset[3];               // constant bias
+    double full_scale;              // FSR; outputs saturate here
+    double counts;                  // LSB at full scale; outputs are quantized to full_scale / counts
+};
+
+// A tumbling rigid body carrying an ICM-20602.
+struct TumbleConfig
+{
+    double inertia[3][3];           // kg m^2, body frame, symmetric positive definite
+    double rate[3];                 // initial body rate, rad/s
+    double q[4];                    // initial attitude w, x, y, z, body to world
+    double gravity;                 // g along world +Z (1 on a ground test, 0 in orbit)
+    double offset[3];               // m, sensor position relative to the centre of mass
+    double sample_hz;
+    unsigned substeps;              // RK4 steps per sample
+    SensorModel gyro;
+    SensorModel accel;
+    uint64_t seed;
+};
+
+// A 3U CubeSat tumbling at about 10 deg/s on a ground test (1 g), sampled
+// at 100 Hz with the ICM-20602 datasheet noise at +-1000 deg/s and +-2 g.
+void initTumbleConfig(TumbleConfig& config);
+
+struct TumbleSample
+{
+    double t;                       // s since the start
+    double q[4];                    // truth attitude w, x, y, z, body to world
+    double rate[3];                 // truth body rate, rad/s
+    int16_t accel_raw[3];           // register values
+    int16_t gyro_raw[3];
+    float accel[3];                 // register values scaled back, g
+    float gyro[3];                  // rad/s
+    bool saturated;                 // an output hit the end of its range
+};
+
+// Integrates Euler's equations for the torque-free rigid body, I w' =
+// -w x I w, together with the attitude quaternion (classic RK4, fixed
+// step) and samples the sensor outputs at the configured rate: specific
+// force including the lever arm of the sensor offset, plus noise, bias,
+// quantization and saturation. Samples are generated on demand, so hours
+// of data can be streamed into a filter or a file without being held in
+// memory.
+class TumbleSim
+{
+  public:
+
+    explicit TumbleSim(const TumbleConfig& config);
+
+    // The next sample; the first is the initial state.
+    void next(TumbleSample& sample);
+
+    // Appends n samples to rec in filter units (g, rad/s) with time and
+    // truth columns.
+    void generate(size_t n, ImuRecording& rec);
+
+    // samples generated so far
+    uint64_t count() const
+    {
+      return count_;
+    }
+
+  private:
+    void derivative(const double state[7], double out[7]) const;
+    void step(double h);
+    void sense(const double value[3], const SensorModel& model, double bias[3],
+               int16_t raw[3], float out[3], bool& saturated);
+
+    TumbleConfig config_;
+    double inverse_[3][3];          // inertia^-1
+    double state_[7];               // q (w, x, y, z), w (rad/s)
+    double gyro_bias_[3];           // wandering part of the biases
+    double accel_bias_[3];
+    GaussianNoise noise_;
+    uint64_t count_;
+
+    TumbleSim(const TumbleSim&);
+    TumbleSim& operator=(const TumbleSim&);
+};
+
+#endif // IMU_TUMBLE_SIM_H
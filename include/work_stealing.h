@@ -0,0 +1,21 @@
+#ifndef IMU_WORK_STEALING_H
+#define IMU_WORK_STEALING_H
+
+#include <cstddef>
+#include <functional>
+
+// Runs task(i) for every i in [0, count) on `threads` worker threads
+// (0 = one per hardware thread) and returns when all tasks have finished.
+//
+// Each worker starts with a contiguous slice of the index range and takes
+// tasks from the front of it. A worker that runs dry steals the back half
+// of the busiest-looking victim's remaining slice, so uneven task costs
+// (e.g. filter configurations that diverge and hit slow paths) still keep
+// every core busy until the very end.
+void parallelFor(size_t count, unsigned threads,
+                 const std::function<void(size_t)>& task);
+
+// number of worker threads parallelFor will use for `threads` == 0
+unsigned defaultThreadCount();
+
+#endif // IMU_WORK_STEALING_H
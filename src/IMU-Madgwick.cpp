@@ -1,16 +1,15 @@
 #include <iostream>
 #include <vector>
 #include <stdio.h>
-#include "../../sidekiq_core/inc/sidekiq_api.h"
 #include <cmath>
 #include <algorithm>
 #include <unistd.h>
-#include <fstream>
+#include <string.h>
 #include <Eigen/Dense>
+#include "imu_device.h"
 #include "imu_filter.h"
 #include "test_helpers.h"
-//#include "sidekiq_api.h"
-#include "../../arg_parser/inc/arg_parser.h"
+#include "text_writer.h"
 
 using namespace std;
 using namespace Eigen;
@@ -98,35 +97,41 @@ vector<double> editVector(vector<double> arr) {
 	}
 }
 
-int read_imu(uint8_t card, uint8_t reg) //reads the raw values
+int read_imu(ImuDevice& device, uint8_t reg) //reads the raw values
 {
-	int32_t status = 0;
 	uint8_t low_byte = 0, high_byte = 0;
-	int result;
-	status = skiq_read_accel_reg(card, reg, &high_byte, 1);
-	if (status == 0) status = skiq_read_accel_reg(card, reg + 1, &low_byte, 1);
-	if (status == 0)
+	int result = 0;
+	if (device.readRegisters(reg, &high_byte, 1) && device.readRegisters(reg + 1, &low_byte, 1))
 	{
 		result = (((int)high_byte) << 8) | low_byte;
 		if (result >= 0x8000) result = result - 0x10000;
-		return result;
 	}
+	return result;
 }
 
 
-int main()
+//sidekiq by default, or a host device: replay:<flight.log>, synthetic[:<seed>]
+int main(int argc, char** argv)
 {
 	cout << "compiled" << endl;
-	uint8_t card = 0;
+	const char* device_spec = argc > 1 ? argv[1] : "sidekiq";
+	ImuDevice* device = strcmp(device_spec, "sidekiq") ? createHostDevice(device_spec) : new SidekiqDevice(0);
+	if (!device || !device->open())
+	{
+		printf("could not open %s\n", device_spec);
+		delete device;
+		return 1;
+	}
 	vector<double> acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z; //raw_values
 	double median_ax, median_ay, median_az = 0;
 	double angle_ax, angle_ay, angle_az = 0;
 	double angle_gx, angle_gy, angle_gz = 0;
 	double finalAngle_x, finalAngle_y, finalAngle_z = 0;
 
-	fstream data;
-	data.open("imu_data.csv");
-	data << "Median Accel X, Median Accel Y, Median Accel Z, Raw Gyro X, Raw Gyro Y, Raw Gyro Z, Delta Theta X, Delta Theta Y, Delta Theta Z, filtered theta X, filtered theta Y, filtered theta Z" << endl;
+	TextWriter data;
+	if (!data.open("imu_data.csv"))
+		printf("could not open imu_data.csv\n");
+	data.put("Median Accel X, Median Accel Y, Median Accel Z, Raw Gyro X, Raw Gyro Y, Raw Gyro Z, Delta Theta X, Delta Theta Y, Delta Theta Z, filtered theta X, filtered theta Y, filtered theta Z\n");
 
 	/*
 		fstream data("Path_To_File.csv");
@@ -136,27 +141,24 @@ int main()
 	//this is the config code that changes the Gyro Config register to 1000dps
 	uint8_t config_byte = 0;
 	uint8_t right_side = 0, left_side = 0;
-	skiq_read_accel_reg(card, 0x1B, &config_byte, 1);
+	device->readRegisters(ICM_GYRO_CONFIG, &config_byte, 1);
 	left_side = config_byte >> 5;
 	left_side = config_byte << 5;
 	right_side = config_byte & 7;
 	left_side = left_side | right_side;
 	left_side = left_side | GYRO_CONFIG;
 
-	//intialize the sidekiq
-	skiq_init(skiq_xport_type_auto, skiq_xport_init_level_basic, &card, 1);
-
-	//configure the above in the sidekiq
-	skiq_write_accel_reg(card, 0x1B, &config_byte, 1);
+	//configure the above in the sensor
+	device->writeRegisters(ICM_GYRO_CONFIG, &config_byte, 1);
 
-	for (int i = 0; i < PULL_NUMBER; i++) // 100HZ of data samples for 1 hr
+	for (int i = 0; i < PULL_NUMBER && !device->finished(); i++) // 100HZ of data samples for 1 hr
 	{
-		acc_x.push_back(read_imu(card, 0x3b));
-		acc_y.push_back(read_imu(card, 0x3d));
-		acc_z.push_back(read_imu(card, 0x3f));
-		gyro_x.push_back(read_imu(card, 0x43) * FSR / (pow(2, 15) - 1));
-		gyro_y.push_back(read_imu(card, 0x45) * FSR / (pow(2, 15) - 1));
-		gyro_z.push_back(read_imu(card, 0x47) * FSR / (pow(2, 15) - 1));
+		acc_x.push_back(read_imu(*device, 0x3b));
+		acc_y.push_back(read_imu(*device, 0x3d));
+		acc_z.push_back(read_imu(*device, 0x3f));
+		gyro_x.push_back(read_imu(*device, 0x43) * FSR / (pow(2, 15) - 1));
+		gyro_y.push_back(read_imu(*device, 0x45) * FSR / (pow(2, 15) - 1));
+		gyro_z.push_back(read_imu(*device, 0x47) * FSR / (pow(2, 15) - 1));
 
 		//median filter for accel
 		median_ax = median(acc_x);
@@ -207,34 +209,20 @@ double q3 = q.z();
 
 		filterStationary<WorldFrame::ENU>(angle_ax, angle_ay, angle_az, angle_gx, angle_gy, angle_gz, q0, q1, q2, q3);
 
-		//output into a .csv file
-		data << ("%.9f", median_ax);
-		data << ",";
-		data << ("%.9f", median_ay);
-		data << ",";
-		data << ("%.9f", median_az);
-		data << ",";
-		data << ("%.9f", gyro_x[i]);
-		data << ",";
-		data << ("%.9f", gyro_y[i]);
-		data << ",";
-		data << ("%.9f", gyro_z[i]);
-		data << ",";
-		data << ("%.9f", angle_gx);
-		data << ",";
-		data << ("%.9f", angle_gy);
-		data << ",";
-		data << ("%.9f", angle_gz);
-		data << ",";
-		data << ("%.9f", finalAngle_x);
-		data << ",";
-		data << ("%.9f", finalAngle_y);
-		data << ",";
-		data << ("%.9f", finalAngle_z) << endl;
+		//output into a .csv file, shortest digits that read back exactly
+		double columns[12] = { median_ax, median_ay, median_az, gyro_x[i], gyro_y[i], gyro_z[i],
+			angle_gx, angle_gy, angle_gz, finalAngle_x, finalAngle_y, finalAngle_z };
+		for (int c = 0; c < 12; c++)
+		{
+			data.put(columns[c]);
+			data.put(c < 11 ? ',' : '\n');
+		}
 
 		usleep(DELTA_TIME);
 
 	}
-	data.close();
-	skiq_exit();
+	if (!data.close())
+		printf("error writing imu_data.csv\n");
+	device->close();
+	delete device;
 }
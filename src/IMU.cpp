@@ -1,182 +1,533 @@
 #include <iostream>
 #include <vector>
 #include <stdio.h>
-#include "../include/sidekiq_api.h"
 #include <cmath>
 #include <algorithm>
 #include <unistd.h>
-#include <fstream>
 #include <stdio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <semaphore.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include "../include/imu_filter.h"
+#include "../include/filter_snapshot.h"
+#include "../include/alloc_guard.h"
+#include "../include/attitude_shm.h"
+#include "../include/flight_log.h"
+#include "../include/imu_device.h"
+#include "../include/latency_histogram.h"
+#include "../include/rt_profile.h"
+#include "../include/sample_filters.h"
+#include "../include/sample_ring.h"
+#include "../include/sample_stream.h"
+#include "../include/stage_probe.h"
+#include "../include/telemetry_packetizer.h"
 using namespace std;
 #define DELTA_TIME 10
-#define GYRO_CONST 0.98
-#define ACCEL_CONST 0.02
 #define PULL_NUMBER 100
-#define SPLIT_MARKER 5
 #define FSR 1000 //FSR defined in gyroscope config in ICM 20602 datasheet
 #define GYRO_CONFIG 16
 #define RAD_TO_DEGREES 180/3.141592653589793238463
 #define VECTOR_SIZE 5
+#define DEG_TO_RAD 3.141592653589793238463/180
+#define FILTER_GAIN 0.1
+#define FILTER_ZETA 0.0
+#define SNAPSHOT_PATH "imu_filter.snap"
+#define SNAPSHOT_INTERVAL 100 // samples between filter snapshots
+#define SNAPSHOT_RING_SIZE 4 // captured snapshots waiting for the telemetry thread to save them
+#define SNAPSHOT_MAX_AGE 600 // seconds; older snapshots are not used for a warm start
+#define LOG_RING_DIR "imu_log" // flight log segments, reused oldest first
+#define LOG_RING_SEGMENTS 16
+#define LOG_SEGMENT_BYTES (16 << 20) // the log never takes more than 16 x 16 MiB
+#define PIN_GYRO_RATE 300 // deg/s; a sample above it pins its segment so it is never overwritten
+#define TM_PATH "imu_telemetry.bin" // CCSDS packets for the downlink
+#define TM_ATTITUDE_DECIMATION 10 // every 10th attitude goes into telemetry
+#define TM_RAW_DECIMATION 100
+#define TM_PACKET_SIZE 1024
+#define TM_POLL_US 20000 // how often the telemetry thread drains the sample ring
+#define STREAM_PATH "/tmp/imu_stream.sock" // live samples for ground-support displays
+#define STREAM_POLL_US 2000
+#define TEMP_SENSITIVITY 326.8 // LSB per degC, ICM 20602 datasheet
+#define TEMP_OFFSET 25 // degC at a reading of 0
+#define ALLOC_GUARD_WARMUP 10 // samples after which the loop must not allocate (make ALLOC_GUARD=enabled)
+#define LATENCY_BUDGET_US 2000 // register read to published attitude; slower samples are counted
+#define FUSION_RING_SIZE 256 // samples in flight between the acquisition and fusion threads
+#define RT_ACQUIRE_CPU 1 // --rt defaults: acquisition has the second core to itself,
+#define RT_ACQUIRE_PRIORITY 80 // fusion shares the first with the housekeeping threads
+#define RT_FUSION_CPU 0
+#define RT_FUSION_PRIORITY 70
+#ifdef IMU_HOST
+#define DEFAULT_DEVICE "synthetic" // bin/IMU-host has no libsidekiq
+#define DEVICES "replay:<flight.log> | synthetic[:<seed>]"
+#else
+#define DEFAULT_DEVICE "sidekiq"
+#define DEVICES "sidekiq | replay:<flight.log> | synthetic[:<seed>]"
+#endif
 
 int ready; // ready = 1 whenever enough accel values are read to run the median funciton
 	   //median filter and arctan for accel values only run whenever ready = 1
+int read_failed; // set by read_imu when a register read fails, cleared by the caller
 
-double compFilter(double accel_data, double gyro_data)
+//latency of each stage of a sample, from its first register read to its
+//attitude being published; kill -USR1 dumps them
+enum { LAT_ACQUIRE, LAT_HANDOFF, LAT_FUSION, LAT_OUTPUT, LAT_MEDIAN, LAT_END_TO_END, LAT_STAGES };
+static const char* const latency_names[LAT_STAGES] = { "acquire", "handoff", "fusion", "output", "median", "end_to_end" };
+static LatencyHistogram latency[LAT_STAGES];
+static volatile sig_atomic_t latency_dump = 0;
+
+static void requestLatencyDump(int)
 {
-	return GYRO_CONST * gyro_data + ACCEL_CONST * accel_data;
+	latency_dump = 1;
 }
 
-int median(vector<double> arr)
+static void printLatency()
 {
-	if (arr.size() < SPLIT_MARKER)
+	for (int s = 0; s < LAT_STAGES; s++)
+		latency[s].print(stderr, latency_names[s]);
+	fprintf(stderr, "%llu samples over the %d us budget\n",
+		(unsigned long long)latency[LAT_END_TO_END].countAbove(LATENCY_BUDGET_US * 1000ull), LATENCY_BUDGET_US);
+	STAGE_PROBE_REPORT(stderr);
+}
+
+static inline uint64_t monotonicNs(const struct timespec& t)
+{
+	return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+static inline uint64_t monotonicNs()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return monotonicNs(t);
+}
+
+//a sample as the acquisition thread hands it to the fusion thread
+struct AcquiredSample
+{
+	FlightLogRecord raw;
+	uint64_t t_read; //CLOCK_MONOTONIC ns of the first register read
+	uint64_t t_acquired; //and after the last
+};
+
+int read_imu(ImuDevice& device, uint8_t reg) //reads the raw values
+{
+	STAGE_PROBE(PROBE_READ_IMU);
+	uint8_t low_byte = 0, high_byte = 0;
+	if (device.readRegisters(reg, &high_byte, 1) && device.readRegisters(reg + 1, &low_byte, 1))
 	{
-		ready = 0;
+		return rawValue(high_byte, low_byte);
 	}
-	else
+	read_failed = 1;
+	return 0;
+}
+
+//writes the newest snapshot the fusion thread has captured, if any; the
+//file system calls stay off the real-time threads
+static void saveLatestSnapshot(SpscRing<FilterSnapshot>& snapshots)
+{
+	size_t n;
+	const FilterSnapshot* s = snapshots.peek(n);
+	if (n == 0)
+		return;
+	saveSnapshot(SNAPSHOT_PATH, s[n - 1]);
+	snapshots.consume(n);
+}
+
+//the sensor named on the command line: sidekiq (the flight default),
+//replay:<flight.log> or synthetic[:<seed>]
+static ImuDevice* createDevice(const char* spec)
+{
+#ifndef IMU_HOST
+	if (!strcmp(spec, "sidekiq"))
+		return new SidekiqDevice(0);
+#endif
+	return createHostDevice(spec);
+}
+
+static void usage(const char* name)
+{
+	printf("usage: %s [" DEVICES "] [options]\n"
+		"  --rt                     real-time profile: locked memory, pinned SCHED_FIFO threads\n"
+		"  --acquire-cpu n          core of the acquisition thread (default %d)\n"
+		"  --acquire-priority p     its SCHED_FIFO priority (default %d)\n"
+		"  --fusion-cpu n           core of the fusion thread (default %d)\n"
+		"  --fusion-priority p      its SCHED_FIFO priority (default %d)\n"
+		"  a cpu of -1 leaves the thread unpinned, a priority of 0 leaves it SCHED_OTHER;\n"
+		"  any of these options implies --rt\n",
+		name, RT_ACQUIRE_CPU, RT_ACQUIRE_PRIORITY, RT_FUSION_CPU, RT_FUSION_PRIORITY);
+}
+
+
+int main(int argc, char** argv)
+{
+	const char* device_spec = DEFAULT_DEVICE;
+	bool realtime = false;
+	RtThreadProfile acquire_rt = { RT_ACQUIRE_CPU, RT_ACQUIRE_PRIORITY };
+	RtThreadProfile fusion_rt = { RT_FUSION_CPU, RT_FUSION_PRIORITY };
+	for (int a = 1; a < argc; a++)
 	{
-		if (SPLIT_MARKER % 2 != 0)
+		const char* opt = argv[a];
+		if (strncmp(opt, "--", 2) != 0)
 		{
-			ready = 1;
-			sort(arr.end() - SPLIT_MARKER, arr.end());
-			return arr[arr.size() / 2];
+			device_spec = opt;
+			continue;
 		}
-		else
+		realtime = true;
+		if (!strcmp(opt, "--rt")) continue;
+		int* value = 0;
+		if (!strcmp(opt, "--acquire-cpu")) value = &acquire_rt.cpu;
+		else if (!strcmp(opt, "--acquire-priority")) value = &acquire_rt.priority;
+		else if (!strcmp(opt, "--fusion-cpu")) value = &fusion_rt.cpu;
+		else if (!strcmp(opt, "--fusion-priority")) value = &fusion_rt.priority;
+		if (!value || a + 1 >= argc)
 		{
-			ready = 1;
-			sort(arr.end() - SPLIT_MARKER, arr.end());
-			return ((arr[arr.size() / 2 - 1]) + arr[arr.size() / 2 - 1]) / 2;
+			printf("bad option %s\n", opt);
+			usage(argv[0]);
+			return 1;
 		}
+		*value = atoi(argv[++a]);
 	}
-}
 
-vector<double> editVector(vector<double> arr) {
-	for (int i = 0; i < arr.size(); i++) {
-		if (i != arr.size()-1) {
-			arr.at(i) = arr.at(i+1);
-		}
-		return arr;
+	//locked before the buffers below are made, so all of them are resident
+	//for good; the kernel's answers go to stderr
+	if (realtime)
+	{
+		rtReportLimits(stderr);
+		rtLockMemory(stderr);
 	}
-} 
 
-int read_imu(uint8_t card, uint8_t reg) //reads the raw values
-{
-	int32_t status = 0;
-	uint8_t low_byte = 0, high_byte = 0;
-	int result;
-	status = skiq_read_accel_reg(card, reg, &high_byte, 1);
-	if (status == 0) status = skiq_read_accel_reg(card, reg + 1, &low_byte, 1);
-	if (status == 0)
+	ImuDevice* device = createDevice(device_spec);
+	if (!device)
 	{
-		result = (((int)high_byte) << 8) | low_byte;
-		if (result >= 0x8000) result = result - 0x10000;
-		return result;
+		usage(argv[0]);
+		return 1;
 	}
-}
-
-
-int main()
-{
-	uint8_t card = 0;
-	vector<double> acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z; //raw_values
+	if (!device->open())
+	{
+		printf("could not open %s\n", device_spec);
+		delete device;
+		return 1;
+	}
+	MedianWindow acc_x, acc_y, acc_z; //raw accel values, the last MEDIAN_WINDOW of each
+	double gyro_x, gyro_y, gyro_z; //deg/s
 	double median_ax, median_ay, median_az = 0;
 	double angle_ax, angle_ay, angle_az = 0;
 	double angle_gx, angle_gy, angle_gz = 0;
 	double finalAngle_x, finalAngle_y, finalAngle_z = 0;
 
-	fstream data;
-	data.open("imu_data.csv");
-	data << "Median Accel X, Median Accel Y, Median Accel Z, Raw Gyro X, Raw Gyro Y, Raw Gyro Z, Delta Theta X, Delta Theta Y, Delta Theta Z, filtered theta X, filtered theta Y, filtered theta Z" << endl;
-
-/*
-	fstream data("Path_To_File.csv");
-	data << "Median Accel X, Median Accel Y, Median Accel Z, Raw Gyro X, Raw Gyro Y, Raw Gyro Z, Delta Theta X, Delta Theta Y, Delta Theta Z, filtered theta X, filtered theta Y, filtered theta Z" << endl;
-*/
+	// attitude filter, warm started from the last snapshot so attitude is
+	// available immediately after a processor reset
+	ImuFilter filter;
+	filter.setAlgorithmGain(FILTER_GAIN);
+	filter.setDriftBiasGain(FILTER_ZETA);
+	filter.setWorldFrame(WorldFrame::ENU);
+	bool warm = warmStart(SNAPSHOT_PATH, SNAPSHOT_MAX_AGE, filter);
+	if (warm)
+		printf("restored filter state from %s\n", SNAPSHOT_PATH);
+	FilterSnapshot snapshot;
+	struct timespec now;
 
 	//this is the config code that changes the Gyro Config register to 1000dps
 	uint8_t config_byte = 0;
 	uint8_t right_side = 0, left_side = 0;
-	skiq_read_accel_reg(card, 0x1B, &config_byte, 1);
+	device->readRegisters(ICM_GYRO_CONFIG, &config_byte, 1);
 	left_side = config_byte >> 5;
 	left_side = config_byte << 5;
 	right_side = config_byte & 7;
 	left_side = left_side | right_side;
 	left_side = left_side | GYRO_CONFIG;
 
-	//intialize the sidekiq
-	skiq_init(skiq_xport_type_auto, skiq_xport_init_level_basic, &card, 1);
-	
-	//configure the above in the sidekiq
-	skiq_write_accel_reg(card, 0x1B, &config_byte, 1);
+	//configure the above in the sensor
+	device->writeRegisters(ICM_GYRO_CONFIG, &config_byte, 1);
+
+	//binary flight log of the raw register values; the header holds the
+	//scale factors and the register config needed to convert them
+	FlightLogHeader header;
+	initFlightLogHeader(header);
+	struct timespec start;
+	clock_gettime(CLOCK_REALTIME, &start);
+	header.start_ns = (uint64_t)start.tv_sec * 1000000000ull + start.tv_nsec;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	header.smplrt_div = device->readRegister(ICM_SMPLRT_DIV);
+	header.config = device->readRegister(ICM_CONFIG);
+	header.gyro_config = device->readRegister(ICM_GYRO_CONFIG);
+	header.accel_config = device->readRegister(ICM_ACCEL_CONFIG);
+	header.accel_config2 = device->readRegister(ICM_ACCEL_CONFIG2);
+	header.accel_scale = (2 << ((header.accel_config >> 3) & 3)) / FLIGHT_LOG_ACCEL_COUNTS; // AFS_SEL
+	header.gyro_scale = FSR / FLIGHT_LOG_GYRO_COUNTS;
+	header.temp_scale = 1 / TEMP_SENSITIVITY;
+	header.temp_offset = TEMP_OFFSET;
+	RingStorage ring;
+	FlightLogWriter log;
+	if (!ring.open(LOG_RING_DIR, LOG_RING_SEGMENTS, LOG_SEGMENT_BYTES) || !log.open(ring, header))
+		printf("could not open %s\n", LOG_RING_DIR);
+	FlightLogRecord record;
 
-	for (int i = 0; i < PULL_NUMBER; i++) // 100HZ of data samples for 1 hr
+	//telemetry packets are built on their own thread from the samples the
+	//loop below hands over through the ring, so the loop only copies them;
+	//the same thread saves the filter snapshots the loop captures
+	SampleRing samples;
+	SpscRing<FilterSnapshot> snapshots(SNAPSHOT_RING_SIZE);
+	TelemetryPacketizer packetizer(header.start_ns, TM_ATTITUDE_DECIMATION, TM_RAW_DECIMATION, TM_PACKET_SIZE);
+	FileSink telemetry;
+	if (!telemetry.open(TM_PATH))
+		printf("could not open %s\n", TM_PATH);
+	atomic<bool> acquiring(true);
+	thread telemetry_thread([&]()
 	{
-		acc_x.push_back(read_imu(card, 0x3b));
-		acc_y.push_back(read_imu(card, 0x3d));
-		acc_z.push_back(read_imu(card, 0x3f));
-		gyro_x.push_back(read_imu(card, 0x43)* FSR / (pow(2, 15) - 1));
-		gyro_y.push_back(read_imu(card, 0x45)* FSR / (pow(2, 15) - 1));
-		gyro_z.push_back(read_imu(card, 0x47)* FSR / (pow(2, 15) - 1));
-
-		//median filter for accel
-		median_ax = median(acc_x);
-		median_ay = median(acc_y);
-		median_az = median(acc_z);
-
-		//rolling median filter
-		editVector(acc_x);
-		editVector(acc_y);
-		editVector(acc_z);
-
-		//arctan A for accel to convert raw values to angles
-		if (ready == 1)
+		while (acquiring.load())
+		{
+			if (latency_dump)
+			{
+				latency_dump = 0;
+				printLatency();
+			}
+			packetizer.drain(samples, telemetry);
+			saveLatestSnapshot(snapshots);
+			usleep(TM_POLL_US);
+		}
+		packetizer.drain(samples, telemetry);
+		packetizer.flush(telemetry);
+		saveLatestSnapshot(snapshots);
+	});
+
+	//live stream for ground-support tools, on its own thread and ring so a
+	//slow client only ever costs the stream frames
+	SampleRing stream_samples;
+	SampleStreamer streamer;
+	bool streaming = streamer.openUnix(STREAM_PATH);
+	if (!streaming)
+		printf("could not listen on %s\n", STREAM_PATH);
+	thread stream_thread([&]()
+	{
+		while (streaming && acquiring.load())
+		{
+			streamer.poll(stream_samples);
+			usleep(STREAM_POLL_US);
+		}
+	});
+
+	//latest attitude for the other flight processes, read lock-free
+	AttitudePublisher attitude;
+	if (!attitude.open())
+		printf("could not create shared memory %s\n", ATTITUDE_SHM_NAME);
+	signal(SIGUSR1, requestLatencyDump);
+
+	//the attitude filter and everything after it run on their own thread,
+	//woken for each sample the acquisition loop hands over, so that the
+	//register reads keep their timing whatever fusion and output cost
+	SpscRing<AcquiredSample> acquired(FUSION_RING_SIZE);
+	sem_t acquired_ready;
+	sem_init(&acquired_ready, 0, 0);
+	atomic<bool> acquisition_done(false);
+	uint64_t fusion_faults = 0;
+	thread fusion_thread([&]()
+	{
+		if (realtime)
+		{
+			rtApplyThread("fusion", fusion_rt, stderr);
+			rtPrefaultStack(RT_STACK_PREFAULT);
+		}
+		RingSample sample;
+		AttitudeState state;
+		uint64_t last_t_ns = 0;
+		int fused = 0;
+		for (;;)
+		{
+			if (sem_wait(&acquired_ready) != 0)
+				continue; //interrupted by a signal
+			bool last = acquisition_done.load();
+			size_t n;
+			for (const AcquiredSample* s = acquired.peek(n); n > 0; s = acquired.peek(n))
+			{
+				for (size_t k = 0; k < n; k++, fused++)
+				{
+					//from here on nothing in the loop may allocate
+					if (fused == ALLOC_GUARD_WARMUP)
+					{
+						ALLOC_GUARD_ARM();
+						fusion_faults = rtPageFaults();
+					}
+					const FlightLogRecord& record = s[k].raw;
+					bool read_error = (record.flags & FLIGHT_LOG_FLAG_READ_ERROR) != 0;
+					uint64_t t_fusion = monotonicNs();
+					latency[LAT_HANDOFF].record(t_fusion - s[k].t_acquired);
+
+					acc_x.push(record.accel[0]);
+					acc_y.push(record.accel[1]);
+					acc_z.push(record.accel[2]);
+					gyro_x = record.gyro[0] * header.gyro_scale;
+					gyro_y = record.gyro[1] * header.gyro_scale;
+					gyro_z = record.gyro[2] * header.gyro_scale;
+
+					//attitude filter, gyro in rad/s; dt is the measured sample spacing
+					float dt = (record.t_ns - last_t_ns) * 1e-9f;
+					last_t_ns = record.t_ns;
+					float ax = record.accel[0], ay = record.accel[1], az = record.accel[2];
+					float gx = gyro_x, gy = gyro_y, gz = gyro_z;
+					filter.madgwickAHRSupdateIMU(gx * DEG_TO_RAD, gy * DEG_TO_RAD, gz * DEG_TO_RAD, ax, ay, az, dt);
+					uint64_t t_fused = monotonicNs();
+					latency[LAT_FUSION].record(t_fused - t_fusion);
+					sample.raw = record;
+					double q0, q1, q2, q3;
+					filter.getOrientation(q0, q1, q2, q3);
+					sample.q[0] = q0;
+					sample.q[1] = q1;
+					sample.q[2] = q2;
+					sample.q[3] = q3;
+					samples.push(sample);
+					if (streaming)
+						stream_samples.push(sample);
+					state.t_ns = s[k].t_acquired;
+					state.sample = fused + 1;
+					state.q[0] = q0;
+					state.q[1] = q1;
+					state.q[2] = q2;
+					state.q[3] = q3;
+					state.rate[0] = gx * DEG_TO_RAD;
+					state.rate[1] = gy * DEG_TO_RAD;
+					state.rate[2] = gz * DEG_TO_RAD;
+					state.flags = ATTITUDE_FLAG_VALID | (warm ? ATTITUDE_FLAG_WARM_START : 0) |
+						(read_error ? ATTITUDE_FLAG_READ_ERROR : 0);
+					attitude.publish(state);
+					uint64_t t_published = monotonicNs();
+					latency[LAT_OUTPUT].record(t_published - t_fused);
+					latency[LAT_END_TO_END].record(t_published - s[k].t_read);
+					if ((fused + 1) % SNAPSHOT_INTERVAL == 0)
+					{
+						captureSnapshot(filter, snapshot);
+						snapshots.push(snapshot);
+					}
+
+					//median filter for accel
+					uint64_t t_median = monotonicNs();
+					ready = acc_x.ready();
+					median_ax = acc_x.median();
+					median_ay = acc_y.median();
+					median_az = acc_z.median();
+
+					//arctan A for accel to convert raw values to angles
+					if (ready == 1)
+					{
+						angle_ax = (atan2(median_ax, median_az) * RAD_TO_DEGREES);
+						angle_ay = (atan2(median_ay, median_az) * RAD_TO_DEGREES);
+						angle_az = (atan2(median_az, median_ay) * RAD_TO_DEGREES);
+					}
+
+					//integrate gyro values into angle
+					if (fused == 0)
+					{
+						angle_gx = (gyro_x + finalAngle_x) * DELTA_TIME;
+						angle_gy = (gyro_y + finalAngle_y) * DELTA_TIME;
+						angle_gz = (gyro_z + finalAngle_z) * DELTA_TIME;
+					}
+
+					//complimentary filter
+					finalAngle_x = compFilter(angle_gx, angle_ax);
+					finalAngle_y = compFilter(angle_gy, angle_ay);
+					finalAngle_z = compFilter(angle_gz, angle_az);
+					latency[LAT_MEDIAN].record(monotonicNs() - t_median);
+				}
+				acquired.consume(n);
+			}
+			if (last)
+				break;
+		}
+		if (fused > ALLOC_GUARD_WARMUP)
 		{
-			angle_ax = (atan2(median_ax, median_az) * RAD_TO_DEGREES);
-			angle_ay = (atan2(median_ay, median_az) * RAD_TO_DEGREES);
-			angle_az = (atan2(median_az, median_ay) * RAD_TO_DEGREES);
+			fusion_faults = rtPageFaults() - fusion_faults;
+			ALLOC_GUARD_DISARM();
 		}
+		else
+			fusion_faults = 0;
+	});
 
-		//integrate gyro values into angle
-		if (i == 0)
+	//the loop runs on the main thread; the threads above were started
+	//before it took its real-time settings, so only fusion has its own
+	if (realtime)
+	{
+		rtApplyThread("acquisition", acquire_rt, stderr);
+		rtPrefaultStack(RT_STACK_PREFAULT);
+	}
+	uint64_t acquire_faults = 0;
+	int i;
+	for (i = 0; i < PULL_NUMBER && !device->finished(); i++) // 100HZ of data samples for 1 hr
+	{
+		//from here on nothing in the loop may allocate
+		if (i == ALLOC_GUARD_WARMUP)
 		{
-			angle_gx = (gyro_x[i] + finalAngle_x) * DELTA_TIME;
-			angle_gy = (gyro_y[i] + finalAngle_y) * DELTA_TIME;
-			angle_gz = (gyro_z[i] + finalAngle_z) * DELTA_TIME;
+			ALLOC_GUARD_ARM();
+			acquire_faults = rtPageFaults();
 		}
-		
-		//complimentary filter
-		finalAngle_x = compFilter(angle_gx, angle_ax);
-		finalAngle_y = compFilter(angle_gy, angle_ay);
-		finalAngle_z = compFilter(angle_gz, angle_az);
-
-		//output into a .csv file
-		data << ("%.9f", median_ax);
-		data << ",";
-		data << ("%.9f", median_ay);
-		data << ",";
-		data << ("%.9f", median_az);
-		data << ",";
-		data << ("%.9f", gyro_x[i]);
-		data << ",";
-		data << ("%.9f", gyro_y[i]);
-		data << ",";
-		data << ("%.9f", gyro_z[i]);
-		data << ",";
-		data << ("%.9f", angle_gx);
-		data << ",";
-		data << ("%.9f", angle_gy);
-		data << ",";
-		data << ("%.9f", angle_gz);
-		data << ",";
-		data << ("%.9f", finalAngle_x);
-		data << ",";
-		data << ("%.9f", finalAngle_y);
-		data << ",";
-		data << ("%.9f", finalAngle_z) << endl;
+		read_failed = 0;
+		uint64_t t_read = monotonicNs();
+		record.accel[0] = read_imu(*device, 0x3b);
+		record.accel[1] = read_imu(*device, 0x3d);
+		record.accel[2] = read_imu(*device, 0x3f);
+		record.temp = read_imu(*device, 0x41);
+		record.gyro[0] = read_imu(*device, 0x43);
+		record.gyro[1] = read_imu(*device, 0x45);
+		record.gyro[2] = read_imu(*device, 0x47);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		uint64_t t_acquired = monotonicNs(now);
+		latency[LAT_ACQUIRE].record(t_acquired - t_read);
+		record.t_ns = (uint64_t)(now.tv_sec - start.tv_sec) * 1000000000ull + now.tv_nsec - start.tv_nsec;
+		record.flags = read_failed ? FLIGHT_LOG_FLAG_READ_ERROR : 0;
+		log.append(record);
+		if (fabs(record.gyro[0] * header.gyro_scale) > PIN_GYRO_RATE ||
+			fabs(record.gyro[1] * header.gyro_scale) > PIN_GYRO_RATE ||
+			fabs(record.gyro[2] * header.gyro_scale) > PIN_GYRO_RATE)
+			ring.pin(log.segment());
+
+		AcquiredSample handoff = { record, t_read, t_acquired };
+		acquired.push(handoff);
+		sem_post(&acquired_ready);
 
 		usleep(DELTA_TIME);
 
 	}
-	data.close();
-	skiq_exit();
+	if (i > ALLOC_GUARD_WARMUP)
+	{
+		acquire_faults = rtPageFaults() - acquire_faults;
+		ALLOC_GUARD_DISARM();
+	}
+	else
+		acquire_faults = 0;
+	acquisition_done.store(true);
+	sem_post(&acquired_ready);
+	fusion_thread.join();
+	sem_destroy(&acquired_ready);
+	if (acquired.overruns() > 0)
+		printf("%llu samples not fused, fusion thread overrun\n", (unsigned long long)acquired.overruns());
+	if (realtime)
+		fprintf(stderr, "rt: page faults after warm-up: acquisition %llu, fusion %llu\n",
+			(unsigned long long)acquire_faults, (unsigned long long)fusion_faults);
+	attitude.close();
+	acquiring.store(false);
+	telemetry_thread.join();
+	stream_thread.join();
+	streamer.close();
+	if (streamer.droppedFrames() > 0)
+		printf("%llu stream frames dropped, client too slow\n", (unsigned long long)streamer.droppedFrames());
+	if (!telemetry.close())
+		printf("error writing %s\n", TM_PATH);
+	if (samples.overruns() > 0)
+		printf("%llu samples missing from telemetry, ring overrun\n", (unsigned long long)samples.overruns());
+	if (!log.close())
+		printf("error writing %s\n", LOG_RING_DIR);
+	if (log.overruns() > 0)
+		printf("%llu samples dropped, log writer overrun\n", (unsigned long long)log.overruns());
+	if (ring.refused() > 0)
+		printf("%llu log segments dropped, every segment pinned\n", (unsigned long long)ring.refused());
+	if (ring.rejectedPins() > 0)
+		printf("%llu pins not applied, segment already overwritten\n", (unsigned long long)ring.rejectedPins());
+	printLatency();
+	captureSnapshot(filter, snapshot);
+	saveSnapshot(SNAPSHOT_PATH, snapshot);
+	device->close();
+	delete device;
 }
 
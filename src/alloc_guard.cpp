@@ -0,0 +1,152 @@
+#include "../include/alloc_guard.h"
+
+#ifdef IMU_ALLOC_GUARD
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <new>
+
+// glibc exports its allocator under these names as well, which lets the
+// replacements below forward to it
+#if defined(__GLIBC__) && !defined(__UCLIBC__)
+#define HOOK_MALLOC 1
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+#define RAW_MALLOC __libc_malloc
+#else
+#define RAW_MALLOC malloc
+#endif
+
+// nesting depth of guarded sections on this thread; a POD so that reading
+// it from inside malloc never allocates
+static __thread unsigned guard_depth = 0;
+static std::atomic<uint64_t> violations(0);
+
+void allocGuardArm()
+{
+  guard_depth++;
+}
+
+void allocGuardDisarm()
+{
+  if (guard_depth > 0) guard_depth--;
+}
+
+uint64_t allocGuardViolations()
+{
+  return violations.load();
+}
+
+static void check(const char* what)
+{
+  if (guard_depth == 0) return;
+  violations++;
+  // no stdio here: it may allocate
+  static const char prefix[] = "alloc_guard: ";
+  static const char suffix[] = " inside a guarded section\n";
+  ssize_t ignored = write(2, prefix, sizeof(prefix) - 1);
+  ignored = write(2, what, strlen(what));
+  ignored = write(2, suffix, sizeof(suffix) - 1);
+  (void)ignored;
+  abort();
+}
+
+static void* allocate(size_t size, const char* what)
+{
+  check(what);
+  return RAW_MALLOC(size ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+  void* p = allocate(size, "operator new");
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  void* p = allocate(size, "operator new[]");
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+  return allocate(size, "operator new");
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+  return allocate(size, "operator new[]");
+}
+
+void operator delete(void* p) throw()
+{
+  free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+  free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+  free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) throw()
+{
+  free(p);
+}
+
+#ifdef HOOK_MALLOC
+
+extern "C" void* malloc(size_t size)
+{
+  check("malloc");
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+  check("calloc");
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* p, size_t size)
+{
+  check("realloc");
+  return __libc_realloc(p, size);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size)
+{
+  check("memalign");
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size)
+{
+  check("aligned_alloc");
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** out, size_t alignment, size_t size)
+{
+  check("posix_memalign");
+  void* p = __libc_memalign(alignment, size);
+  if (!p) return ENOMEM;
+  *out = p;
+  return 0;
+}
+
+#endif // HOOK_MALLOC
+
+#endif // IMU_ALLOC_GUARD
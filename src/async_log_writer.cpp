@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include "../include/async_log_writer.h"
+#include "../include/stage_probe.h"
+
+// The producer publishes a buffer with a release store of head_ and then
+// notifies without taking lock_, so it can never block on the writer
+// thread. A notification that slips in between the writer's empty check
+// and its wait is therefore possible; the writer's timed wait bounds the
+// delay that causes.
+#define WRITER_POLL_MS 20
+
+AsyncLogWriter::AsyncLogWriter(size_t buffer_size, unsigned buffer_count) :
+    memory_(0), lengths_(0), starts_(0), sink_(0), segment_pending_(false),
+    head_(0), tail_(0), fill_(0),
+    stop_(false), failed_(false), overruns_(0), dropped_bytes_(0)
+{
+  size_t page = sysconf(_SC_PAGESIZE);
+  buffer_size_ = (buffer_size + page - 1) / page * page;
+  buffer_count_ = buffer_count < 2 ? 2 : buffer_count;
+
+  void* memory;
+  if (posix_memalign(&memory, page, buffer_size_ * buffer_count_) == 0)
+  {
+    // touch every page now so the first pass through the buffers does not
+    // take page faults on the acquisition thread
+    memset(memory, 0, buffer_size_ * buffer_count_);
+    memory_ = (char*)memory;
+  }
+  lengths_ = new size_t[buffer_count_];
+  starts_ = new bool[buffer_count_];
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+  close();
+  free(memory_);
+  delete[] lengths_;
+  delete[] starts_;
+}
+
+bool AsyncLogWriter::open(const char* path)
+{
+  close();
+  if (!memory_ || !file_.open(path)) return false;
+  return open(&file_);
+}
+
+bool AsyncLogWriter::open(LogSink* sink)
+{
+  close();
+  if (!memory_) return false;
+  sink_ = sink;
+
+  head_.store(0);
+  tail_.store(0);
+  fill_ = 0;
+  segment_pending_ = false;
+  for (unsigned b = 0; b < buffer_count_; b++) starts_[b] = false;
+  stop_ = false;
+  failed_ = false;
+  overruns_ = 0;
+  dropped_bytes_ = 0;
+  thread_ = std::thread(&AsyncLogWriter::run, this);
+  return true;
+}
+
+bool AsyncLogWriter::write(const void* data, size_t len)
+{
+  if (!sink_) return false;
+
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  uint64_t queued = head - tail_.load(std::memory_order_acquire);
+  size_t room = buffer_size_ - fill_;
+
+  // the producer's buffer is still queued, or the write spills over into
+  // a next buffer that is
+  if (len > buffer_size_ || queued >= buffer_count_ ||
+      (len > room && queued + 1 >= buffer_count_))
+  {
+    overruns_++;
+    dropped_bytes_ += len;
+    return false;
+  }
+
+  const char* p = (const char*)data;
+  if (fill_ == 0) claim(head);
+  if (len > room)
+  {
+    memcpy(memory_ + (head % buffer_count_) * buffer_size_ + fill_, p, room);
+    fill_ += room;
+    publish();
+    head++;
+    claim(head);
+    p += room;
+    len -= room;
+  }
+  memcpy(memory_ + (head % buffer_count_) * buffer_size_ + fill_, p, len);
+  fill_ += len;
+  if (fill_ == buffer_size_) publish();
+  return true;
+}
+
+// a buffer the producer starts filling inherits a pending segment start
+void AsyncLogWriter::claim(uint64_t head)
+{
+  starts_[head % buffer_count_] = segment_pending_;
+  segment_pending_ = false;
+}
+
+void AsyncLogWriter::publish()
+{
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  lengths_[head % buffer_count_] = fill_;
+  fill_ = 0;
+  head_.store(head + 1, std::memory_order_release);
+  wake_.notify_one();
+}
+
+void AsyncLogWriter::flush()
+{
+  // fill_ is only ever non-zero while the producer owns its buffer
+  if (sink_ && fill_ > 0) publish();
+}
+
+void AsyncLogWriter::endSegment()
+{
+  flush();
+  segment_pending_ = true;
+}
+
+bool AsyncLogWriter::close()
+{
+  if (!sink_) return true;
+  flush();
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+
+  bool ok = !failed_;
+  ok = sink_->close() && ok;
+  sink_ = 0;
+  return ok;
+}
+
+void AsyncLogWriter::run()
+{
+  for (;;)
+  {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      if (stop_ && tail == head_.load(std::memory_order_acquire)) break;
+      wake_.wait_for(guard, std::chrono::milliseconds(WRITER_POLL_MS));
+      continue;
+    }
+
+    size_t b = tail % buffer_count_;
+    {
+      STAGE_PROBE(PROBE_LOG_WRITE);
+      if (starts_[b] && !sink_->nextSegment()) failed_ = true;
+      if (!sink_->write(memory_ + b * buffer_size_, lengths_[b])) failed_ = true;
+    }
+    tail_.store(tail + 1, std::memory_order_release);
+  }
+}
@@ -0,0 +1,100 @@
+#include <cmath>
+#include "../include/attitude_resample.h"
+#include "../include/tf2/LinearMath/Quaternion.h"
+
+// targets are processed in chunks so that the gathered operands of the
+// vectorized loop stay in L1
+#define CHUNK 256
+
+AttitudeResampler::AttitudeResampler(double max_nlerp_error) :
+    cursor_(0)
+{
+  // the largest deviation of nlerp from slerp between two quaternions that
+  // are an angle W apart on the unit sphere is sqrt(3)/108 * W^3
+  double w = cbrt(max_nlerp_error * 108.0 / sqrt(3.0));
+  nlerp_min_dot_ = cos(w);
+}
+
+// out = normalize((1 - u) a + u sign(a.b) b) for every lane; lanes whose
+// operands are too far apart for nlerp are flagged for the slerp fixup.
+// The loop is kept branch free, and the flags are doubles rather than a
+// narrower type, so that GCC vectorizes it with a single vector width.
+static void nlerpChunk(size_t n, double min_dot,
+    const double* __restrict a0, const double* __restrict a1,
+    const double* __restrict a2, const double* __restrict a3,
+    const double* __restrict b0, const double* __restrict b1,
+    const double* __restrict b2, const double* __restrict b3,
+    const double* __restrict u,
+    double* __restrict o0, double* __restrict o1,
+    double* __restrict o2, double* __restrict o3,
+    double* __restrict far)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    double dot = a0[i] * b0[i] + a1[i] * b1[i] + a2[i] * b2[i] + a3[i] * b3[i];
+    double ub = copysign(u[i], dot);
+    double ua = 1.0 - u[i];
+    double x0 = ua * a0[i] + ub * b0[i];
+    double x1 = ua * a1[i] + ub * b1[i];
+    double x2 = ua * a2[i] + ub * b2[i];
+    double x3 = ua * a3[i] + ub * b3[i];
+    double recipNorm = 1.0 / sqrt(x0 * x0 + x1 * x1 + x2 * x2 + x3 * x3);
+    o0[i] = x0 * recipNorm;
+    o1[i] = x1 * recipNorm;
+    o2[i] = x2 * recipNorm;
+    o3[i] = x3 * recipNorm;
+    far[i] = fabs(dot) < min_dot ? 1.0 : 0.0;
+  }
+}
+
+bool AttitudeResampler::resample(const AttitudeTrack& track,
+    size_t count_out, const double* t_out,
+    double* q0_out, double* q1_out, double* q2_out, double* q3_out)
+{
+  if (track.count == 0) return false;
+
+  double a0[CHUNK], a1[CHUNK], a2[CHUNK], a3[CHUNK];
+  double b0[CHUNK], b1[CHUNK], b2[CHUNK], b3[CHUNK];
+  double u[CHUNK];
+  double far[CHUNK];
+
+  size_t last = track.count - 1;
+  for (size_t start = 0; start < count_out; start += CHUNK)
+  {
+    size_t n = count_out - start < CHUNK ? count_out - start : CHUNK;
+
+    // walk the cursor forward and gather the bracketing samples
+    for (size_t i = 0; i < n; i++)
+    {
+      double t = t_out[start + i];
+      while (cursor_ < last && track.t[cursor_ + 1] <= t) cursor_++;
+
+      size_t ia = cursor_, ib = cursor_ < last ? cursor_ + 1 : cursor_;
+      double span = track.t[ib] - track.t[ia];
+      double f = span > 0.0 ? (t - track.t[ia]) / span : 0.0;
+      u[i] = f < 0.0 ? 0.0 : (f > 1.0 ? 1.0 : f);
+
+      a0[i] = track.q0[ia]; a1[i] = track.q1[ia]; a2[i] = track.q2[ia]; a3[i] = track.q3[ia];
+      b0[i] = track.q0[ib]; b1[i] = track.q1[ib]; b2[i] = track.q2[ib]; b3[i] = track.q3[ib];
+    }
+
+    double* o0 = q0_out + start;
+    double* o1 = q1_out + start;
+    double* o2 = q2_out + start;
+    double* o3 = q3_out + start;
+    nlerpChunk(n, nlerp_min_dot_, a0, a1, a2, a3, b0, b1, b2, b3, u, o0, o1, o2, o3, far);
+
+    for (size_t i = 0; i < n; i++)
+    {
+      if (far[i] == 0.0) continue;
+      tf2::Quaternion qa(a1[i], a2[i], a3[i], a0[i]);
+      tf2::Quaternion qb(b1[i], b2[i], b3[i], b0[i]);
+      tf2::Quaternion q = qa.slerp(qb, u[i]);
+      o0[i] = q.w();
+      o1[i] = q.x();
+      o2[i] = q.y();
+      o3[i] = q.z();
+    }
+  }
+  return true;
+}
@@ -0,0 +1,140 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include "../include/attitude_shm.h"
+
+#define SHM_MAGIC 0x31545441        // "ATT1"
+#define STATE_WORDS (sizeof(AttitudeState) / 4)
+#define READ_RETRIES 1000
+
+// The state is stored as 32-bit atomic words, written and read with
+// relaxed operations between the sequence updates, so that the torn reads
+// a seqlock tolerates (and then discards) are not data races. 32-bit
+// atomics are lock-free on every BUILD_CONFIG, which they must be to work
+// across processes.
+struct AttitudeShm
+{
+  uint32_t magic;
+  uint32_t size;                    // sizeof(AttitudeState)
+  std::atomic<uint32_t> sequence;   // odd while a write is in progress
+  std::atomic<uint32_t> words[STATE_WORDS];
+};
+
+static_assert(sizeof(AttitudeState) % 4 == 0, "attitude state must be whole words");
+
+AttitudePublisher::AttitudePublisher() :
+    shm_(0)
+{
+  memset(&last_, 0, sizeof(last_));
+}
+
+AttitudePublisher::~AttitudePublisher()
+{
+  close();
+}
+
+bool AttitudePublisher::open(const char* name)
+{
+  close();
+  int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) return false;
+  void* p = MAP_FAILED;
+  if (ftruncate(fd, sizeof(AttitudeShm)) == 0)
+    p = mmap(0, sizeof(AttitudeShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) return false;
+
+  // readers treat a zero sequence as nothing published; a new publisher
+  // starts over from there
+  shm_ = (AttitudeShm*)p;
+  shm_->sequence.store(0, std::memory_order_relaxed);
+  shm_->magic = SHM_MAGIC;
+  shm_->size = sizeof(AttitudeState);
+  std::atomic_thread_fence(std::memory_order_release);
+  memset(&last_, 0, sizeof(last_));
+  return true;
+}
+
+void AttitudePublisher::publish(const AttitudeState& state)
+{
+  last_ = state;
+  if (!shm_) return;
+
+  uint32_t words[STATE_WORDS];
+  memcpy(words, &state, sizeof(words));
+  uint32_t sequence = shm_->sequence.load(std::memory_order_relaxed);
+  shm_->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t i = 0; i < STATE_WORDS; i++) shm_->words[i].store(words[i], std::memory_order_relaxed);
+  // after 2^31 publishes the count wraps; it skips 0, which readers take
+  // for nothing published
+  uint32_t next = sequence + 2;
+  if (next == 0) next = 2;
+  shm_->sequence.store(next, std::memory_order_release);
+}
+
+void AttitudePublisher::close()
+{
+  if (!shm_) return;
+  last_.flags |= ATTITUDE_FLAG_STOPPED;
+  publish(last_);
+  munmap(shm_, sizeof(AttitudeShm));
+  shm_ = 0;
+}
+
+AttitudeSubscriber::AttitudeSubscriber() :
+    shm_(0)
+{
+}
+
+AttitudeSubscriber::~AttitudeSubscriber()
+{
+  close();
+}
+
+bool AttitudeSubscriber::open(const char* name)
+{
+  close();
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) return false;
+  void* p = mmap(0, sizeof(AttitudeShm), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) return false;
+
+  const AttitudeShm* shm = (const AttitudeShm*)p;
+  if (shm->magic != SHM_MAGIC || shm->size != sizeof(AttitudeState))
+  {
+    munmap(p, sizeof(AttitudeShm));
+    return false;
+  }
+  shm_ = shm;
+  return true;
+}
+
+bool AttitudeSubscriber::read(AttitudeState& state) const
+{
+  if (!shm_) return false;
+  uint32_t words[STATE_WORDS];
+  for (int retry = 0; retry < READ_RETRIES; retry++)
+  {
+    uint32_t before = shm_->sequence.load(std::memory_order_acquire);
+    if (before == 0) return false;
+    if (before & 1) continue;
+    for (size_t i = 0; i < STATE_WORDS; i++) words[i] = shm_->words[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (shm_->sequence.load(std::memory_order_relaxed) == before)
+    {
+      memcpy(&state, words, sizeof(state));
+      return true;
+    }
+  }
+  return false;
+}
+
+void AttitudeSubscriber::close()
+{
+  if (shm_) munmap((void*)shm_, sizeof(AttitudeShm));
+  shm_ = 0;
+}
@@ -0,0 +1,358 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "../include/cpu_dispatch.h"
+#include "../include/dsp_kernels.h"
+#include "../include/imu_filter.h"
+#include "../include/sample_filters.h"
+#include "../include/tf2/LinearMath/Quaternion.h"
+
+using namespace std;
+
+// micro-benchmarks of the flight loop's hot paths on fixed synthetic
+// inputs. Every benchmark is warmed up, then timed in SAMPLES batches of
+// enough operations to take BATCH_NS; the median and the median absolute
+// deviation of the per-batch ns/op are reported, so a stray interrupt or
+// frequency change moves neither. Results go to stdout as JSON, a table to
+// stderr.
+
+#define INPUTS 1024             // synthetic inputs, cycled through
+#define WARMUP_NS 200000000LL
+#define BATCH_NS 5000000LL
+#define SAMPLES 31
+#define BANK_LANES 32           // gainSweep's filter bank width
+
+// keeps the compiler from dropping a result it can see is unused
+template <typename T>
+static inline void keep(const T& value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+static long long nanoseconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// one benchmark: run(n) performs n operations
+struct Benchmark
+{
+	const char* name;
+	void (*run)(size_t n);
+};
+
+struct Result
+{
+	string name;
+	double ns_per_op, mad_ns, min_ns;
+	size_t batch;
+};
+
+// fixed synthetic IMU data: a slow tumble with gravity, an earth-like
+// field and a little deterministic noise, in rad/s, g and uT
+static float gx[INPUTS], gy[INPUTS], gz[INPUTS], ax[INPUTS], ay[INPUTS], az[INPUTS];
+static float mx[INPUTS], my[INPUTS], mz[INPUTS];
+static int16_t raw[INPUTS];
+static uint8_t raw_bytes[2 * INPUTS];
+static float scaled[INPUTS];
+static double angles[2 * INPUTS];
+static tf2::Quaternion quats[INPUTS];
+static tf2::Vector3 vectors[INPUTS];
+static FlightLogRecord records[INPUTS];
+static FlightLogHeader header;
+static double column_t[INPUTS];
+static float columns[6][INPUTS];
+static double bank_q[4][BANK_LANES], bank_gain[BANK_LANES];
+static double bank_sum[BANK_LANES], bank_sum_sq[BANK_LANES], bank_max[BANK_LANES], bank_last[BANK_LANES];
+
+static void makeInputs()
+{
+	srand(42);
+	for (int i = 0; i < INPUTS; i++)
+	{
+		double t = i * 0.01;
+		float noise = (rand() % 2001 - 1000) * 1e-6f;
+		gx[i] = 0.3f * sin(t) + noise;
+		gy[i] = 0.2f * cos(0.7 * t) - noise;
+		gz[i] = 0.05f + noise;
+		ax[i] = 0.1f * sin(t) + noise;
+		ay[i] = 0.1f * cos(t) - noise;
+		az[i] = 0.99f + noise;
+		mx[i] = 22.0f + 100 * noise;
+		my[i] = 5.0f - 100 * noise;
+		mz[i] = -40.0f + 100 * noise;
+		raw[i] = (int16_t)(rand() % 65536 - 32768);
+		raw_bytes[2 * i] = (uint8_t)(raw[i] >> 8);
+		raw_bytes[2 * i + 1] = (uint8_t)raw[i];
+		angles[2 * i] = 45 * sin(t);
+		angles[2 * i + 1] = 45 * sin(t + 0.01);
+		quats[i].setRPY(sin(t), cos(0.5 * t), 0.1 * t);
+		vectors[i] = tf2::Vector3(ax[i], ay[i], az[i]);
+		records[i].t_ns = i * 10000000ULL;
+		records[i].accel[0] = (int16_t)(ax[i] * 16384);
+		records[i].accel[1] = (int16_t)(ay[i] * 16384);
+		records[i].accel[2] = (int16_t)(az[i] * 16384);
+		records[i].gyro[0] = (int16_t)(gx[i] * 1000);
+		records[i].gyro[1] = (int16_t)(gy[i] * 1000);
+		records[i].gyro[2] = (int16_t)(gz[i] * 1000);
+	}
+	header.accel_scale = 1 / 16384.0f;
+	header.gyro_scale = 1 / 16.4f;
+	for (int k = 0; k < BANK_LANES; k++)
+	{
+		bank_q[0][k] = 1;
+		bank_gain[k] = 0.01 + 0.02 * k;
+	}
+}
+
+static void benchMadgwickImu(size_t n)
+{
+	static ImuFilter filter;
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t k = i % INPUTS;
+		filter.madgwickAHRSupdateIMU(gx[k], gy[k], gz[k], ax[k], ay[k], az[k], 0.01f);
+	}
+	keep(filter);
+}
+
+static void benchMadgwickMarg(size_t n)
+{
+	static ImuFilter filter;
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t k = i % INPUTS;
+		filter.madgwickAHRSupdate(gx[k], gy[k], gz[k], ax[k], ay[k], az[k], mx[k], my[k], mz[k], 0.01f);
+	}
+	keep(filter);
+}
+
+static void benchMedian(size_t n)
+{
+	static MedianWindow window;
+	double sum = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		window.push(raw[i % INPUTS]);
+		sum += window.median();
+	}
+	keep(sum);
+}
+
+static void benchCompFilter(size_t n)
+{
+	double angle = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t k = i % INPUTS;
+		angle += compFilter(angles[2 * k], angles[2 * k + 1]);
+	}
+	keep(angle);
+}
+
+static void benchRawValue(size_t n)
+{
+	int sum = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t k = i % INPUTS;
+		sum += rawValue(raw_bytes[2 * k], raw_bytes[2 * k + 1]);
+	}
+	keep(sum);
+}
+
+// per sample, in blocks of INPUTS
+static void benchScaleRaw(size_t n)
+{
+	for (size_t done = 0; done < n; done += INPUTS)
+	{
+		scaleRaw(min((size_t)INPUTS, n - done), raw, 1000 / 32767.0f, scaled);
+		keep(scaled);
+	}
+}
+
+// per record, in blocks of INPUTS
+static void benchConvertRecords(size_t n)
+{
+	for (size_t done = 0; done < n; done += INPUTS)
+	{
+		convertRecords(min((size_t)INPUTS, n - done), records, header, 3.14159265358979f / 180.0f,
+			column_t, columns[0], columns[1], columns[2], columns[3], columns[4], columns[5]);
+		keep(columns);
+	}
+}
+
+// per output sample, in blocks of the full windows of INPUTS
+static void benchMedianFilter(size_t n)
+{
+	const size_t windows = INPUTS - MEDIAN_WINDOW + 1;
+	for (size_t done = 0; done < n; done += windows)
+	{
+		medianFilter(min(windows, n - done) + MEDIAN_WINDOW - 1, ax, columns[0]);
+		keep(columns);
+	}
+}
+
+// per filter update: samples go to a bank of BANK_LANES filters
+static void benchFilterBank(size_t n)
+{
+	for (size_t done = 0; done < n; done += BANK_LANES)
+	{
+		size_t k = done / BANK_LANES % INPUTS;
+		filterBankUpdateIMU(min((size_t)BANK_LANES, n - done), bank_q[0], bank_q[1], bank_q[2], bank_q[3],
+			bank_gain, WorldFrame::ENU, gx[k], gy[k], gz[k], ax[k], ay[k], az[k], 0.01f);
+	}
+	keep(bank_q);
+}
+
+// per filter, against the bank's first lane
+static void benchAngleError(size_t n)
+{
+	for (size_t done = 0; done < n; done += BANK_LANES)
+		accumulateAngleError(min((size_t)BANK_LANES, n - done), bank_q[0], bank_q[1], bank_q[2], bank_q[3],
+			0.5, 0.5, 0.5, 0.5, bank_sum, bank_sum_sq, bank_max, bank_last);
+	keep(bank_sum);
+}
+
+static void benchQuatMultiply(size_t n)
+{
+	tf2::Quaternion q(0, 0, 0, 1);
+	for (size_t i = 0; i < n; i++) q = q * quats[i % INPUTS];
+	keep(q);
+}
+
+static void benchQuatNormalize(size_t n)
+{
+	tf2::Quaternion q;
+	for (size_t i = 0; i < n; i++)
+	{
+		q = quats[i % INPUTS] * 1.001;
+		q.normalize();
+		keep(q);
+	}
+}
+
+static void benchQuatSlerp(size_t n)
+{
+	tf2::Quaternion q;
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t k = i % INPUTS;
+		q = quats[k].slerp(quats[(k + 1) % INPUTS], 0.3);
+		keep(q);
+	}
+}
+
+static void benchQuatRotate(size_t n)
+{
+	tf2::Vector3 v;
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t k = i % INPUTS;
+		v = tf2::quatRotate(quats[k], vectors[k]);
+		keep(v);
+	}
+}
+
+static const Benchmark benchmarks[] =
+{
+	{ "madgwickAHRSupdateIMU", benchMadgwickImu },
+	{ "madgwickAHRSupdate", benchMadgwickMarg },
+	{ "median", benchMedian },
+	{ "compFilter", benchCompFilter },
+	{ "rawValue", benchRawValue },
+	{ "tf2_quaternion_multiply", benchQuatMultiply },
+	{ "tf2_quaternion_normalize", benchQuatNormalize },
+	{ "tf2_quaternion_slerp", benchQuatSlerp },
+	{ "tf2_quatRotate", benchQuatRotate },
+};
+
+// run at every supported instruction set level
+static const Benchmark kernel_benchmarks[] =
+{
+	{ "scaleRaw", benchScaleRaw },
+	{ "convertRecords", benchConvertRecords },
+	{ "medianFilter", benchMedianFilter },
+	{ "filterBankUpdateIMU", benchFilterBank },
+	{ "accumulateAngleError", benchAngleError },
+};
+
+static Result measure(const Benchmark& b, const string& name)
+{
+	// warm up caches, branch predictors and the clock, and size a batch
+	size_t batch = 1;
+	long long start = nanoseconds(), elapsed;
+	do
+	{
+		long long t = nanoseconds();
+		b.run(batch);
+		elapsed = nanoseconds() - t;
+		if (elapsed < BATCH_NS) batch *= 2;
+	} while (nanoseconds() - start < WARMUP_NS);
+
+	vector<double> ns(SAMPLES);
+	for (int s = 0; s < SAMPLES; s++)
+	{
+		long long t = nanoseconds();
+		b.run(batch);
+		ns[s] = (double)(nanoseconds() - t) / batch;
+	}
+	sort(ns.begin(), ns.end());
+	double med = ns[SAMPLES / 2];
+	vector<double> dev(SAMPLES);
+	for (int s = 0; s < SAMPLES; s++) dev[s] = fabs(ns[s] - med);
+	sort(dev.begin(), dev.end());
+
+	Result r = { name, med, dev[SAMPLES / 2], ns[0], batch };
+	return r;
+}
+
+int main(int argc, char** argv)
+{
+	const char* only = argc > 1 ? argv[1] : 0;
+	makeInputs();
+
+	vector<Result> results;
+	vector<pair<const Benchmark*, string> > runs;
+	for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+		runs.push_back(make_pair(&benchmarks[i], string(benchmarks[i].name)));
+	CpuIsa selected = cpuIsa();
+	for (int isa = 0; isa < ISA_COUNT; isa++)
+	{
+		if (!cpuSupports((CpuIsa)isa)) continue;
+		for (size_t i = 0; i < sizeof(kernel_benchmarks) / sizeof(kernel_benchmarks[0]); i++)
+			runs.push_back(make_pair(&kernel_benchmarks[i],
+				string(kernel_benchmarks[i].name) + "/" + cpuIsaName((CpuIsa)isa)));
+	}
+
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		const string& name = runs[i].second;
+		if (only && name.find(only) == string::npos) continue;
+		size_t slash = name.find('/');
+		if (slash != string::npos) setCpuIsa(parseCpuIsa(name.c_str() + slash + 1));
+		Result r = measure(*runs[i].first, name);
+		fprintf(stderr, "%-32s %10.2f ns/op  +- %.2f  (min %.2f)\n", r.name.c_str(), r.ns_per_op, r.mad_ns, r.min_ns);
+		results.push_back(r);
+	}
+	setCpuIsa(selected);
+
+	printf("{\n  \"compiler\": \"%s\",\n  \"isa\": \"%s\",\n  \"samples\": %d,\n  \"benchmarks\": [\n",
+		__VERSION__, cpuIsaName(selected), SAMPLES);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		printf("    { \"name\": \"%s\", \"ns_per_op\": %.3f, \"mad_ns\": %.3f, \"min_ns\": %.3f, \"batch\": %zu }%s\n",
+			r.name.c_str(), r.ns_per_op, r.mad_ns, r.min_ns, r.batch, i + 1 < results.size() ? "," : "");
+	}
+	printf("  ]\n}\n");
+	return 0;
+}
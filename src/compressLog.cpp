@@ -0,0 +1,102 @@
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../include/flight_log.h"
+#include "../include/sample_codec.h"
+
+using namespace std;
+
+#define DEFAULT_BLOCK 256
+
+// compresses the raw samples of a flight log for downlink, checks that
+// they decode back unchanged and reports the compression ratio
+
+static void usage(const char* name)
+{
+	printf("usage: %s <flight.log> [options]\n"
+		"  --coding rice|bitpack|varint|all  (default all, report only)\n"
+		"  --block n                         samples per block (default %d, max %d)\n"
+		"  --out file                        write the compressed stream (single coding only)\n",
+		name, DEFAULT_BLOCK, SAMPLE_BLOCK_MAX);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	int first = 0, last = SAMPLE_CODING_RICE;
+	size_t block = DEFAULT_BLOCK;
+	const char* out_path = 0;
+	for (int i = 2; i + 1 < argc; i += 2)
+	{
+		const char* opt = argv[i];
+		const char* val = argv[i + 1];
+		if (!strcmp(opt, "--coding") && !strcmp(val, "varint")) first = last = SAMPLE_CODING_VARINT;
+		else if (!strcmp(opt, "--coding") && !strcmp(val, "bitpack")) first = last = SAMPLE_CODING_BITPACK;
+		else if (!strcmp(opt, "--coding") && !strcmp(val, "rice")) first = last = SAMPLE_CODING_RICE;
+		else if (!strcmp(opt, "--coding") && !strcmp(val, "all")) first = 0, last = SAMPLE_CODING_RICE;
+		else if (!strcmp(opt, "--block")) block = atoi(val);
+		else if (!strcmp(opt, "--out")) out_path = val;
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (out_path && first != last)
+	{
+		printf("--out needs a single --coding\n");
+		return 1;
+	}
+
+	FlightLogReader log;
+	if (!log.open(argv[1]))
+	{
+		printf("could not read %s\n", argv[1]);
+		return 1;
+	}
+
+	vector<int16_t> samples(log.size() * SAMPLE_AXES);
+	for (size_t i = 0; i < log.size(); i++)
+	{
+		memcpy(&samples[i * SAMPLE_AXES], log[i].accel, 3 * sizeof(int16_t));
+		memcpy(&samples[i * SAMPLE_AXES + 3], log[i].gyro, 3 * sizeof(int16_t));
+	}
+	size_t raw_bytes = samples.size() * sizeof(int16_t);
+
+	static const char* const names[] = { "varint", "bitpack", "rice" };
+	printf("%zu samples, %zu bytes raw\n", log.size(), raw_bytes);
+	for (int coding = first; coding <= last; coding++)
+	{
+		SampleEncoder encoder((SampleCoding)coding, block);
+		vector<uint8_t> stream;
+		encoder.write(samples.empty() ? 0 : &samples[0], log.size(), stream);
+		encoder.flush(stream);
+
+		vector<int16_t> decoded;
+		decodeSampleStream(stream.empty() ? 0 : &stream[0], stream.size(), decoded);
+		bool ok = decoded == samples;
+		printf("%-8s %10zu bytes  %5.2fx  %s\n", names[coding], stream.size(),
+			stream.empty() ? 0.0 : (double)raw_bytes / stream.size(), ok ? "ok" : "MISMATCH");
+		if (!ok) return 1;
+
+		if (out_path)
+		{
+			FILE* out = fopen(out_path, "wb");
+			bool written = out && fwrite(stream.data(), 1, stream.size(), out) == stream.size();
+			if (out) written = fclose(out) == 0 && written;
+			if (!written)
+			{
+				printf("could not write %s\n", out_path);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/cpu_dispatch.h"
+
+static const char* const isa_names[ISA_COUNT] = { "scalar", "sse2", "avx2", "avx512", "neon" };
+
+bool cpuSupports(CpuIsa isa)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();             // may run before libgcc's constructor
+  switch (isa)
+  {
+    case ISA_SCALAR:
+#ifdef __x86_64__
+      return false;
+#else
+      return true;
+#endif
+    case ISA_SSE2:
+      return __builtin_cpu_supports("sse2");
+    case ISA_AVX2:
+      return __builtin_cpu_supports("avx2");
+    case ISA_AVX512:
+      return __builtin_cpu_supports("avx512f");
+    default:
+      return false;
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  return isa == ISA_NEON;
+#else
+  return isa == ISA_SCALAR;
+#endif
+}
+
+static CpuIsa detect()
+{
+  CpuIsa best = ISA_SCALAR;
+  for (int isa = 0; isa < ISA_COUNT; isa++)
+    if (isa != ISA_NEON && cpuSupports((CpuIsa)isa)) best = (CpuIsa)isa;
+  if (cpuSupports(ISA_NEON)) best = ISA_NEON;
+
+  // a lower level on request, e.g. to reproduce another machine's results
+  const char* limit = getenv("IMU_ISA");
+  CpuIsa wanted = limit ? parseCpuIsa(limit) : ISA_COUNT;
+  if (wanted != ISA_COUNT && cpuSupports(wanted)) best = wanted;
+  return best;
+}
+
+// detected on first use, whichever static constructor that comes from
+static CpuIsa& selected()
+{
+  static CpuIsa isa = detect();
+  return isa;
+}
+
+CpuIsa cpuIsa()
+{
+  return selected();
+}
+
+bool setCpuIsa(CpuIsa isa)
+{
+  if (isa >= ISA_COUNT || !cpuSupports(isa)) return false;
+  selected() = isa;
+  return true;
+}
+
+const char* cpuIsaName(CpuIsa isa)
+{
+  return isa < ISA_COUNT ? isa_names[isa] : "unknown";
+}
+
+CpuIsa parseCpuIsa(const char* name)
+{
+  for (int isa = 0; isa < ISA_COUNT; isa++)
+    if (!strcmp(name, isa_names[isa])) return (CpuIsa)isa;
+  return ISA_COUNT;
+}
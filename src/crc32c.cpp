@@ -0,0 +1,123 @@
+#include <string.h>
+#include "../include/crc32c.h"
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#define POLY 0x82F63B78             // reflected Castagnoli polynomial
+
+namespace
+{
+
+// table[k][b] is the CRC of byte b followed by k zero bytes
+struct Tables
+{
+  uint32_t table[8][256];
+
+  Tables()
+  {
+    for (unsigned b = 0; b < 256; b++)
+    {
+      uint32_t crc = b;
+      for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (POLY & (0u - (crc & 1)));
+      table[0][b] = crc;
+    }
+    for (unsigned b = 0; b < 256; b++)
+      for (int k = 1; k < 8; k++)
+        table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+  }
+};
+
+}
+
+static const Tables& tables()
+{
+  static const Tables t;
+  return t;
+}
+
+// works on the inverted CRC, like the instructions
+static uint32_t crcSoftware(const uint8_t* p, size_t len, uint32_t crc)
+{
+  const uint32_t (*t)[256] = tables().table;
+  for (; len >= 8; p += 8, len -= 8)
+  {
+    uint32_t lo, hi;
+    memcpy(&lo, p, 4);
+    memcpy(&hi, p + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+  }
+  for (; len > 0; p++, len--) crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+  return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse4.2")))
+static uint32_t crcSse42(const uint8_t* p, size_t len, uint32_t crc)
+{
+#ifdef __x86_64__
+  uint64_t crc64 = crc;
+  for (; len >= 8; p += 8, len -= 8)
+  {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    crc64 = __builtin_ia32_crc32di(crc64, v);
+  }
+  crc = (uint32_t)crc64;
+#endif
+  for (; len >= 4; p += 4, len -= 4)
+  {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    crc = __builtin_ia32_crc32si(crc, v);
+  }
+  for (; len > 0; p++, len--) crc = __builtin_ia32_crc32qi(crc, *p);
+  return crc;
+}
+
+static bool haveSse42()
+{
+  static const bool have = __builtin_cpu_supports("sse4.2");
+  return have;
+}
+
+#elif defined(__ARM_FEATURE_CRC32)
+
+static uint32_t crcArmv8(const uint8_t* p, size_t len, uint32_t crc)
+{
+#ifdef __aarch64__
+  for (; len >= 8; p += 8, len -= 8)
+  {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    crc = __crc32cd(crc, v);
+  }
+#endif
+  for (; len >= 4; p += 4, len -= 4)
+  {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    crc = __crc32cw(crc, v);
+  }
+  for (; len > 0; p++, len--) crc = __crc32cb(crc, *p);
+  return crc;
+}
+
+#endif
+
+uint32_t crc32c(const void* data, size_t len, uint32_t crc)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+#if defined(__x86_64__) || defined(__i386__)
+  crc = haveSse42() ? crcSse42(p, len, crc) : crcSoftware(p, len, crc);
+#elif defined(__ARM_FEATURE_CRC32)
+  crc = crcArmv8(p, len, crc);
+#else
+  crc = crcSoftware(p, len, crc);
+#endif
+  return ~crc;
+}
@@ -0,0 +1,266 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/csv_reader.h"
+
+// fields are parsed into a fixed row before being appended
+#define MAX_COLUMNS 64
+
+static inline bool isPadding(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '"';
+}
+
+static inline void trim(const char*& b, const char*& e)
+{
+  while (b < e && isPadding(*b)) b++;
+  while (e > b && isPadding(e[-1])) e--;
+}
+
+static bool nameMatches(const char* b, const char* e, const char* name)
+{
+  size_t len = e - b;
+  if (name[0] != '*') return strlen(name) == len && memcmp(b, name, len) == 0;
+  size_t n = strlen(name + 1);
+  return len >= n && memcmp(e - n, name + 1, n) == 0;
+}
+
+static const double kPow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Anything the fast path does not handle exactly goes through strtod,
+// which needs a terminated copy.
+static bool parseSlow(const char* b, const char* e, double& value)
+{
+  char buf[64];
+  size_t len = e - b;
+  if (len == 0 || len >= sizeof(buf)) return false;
+  memcpy(buf, b, len);
+  buf[len] = 0;
+  char* end;
+  value = strtod(buf, &end);
+  return end == buf + len;
+}
+
+// Decimal whose digits fit a mantissa below 2^53 and whose power of ten is
+// at most 22: both are exact doubles, so one multiply or divide gives the
+// correctly rounded result.
+static bool parseNumber(const char* b, const char* e, double& value)
+{
+  const char* p = b;
+  bool negative = false;
+  if (p < e && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+  // a field of at most 19 characters cannot overflow the mantissa
+  if (e - p > 19) return parseSlow(b, e, value);
+  unsigned long long mantissa = 0;
+  int exponent = 0;
+  const char* digits = p;
+  for (; p < e && (unsigned)(*p - '0') < 10; p++)
+    mantissa = mantissa * 10 + (*p - '0');
+  if (p < e && *p == '.')
+  {
+    const char* frac = ++p;
+    for (; p < e && (unsigned)(*p - '0') < 10; p++)
+      mantissa = mantissa * 10 + (*p - '0');
+    exponent = -(int)(p - frac);
+    if (p - digits == 1) return parseSlow(b, e, value);
+  }
+  else if (p == digits) return parseSlow(b, e, value);
+  if (p < e && (*p == 'e' || *p == 'E'))
+  {
+    p++;
+    bool exp_negative = false;
+    if (p < e && (*p == '-' || *p == '+')) exp_negative = *p++ == '-';
+    if (p == e) return false;
+    int exp = 0;
+    for (; p < e && (unsigned)(*p - '0') < 10; p++)
+      if (exp < 10000) exp = exp * 10 + (*p - '0');
+    exponent += exp_negative ? -exp : exp;
+  }
+  if (p != e) return false;
+  if (mantissa > (1ull << 53) || exponent < -22 || exponent > 22)
+    return parseSlow(b, e, value);
+
+  double v = (double)mantissa;
+  v = exponent < 0 ? v / kPow10[-exponent] : v * kPow10[exponent];
+  value = negative ? -v : v;
+  return true;
+}
+
+CsvReader::CsvReader() :
+    data_(0), size_(0), pos_(0)
+{
+}
+
+CsvReader::~CsvReader()
+{
+  close();
+}
+
+bool CsvReader::open(const char* path)
+{
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) return false;
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  data_ = (const char*)map;
+  size_ = st.st_size;
+  pos_ = data_;
+  return true;
+}
+
+void CsvReader::close()
+{
+  if (data_) munmap((void*)data_, size_);
+  data_ = 0;
+  size_ = 0;
+  pos_ = 0;
+}
+
+bool CsvReader::findHeader(CsvColumn* columns, size_t count)
+{
+  if (!data_) return false;
+  const char* end = data_ + size_;
+  while (pos_ < end)
+  {
+    const char* eol = (const char*)memchr(pos_, '\n', end - pos_);
+    if (!eol) eol = end;
+
+    for (size_t c = 0; c < count; c++) columns[c].field = -1;
+    const char* p = pos_;
+    for (int f = 0; ; f++)
+    {
+      const char* comma = (const char*)memchr(p, ',', eol - p);
+      const char* b = p;
+      const char* e = comma ? comma : eol;
+      trim(b, e);
+      for (size_t c = 0; c < count; c++)
+      {
+        if (columns[c].field >= 0) continue;
+        for (const char* const* name = columns[c].names; *name; name++)
+          if (nameMatches(b, e, *name)) { columns[c].field = f; break; }
+      }
+      if (!comma) break;
+      p = comma + 1;
+    }
+
+    pos_ = eol < end ? eol + 1 : end;
+    bool found = true;
+    for (size_t c = 0; c < count; c++)
+      found = found && (!columns[c].required || columns[c].field >= 0);
+    if (found) return true;
+  }
+  return false;
+}
+
+size_t CsvReader::readRows(const CsvColumn* columns, size_t count)
+{
+  if (!data_ || count > MAX_COLUMNS) return 0;
+  const char* end = data_ + size_;
+
+  // field index -> column, for the fields that are wanted at all
+  std::vector<int> wanted;
+  size_t present = 0;
+  for (size_t c = 0; c < count; c++)
+  {
+    int f = columns[c].field;
+    if (f < 0) continue;
+    if ((size_t)f >= wanted.size()) wanted.resize(f + 1, -1);
+    wanted[f] = (int)c;
+    present++;
+  }
+  if (present == 0) return 0;
+  size_t last_field = wanted.size() - 1;
+
+  // one line is at most one row, so the columns are sized for every
+  // remaining line up front and trimmed to the rows actually parsed
+  size_t lines = 0;
+  for (const char* p = pos_; p < end; lines++)
+  {
+    const char* eol = (const char*)memchr(p, '\n', end - p);
+    p = eol ? eol + 1 : end;
+  }
+  float* out[MAX_COLUMNS];
+  double* out_double[MAX_COLUMNS];
+  size_t base[MAX_COLUMNS];
+  for (size_t c = 0; c < count; c++)
+  {
+    out[c] = 0;
+    out_double[c] = 0;
+    if (columns[c].field < 0) continue;
+    if (columns[c].out)
+    {
+      base[c] = columns[c].out->size();
+      columns[c].out->resize(base[c] + lines);
+      out[c] = &(*columns[c].out)[base[c]];
+    }
+    else
+    {
+      base[c] = columns[c].out_double->size();
+      columns[c].out_double->resize(base[c] + lines);
+      out_double[c] = &(*columns[c].out_double)[base[c]];
+    }
+  }
+
+  double row[MAX_COLUMNS];
+  size_t rows = 0;
+  while (pos_ < end)
+  {
+    const char* eol = (const char*)memchr(pos_, '\n', end - pos_);
+    if (!eol) eol = end;
+
+    size_t parsed = 0;
+    const char* p = pos_;
+    for (size_t f = 0; f <= last_field; f++)
+    {
+      // fields are short, a plain loop beats a memchr call per field
+      const char* e = p;
+      while (e < eol && *e != ',') e++;
+      int c = wanted[f];
+      if (c >= 0)
+      {
+        const char* b = p;
+        const char* t = e;
+        trim(b, t);
+        if (!parseNumber(b, t, row[c])) break;
+        parsed++;
+      }
+      if (e == eol) break;
+      p = e + 1;
+    }
+    pos_ = eol < end ? eol + 1 : end;
+    if (parsed != present) continue;
+
+    for (size_t c = 0; c < count; c++)
+    {
+      if (out[c]) out[c][rows] = (float)row[c];
+      else if (out_double[c]) out_double[c][rows] = row[c];
+    }
+    rows++;
+  }
+
+  for (size_t c = 0; c < count; c++)
+  {
+    if (columns[c].field < 0) continue;
+    if (columns[c].out) columns[c].out->resize(base[c] + rows);
+    else columns[c].out_double->resize(base[c] + rows);
+  }
+  return rows;
+}
@@ -0,0 +1,130 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include "../include/cpu_dispatch.h"
+#include "../include/dsp_kernels.h"
+#include "../include/sample_filters.h"
+
+// No variant may fuse a multiply and an add: the results would then depend
+// on the machine. AVX-512F implies FMA, and ARM compilers contract by
+// default.
+#pragma GCC optimize("fp-contract=off")
+
+// small fixed loops inside a vectorized one have to be unrolled first
+#if __GNUC__ >= 8
+#define KERNEL_UNROLL _Pragma("GCC unroll 16")
+#else
+#define KERNEL_UNROLL
+#endif
+
+namespace generic
+{
+#include "dsp_kernels_impl.h"
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#ifdef __i386__
+#pragma GCC push_options
+#pragma GCC target("sse2")
+namespace sse2
+{
+#include "dsp_kernels_impl.h"
+}
+#pragma GCC pop_options
+#else
+namespace sse2 = generic;           // the x86_64 baseline
+#endif
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace avx2
+{
+#include "dsp_kernels_impl.h"
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+namespace avx512
+{
+#include "dsp_kernels_impl.h"
+}
+#pragma GCC pop_options
+
+#else
+
+namespace sse2 = generic;
+namespace avx2 = generic;
+namespace avx512 = generic;
+
+#endif
+
+namespace
+{
+
+struct Kernels
+{
+  void (*scaleRaw)(size_t, const int16_t*, float, float*);
+  void (*convertRecords)(size_t, const FlightLogRecord*, const FlightLogHeader&, float,
+                         double*, float*, float*, float*, float*, float*, float*);
+  void (*medianFilter)(size_t, const float*, float*);
+  void (*filterBankUpdateIMU)(size_t, double*, double*, double*, double*, const double*,
+                              WorldFrame::WorldFrame, float, float, float, float, float, float, float);
+  void (*accumulateAngleError)(size_t, const double*, const double*, const double*, const double*,
+                               double, double, double, double, double*, double*, double*, double*);
+};
+
+#define KERNELS(ns) { ns::scaleRaw, ns::convertRecords, ns::medianFilter, \
+                      ns::filterBankUpdateIMU, ns::accumulateAngleError }
+
+// indexed by CpuIsa; ARM and scalar builds compile the generic code for
+// their one level
+const Kernels kernel_table[ISA_COUNT] =
+{
+  KERNELS(generic),
+  KERNELS(sse2),
+  KERNELS(avx2),
+  KERNELS(avx512),
+  KERNELS(generic),
+};
+
+}
+
+static inline const Kernels& kernels()
+{
+  return kernel_table[cpuIsa()];
+}
+
+void scaleRaw(size_t n, const int16_t* __restrict raw, float scale, float* __restrict out)
+{
+  kernels().scaleRaw(n, raw, scale, out);
+}
+
+void convertRecords(size_t n, const FlightLogRecord* records, const FlightLogHeader& header,
+                    float gyro_unit, double* t, float* ax, float* ay, float* az,
+                    float* gx, float* gy, float* gz)
+{
+  kernels().convertRecords(n, records, header, gyro_unit, t, ax, ay, az, gx, gy, gz);
+}
+
+void medianFilter(size_t n, const float* in, float* out)
+{
+  kernels().medianFilter(n, in, out);
+}
+
+void filterBankUpdateIMU(size_t lanes, double* q0, double* q1, double* q2, double* q3,
+                         const double* gain, WorldFrame::WorldFrame frame,
+                         float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+  kernels().filterBankUpdateIMU(lanes, q0, q1, q2, q3, gain, frame, gx, gy, gz, ax, ay, az, dt);
+}
+
+void accumulateAngleError(size_t lanes, const double* q0, const double* q1,
+                          const double* q2, const double* q3,
+                          double t0, double t1, double t2, double t3,
+                          double* sum, double* sum_sq, double* max, double* last)
+{
+  kernels().accumulateAngleError(lanes, q0, q1, q2, q3, t0, t1, t2, t3, sum, sum_sq, max, last);
+}
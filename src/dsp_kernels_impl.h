@@ -0,0 +1,190 @@
+// The kernels of dsp_kernels.h, included by dsp_kernels.cpp once per
+// instruction set level, each time inside its own namespace and #pragma GCC
+// target. Loops are unit stride and branch free where they can be, so
+// that each copy vectorizes for its level; the arithmetic is written in
+// the order of the scalar code it replaces so that results do not depend
+// on the level.
+
+static void scaleRaw(size_t n, const int16_t* __restrict raw, float scale, float* __restrict out)
+{
+  for (size_t i = 0; i < n; i++) out[i] = raw[i] * scale;
+}
+
+static void convertRecords(size_t n, const FlightLogRecord* __restrict records,
+                           const FlightLogHeader& header, float gyro_unit,
+                           double* __restrict t, float* __restrict ax, float* __restrict ay,
+                           float* __restrict az, float* __restrict gx, float* __restrict gy,
+                           float* __restrict gz)
+{
+  float accel_scale = header.accel_scale, gyro_scale = header.gyro_scale;
+  for (size_t i = 0; i < n; i++) t[i] = records[i].t_ns * 1e-9;
+  // one column at a time: strided loads of a single field vectorize, the
+  // whole interleaved record does not
+  for (size_t i = 0; i < n; i++) ax[i] = records[i].accel[0] * accel_scale;
+  for (size_t i = 0; i < n; i++) ay[i] = records[i].accel[1] * accel_scale;
+  for (size_t i = 0; i < n; i++) az[i] = records[i].accel[2] * accel_scale;
+  for (size_t i = 0; i < n; i++) gx[i] = records[i].gyro[0] * gyro_scale * gyro_unit;
+  for (size_t i = 0; i < n; i++) gy[i] = records[i].gyro[1] * gyro_scale * gyro_unit;
+  for (size_t i = 0; i < n; i++) gz[i] = records[i].gyro[2] * gyro_scale * gyro_unit;
+}
+
+// odd-even transposition sort of each window: min and max only, so one
+// window per vector lane
+static void medianFilter(size_t n, const float* __restrict in, float* __restrict out)
+{
+  for (size_t i = 0; i + MEDIAN_WINDOW <= n; i++)
+  {
+    float v[MEDIAN_WINDOW];
+    KERNEL_UNROLL
+    for (unsigned j = 0; j < MEDIAN_WINDOW; j++) v[j] = in[i + j];
+    KERNEL_UNROLL
+    for (unsigned pass = 0; pass < MEDIAN_WINDOW; pass++)
+      KERNEL_UNROLL
+      for (unsigned j = pass & 1; j + 1 < MEDIAN_WINDOW; j += 2)
+      {
+        float lo = std::min(v[j], v[j + 1]);
+        float hi = std::max(v[j], v[j + 1]);
+        v[j] = lo;
+        v[j + 1] = hi;
+      }
+    if (MEDIAN_WINDOW % 2 != 0) out[i] = v[MEDIAN_WINDOW / 2];
+    else out[i] = (v[MEDIAN_WINDOW / 2 - 1] + v[MEDIAN_WINDOW / 2]) / 2;
+  }
+}
+
+// imu_filter.cpp's invSqrt, with the type pun through memcpy
+static inline float bankInvSqrt(float x)
+{
+  float xhalf = 0.5f * x;
+  int32_t i;
+  memcpy(&i, &x, sizeof(i));
+  i = 0x5f3759df - (i >> 1);
+  memcpy(&x, &i, sizeof(x));
+  x = x * (1.5f - xhalf * x * x);
+  return x;
+}
+
+// One sample for every lane. The expressions are those of ImuFilter,
+// including the zero terms of the gravity direction, so that each lane
+// rounds exactly as ImuFilter does.
+template <bool FEEDBACK>
+static inline void bankUpdate(size_t lanes, double* __restrict q0, double* __restrict q1,
+                              double* __restrict q2, double* __restrict q3,
+                              const double* __restrict gain, float _2dz,
+                              float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+  const float _2dx = 0.0f, _2dy = 0.0f;
+  for (size_t k = 0; k < lanes; k++)
+  {
+    float fq0 = q0[k], fq1 = q1[k], fq2 = q2[k], fq3 = q3[k];
+    float qDot1 = 0.5f * (-fq1 * gx - fq2 * gy - fq3 * gz);
+    float qDot2 = 0.5f * (fq0 * gx + fq2 * gz - fq3 * gy);
+    float qDot3 = 0.5f * (fq0 * gy - fq1 * gz + fq3 * gx);
+    float qDot4 = 0.5f * (fq0 * gz + fq1 * gy - fq2 * gx);
+
+    if (FEEDBACK)
+    {
+      float f0 = _2dx * (0.5f - fq2 * fq2 - fq3 * fq3)
+               + _2dy * (fq0 * fq3 + fq1 * fq2)
+               + _2dz * (fq1 * fq3 - fq0 * fq2);
+      float f1 = _2dx * (fq1 * fq2 - fq0 * fq3)
+               + _2dy * (0.5f - fq1 * fq1 - fq3 * fq3)
+               + _2dz * (fq0 * fq1 + fq2 * fq3);
+      float f2 = _2dx * (fq0 * fq2 + fq1 * fq3)
+               + _2dy * (fq2 * fq3 - fq0 * fq1)
+               + _2dz * (0.5f - fq1 * fq1 - fq2 * fq2);
+      f0 -= ax;
+      f1 -= ay;
+      f2 -= az;
+
+      float s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+      s0 += (_2dy * fq3 - _2dz * fq2) * f0
+          + (-_2dx * fq3 + _2dz * fq1) * f1
+          + (_2dx * fq2 - _2dy * fq1) * f2;
+      s1 += (_2dy * fq2 + _2dz * fq3) * f0
+          + (_2dx * fq2 - 2.0f * _2dy * fq1 + _2dz * fq0) * f1
+          + (_2dx * fq3 - _2dy * fq0 - 2.0f * _2dz * fq1) * f2;
+      s2 += (-2.0f * _2dx * fq2 + _2dy * fq1 - _2dz * fq0) * f0
+          + (_2dx * fq1 + _2dz * fq3) * f1
+          + (_2dx * fq0 + _2dy * fq3 - 2.0f * _2dz * fq2) * f2;
+      s3 += (-2.0f * _2dx * fq3 + _2dy * fq0 + _2dz * fq1) * f0
+          + (-_2dx * fq0 - 2.0f * _2dy * fq3 + _2dz * fq2) * f1
+          + (_2dx * fq1 + _2dy * fq2) * f2;
+
+      float recipNorm = bankInvSqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3);
+      s0 *= recipNorm;
+      s1 *= recipNorm;
+      s2 *= recipNorm;
+      s3 *= recipNorm;
+
+      qDot1 -= gain[k] * s0;
+      qDot2 -= gain[k] * s1;
+      qDot3 -= gain[k] * s2;
+      qDot4 -= gain[k] * s3;
+    }
+
+    double a = q0[k] + qDot1 * dt;
+    double b = q1[k] + qDot2 * dt;
+    double c = q2[k] + qDot3 * dt;
+    double d = q3[k] + qDot4 * dt;
+    double recipNorm = bankInvSqrt(a * a + b * b + c * c + d * d);
+    q0[k] = a * recipNorm;
+    q1[k] = b * recipNorm;
+    q2[k] = c * recipNorm;
+    q3[k] = d * recipNorm;
+  }
+}
+
+static void filterBankUpdateIMU(size_t lanes, double* q0, double* q1, double* q2, double* q3,
+                                const double* gain, WorldFrame::WorldFrame frame,
+                                float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+  float _2dz = frame == WorldFrame::NED ? -2.0f : 2.0f;
+  if ((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))
+  {
+    bankUpdate<false>(lanes, q0, q1, q2, q3, gain, _2dz, gx, gy, gz, ax, ay, az, dt);
+    return;
+  }
+  float recipNorm = bankInvSqrt(ax * ax + ay * ay + az * az);
+  ax *= recipNorm;
+  ay *= recipNorm;
+  az *= recipNorm;
+  bankUpdate<true>(lanes, q0, q1, q2, q3, gain, _2dz, gx, gy, gz, ax, ay, az, dt);
+}
+
+// the normalisation and dot products vectorize, acos is a libm call and
+// stays scalar
+static void accumulateAngleError(size_t lanes, const double* __restrict q0, const double* __restrict q1,
+                                 const double* __restrict q2, const double* __restrict q3,
+                                 double t0, double t1, double t2, double t3,
+                                 double* __restrict sum, double* __restrict sum_sq,
+                                 double* __restrict max, double* __restrict last)
+{
+  const size_t chunk = 64;
+  double dots[chunk];
+  for (size_t start = 0; start < lanes; start += chunk)
+  {
+    size_t count = std::min(chunk, lanes - start);
+    for (size_t k = 0; k < count; k++)
+    {
+      double a0 = q0[start + k], a1 = q1[start + k], a2 = q2[start + k], a3 = q3[start + k];
+      double recipNorm = 1 / sqrt(a0 * a0 + a1 * a1 + a2 * a2 + a3 * a3);
+      a0 *= recipNorm;
+      a1 *= recipNorm;
+      a2 *= recipNorm;
+      a3 *= recipNorm;
+      double dot = fabs(a0 * t0 + a1 * t1 + a2 * t2 + a3 * t3);
+      dots[k] = dot > 1.0 ? 1.0 : dot;
+    }
+    for (size_t k = 0; k < count; k++)
+    {
+      double err = 2.0 * acos(dots[k]) * 180 / 3.141592653589793238463;
+      if (!std::isfinite(err)) err = 180.0;
+      size_t lane = start + k;
+      sum[lane] += err;
+      sum_sq[lane] += err * err;
+      if (err > max[lane]) max[lane] = err;
+      last[lane] = err;
+    }
+  }
+}
@@ -0,0 +1,158 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/crc32c.h"
+#include "../include/filter_snapshot.h"
+
+// On-disk layout, little endian (every supported BUILD_CONFIG is), no padding:
+//
+//   0  "IMUS"        4  version u16   6  length u16
+//   8  timestamp_ns u64
+//  16  gain f64     24  zeta f64     32  frame u32
+//  36  q0..q3 f64   68  w_bx..w_bz f32
+//  80  crc32c of bytes 0..79
+#define SNAPSHOT_MAGIC "IMUS"
+#define SNAPSHOT_SIZE 84
+
+template<typename T>
+static inline void put(uint8_t* buf, size_t& off, T value)
+{
+  memcpy(buf + off, &value, sizeof(T));
+  off += sizeof(T);
+}
+
+template<typename T>
+static inline T get(const uint8_t* buf, size_t& off)
+{
+  T value;
+  memcpy(&value, buf + off, sizeof(T));
+  off += sizeof(T);
+  return value;
+}
+
+static uint64_t realtimeNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void captureSnapshot(ImuFilter& filter, FilterSnapshot& snapshot)
+{
+  snapshot.timestamp_ns = realtimeNs();
+  snapshot.gain = filter.getAlgorithmGain();
+  snapshot.zeta = filter.getDriftBiasGain();
+  snapshot.frame = filter.getWorldFrame();
+  filter.getOrientation(snapshot.q0, snapshot.q1, snapshot.q2, snapshot.q3);
+  filter.getDriftBias(snapshot.w_bx, snapshot.w_by, snapshot.w_bz);
+}
+
+void restoreSnapshot(const FilterSnapshot& snapshot, ImuFilter& filter)
+{
+  filter.setOrientation(snapshot.q0, snapshot.q1, snapshot.q2, snapshot.q3);
+  filter.setDriftBias(snapshot.w_bx, snapshot.w_by, snapshot.w_bz);
+}
+
+bool saveSnapshot(const char* path, const FilterSnapshot& snapshot)
+{
+  uint8_t buf[SNAPSHOT_SIZE];
+  size_t off = 0;
+  memcpy(buf, SNAPSHOT_MAGIC, 4);
+  off += 4;
+  put<uint16_t>(buf, off, FILTER_SNAPSHOT_VERSION);
+  put<uint16_t>(buf, off, SNAPSHOT_SIZE);
+  put<uint64_t>(buf, off, snapshot.timestamp_ns);
+  put<double>(buf, off, snapshot.gain);
+  put<double>(buf, off, snapshot.zeta);
+  put<uint32_t>(buf, off, snapshot.frame);
+  put<double>(buf, off, snapshot.q0);
+  put<double>(buf, off, snapshot.q1);
+  put<double>(buf, off, snapshot.q2);
+  put<double>(buf, off, snapshot.q3);
+  put<float>(buf, off, snapshot.w_bx);
+  put<float>(buf, off, snapshot.w_by);
+  put<float>(buf, off, snapshot.w_bz);
+  put<uint32_t>(buf, off, crc32c(buf, off));
+
+  // no std::string: the flight loop saves snapshots and must not allocate
+  char tmp[PATH_MAX];
+  if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) return false;
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+
+  bool ok = write(fd, buf, SNAPSHOT_SIZE) == SNAPSHOT_SIZE;
+  ok = fsync(fd) == 0 && ok;
+  ok = close(fd) == 0 && ok;
+  if (ok) ok = rename(tmp, path) == 0;
+  if (!ok)
+  {
+    unlink(tmp);
+    return false;
+  }
+
+  // the rename is only durable once the directory entry is on disk
+  char dir[PATH_MAX];
+  const char* slash = strrchr(path, '/');
+  if (!slash) strcpy(dir, ".");
+  else if (slash == path) strcpy(dir, "/");
+  else snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+  int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+  if (dir_fd < 0) return false;
+  ok = fsync(dir_fd) == 0;
+  close(dir_fd);
+  return ok;
+}
+
+bool loadSnapshot(const char* path, FilterSnapshot& snapshot)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  uint8_t buf[SNAPSHOT_SIZE];
+  ssize_t n = read(fd, buf, SNAPSHOT_SIZE);
+  close(fd);
+  if (n != SNAPSHOT_SIZE || memcmp(buf, SNAPSHOT_MAGIC, 4) != 0) return false;
+
+  size_t off = 4;
+  uint16_t version = get<uint16_t>(buf, off);
+  uint16_t length = get<uint16_t>(buf, off);
+  if (version != FILTER_SNAPSHOT_VERSION || length != SNAPSHOT_SIZE) return false;
+
+  size_t crc_off = SNAPSHOT_SIZE - 4;
+  if (get<uint32_t>(buf, crc_off) != crc32c(buf, SNAPSHOT_SIZE - 4)) return false;
+
+  snapshot.timestamp_ns = get<uint64_t>(buf, off);
+  snapshot.gain = get<double>(buf, off);
+  snapshot.zeta = get<double>(buf, off);
+  uint32_t frame = get<uint32_t>(buf, off);
+  if (frame > WorldFrame::NWU) return false;
+  snapshot.frame = (WorldFrame::WorldFrame)frame;
+  snapshot.q0 = get<double>(buf, off);
+  snapshot.q1 = get<double>(buf, off);
+  snapshot.q2 = get<double>(buf, off);
+  snapshot.q3 = get<double>(buf, off);
+  snapshot.w_bx = get<float>(buf, off);
+  snapshot.w_by = get<float>(buf, off);
+  snapshot.w_bz = get<float>(buf, off);
+  return true;
+}
+
+bool warmStart(const char* path, double max_age_s, ImuFilter& filter)
+{
+  FilterSnapshot snapshot;
+  if (!loadSnapshot(path, snapshot)) return false;
+
+  // a snapshot from the future means the clock went back (e.g. an on-orbit
+  // reset to the epoch), after which max_age cannot be checked
+  uint64_t now = realtimeNs();
+  if (now < snapshot.timestamp_ns || (now - snapshot.timestamp_ns) * 1e-9 > max_age_s)
+    return false;
+  if (snapshot.frame != filter.getWorldFrame()) return false;
+
+  restoreSnapshot(snapshot, filter);
+  return true;
+}
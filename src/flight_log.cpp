@@ -0,0 +1,383 @@
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/crc32c.h"
+#include "../include/flight_log.h"
+#include "../include/stage_probe.h"
+
+void initFlightLogHeader(FlightLogHeader& header)
+{
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FLIGHT_LOG_MAGIC, 4);
+  header.version = FLIGHT_LOG_VERSION;
+  header.header_size = sizeof(FlightLogHeader);
+  header.record_size = sizeof(FlightLogRecord);
+}
+
+// index entries are rare, two pages of buffering are plenty
+#define INDEX_BUFFER_SIZE 4096
+
+FlightLogWriter::FlightLogWriter() :
+    index_(INDEX_BUFFER_SIZE, 2), records_(0), header_pending_(false),
+    segment_blocks_(0), segment_fill_(0), sequence_(0), dropped_(0)
+{
+  memset(&block_, 0, sizeof(block_));
+}
+
+FlightLogWriter::~FlightLogWriter()
+{
+  close();
+}
+
+bool FlightLogWriter::open(const char* path, const FlightLogHeader& header, bool index)
+{
+  close();
+  records_ = 0;
+  segment_blocks_ = 0;
+  sequence_ = 0;
+  dropped_ = 0;
+  block_.header.count = 0;
+  header_pending_ = false;
+  if (!out_.open(path)) return false;
+  if (!out_.write(&header, sizeof(header)))
+  {
+    out_.close();
+    return false;
+  }
+
+  if (index && index_.open((std::string(path) + FLIGHT_LOG_INDEX_SUFFIX).c_str()))
+  {
+    FlightLogIndexHeader index_header;
+    memset(&index_header, 0, sizeof(index_header));
+    memcpy(index_header.magic, FLIGHT_LOG_INDEX_MAGIC, 4);
+    index_header.version = FLIGHT_LOG_INDEX_VERSION;
+    index_header.entry_size = sizeof(FlightLogIndexEntry);
+    index_header.interval = FLIGHT_LOG_INDEX_INTERVAL;
+    index_.write(&index_header, sizeof(index_header));
+  }
+  return true;
+}
+
+bool FlightLogWriter::open(RingStorage& ring, const FlightLogHeader& header)
+{
+  close();
+  records_ = 0;
+  sequence_ = 0;
+  dropped_ = 0;
+  block_.header.count = 0;
+  if (ring.segmentBytes() < sizeof(FlightLogHeader) + sizeof(FlightLogBlock) ||
+      !out_.open(&ring))
+    return false;
+  segment_blocks_ = (ring.segmentBytes() - sizeof(FlightLogHeader)) / sizeof(FlightLogBlock);
+
+  header_ = header;
+  header_.segment = ring.nextSequence();
+  header_pending_ = true;
+  segment_fill_ = 0;
+  out_.endSegment();
+  return true;
+}
+
+bool FlightLogWriter::append(const FlightLogRecord& record)
+{
+  STAGE_PROBE(PROBE_LOG_APPEND);
+  // the last full block is still waiting for room in the writer
+  if (block_.header.count == FLIGHT_LOG_BLOCK_RECORDS && !writeBlock())
+  {
+    dropped_++;
+    return false;
+  }
+  block_.records[block_.header.count++] = record;
+  if (block_.header.count == FLIGHT_LOG_BLOCK_RECORDS) writeBlock();
+  return true;
+}
+
+bool FlightLogWriter::appendWaiting(const FlightLogRecord& record)
+{
+  if (out_.failed()) return false;
+  if (block_.header.count == FLIGHT_LOG_BLOCK_RECORDS && !waitBlock()) return false;
+  return append(record);
+}
+
+// Frames the block being filled and queues it whole. Returns false, and
+// keeps the block, if the writer thread has no room for it.
+bool FlightLogWriter::writeBlock()
+{
+  if (segment_blocks_ > 0 && segment_fill_ == segment_blocks_)
+  {
+    out_.endSegment();
+    header_.segment++;
+    header_pending_ = true;
+    segment_fill_ = 0;
+  }
+  // a segment whose header was dropped gets it with its first block
+  if (header_pending_)
+  {
+    if (!out_.write(&header_, sizeof(header_))) return false;
+    header_pending_ = false;
+  }
+
+  FlightLogBlockHeader& frame = block_.header;
+  size_t records = frame.count * sizeof(FlightLogRecord);
+  memcpy(frame.magic, FLIGHT_LOG_BLOCK_MAGIC, 4);
+  frame.sequence = sequence_;
+  frame.reserved = 0;
+  frame.crc = crc32c(block_.records, records, crc32c(&frame, offsetof(FlightLogBlockHeader, crc)));
+  if (!out_.write(&block_, sizeof(FlightLogBlockHeader) + records)) return false;
+
+  // entries count the records actually in the log, so a dropped record
+  // does not shift the ones after it
+  if (index_.isOpen())
+  {
+    for (uint64_t r = (records_ + FLIGHT_LOG_INDEX_INTERVAL - 1) / FLIGHT_LOG_INDEX_INTERVAL * FLIGHT_LOG_INDEX_INTERVAL;
+         r < records_ + frame.count; r += FLIGHT_LOG_INDEX_INTERVAL)
+    {
+      FlightLogIndexEntry entry = { block_.records[r - records_].t_ns, r };
+      index_.write(&entry, sizeof(entry));
+    }
+  }
+  records_ += frame.count;
+  sequence_++;
+  segment_fill_++;
+  frame.count = 0;
+  return true;
+}
+
+void FlightLogWriter::flush()
+{
+  out_.flush();
+}
+
+// Writes the block being filled, retrying while the writer thread has no
+// room for it. Gives up if the writer has failed or stays full for
+// FLIGHT_LOG_WAIT_MS.
+bool FlightLogWriter::waitBlock()
+{
+  for (unsigned waited = 0; !writeBlock(); waited++)
+  {
+    if (!out_.isOpen() || out_.failed() || waited >= FLIGHT_LOG_WAIT_MS) return false;
+    usleep(1000);
+  }
+  return true;
+}
+
+bool FlightLogWriter::close()
+{
+  // the partly filled block ends the file; wait for room rather than
+  // lose it
+  bool ok = true;
+  if (out_.isOpen() && block_.header.count > 0) ok = waitBlock();
+  block_.header.count = 0;
+  ok = out_.close() && ok;
+  index_.close();
+  return ok;
+}
+
+FlightLogReader::FlightLogReader() :
+    map_(MAP_FAILED), map_size_(0), header_(0), blocks_(0),
+    block_count_(0), count_(0), torn_bytes_(0), index_map_(MAP_FAILED), index_map_size_(0), index_(0), index_count_(0)
+{
+}
+
+FlightLogReader::~FlightLogReader()
+{
+  close();
+}
+
+bool FlightLogReader::open(const char* path)
+{
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FlightLogHeader))
+  {
+    ::close(fd);
+    return false;
+  }
+  map_size_ = st.st_size;
+  map_ = mmap(0, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map_ == MAP_FAILED) return false;
+
+  // the records are read in order, tell the kernel to read ahead
+  madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+  const FlightLogHeader* header = (const FlightLogHeader*)map_;
+  if (memcmp(header->magic, FLIGHT_LOG_MAGIC, 4) != 0 ||
+      header->version != FLIGHT_LOG_VERSION ||
+      header->header_size != sizeof(FlightLogHeader) ||
+      header->record_size != sizeof(FlightLogRecord))
+  {
+    close();
+    return false;
+  }
+
+  header_ = header;
+  const char* body = (const char*)map_ + sizeof(FlightLogHeader);
+  size_t body_size = map_size_ - sizeof(FlightLogHeader);
+  // blocks torn or never written by a power loss are at the end; step
+  // back to the last one that checks out
+  blocks_ = (const FlightLogBlock*)body;
+  block_count_ = (body_size + FLIGHT_LOG_BLOCK_SIZE - 1) / FLIGHT_LOG_BLOCK_SIZE;
+  while (block_count_ > 0 && !checkBlock(block_count_ - 1)) block_count_--;
+  size_t end = 0;
+  if (block_count_ > 0)
+  {
+    count_ = (block_count_ - 1) * FLIGHT_LOG_BLOCK_RECORDS + blocks_[block_count_ - 1].header.count;
+    end = (block_count_ - 1) * FLIGHT_LOG_BLOCK_SIZE + sizeof(FlightLogBlockHeader) +
+          blocks_[block_count_ - 1].header.count * sizeof(FlightLogRecord);
+  }
+  torn_bytes_ = body_size - end;
+  openIndex(path);
+  return true;
+}
+
+bool FlightLogReader::checkBlock(size_t k) const
+{
+  size_t offset = k * FLIGHT_LOG_BLOCK_SIZE;
+  size_t body_size = map_size_ - sizeof(FlightLogHeader);
+  if (!blocks_ || offset + sizeof(FlightLogBlockHeader) > body_size) return false;
+
+  const FlightLogBlockHeader& frame = blocks_[k].header;
+  size_t records = frame.count * sizeof(FlightLogRecord);
+  if (memcmp(frame.magic, FLIGHT_LOG_BLOCK_MAGIC, 4) != 0 ||
+      frame.count > FLIGHT_LOG_BLOCK_RECORDS ||
+      offset + sizeof(FlightLogBlockHeader) + records > body_size)
+    return false;
+  return crc32c(blocks_[k].records, records,
+                crc32c(&frame, offsetof(FlightLogBlockHeader, crc))) == frame.crc;
+}
+
+void FlightLogReader::openIndex(const char* path)
+{
+  int fd = ::open((std::string(path) + FLIGHT_LOG_INDEX_SUFFIX).c_str(), O_RDONLY);
+  if (fd < 0) return;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FlightLogIndexHeader))
+  {
+    ::close(fd);
+    return;
+  }
+  index_map_size_ = st.st_size;
+  index_map_ = mmap(0, index_map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (index_map_ == MAP_FAILED) return;
+
+  const FlightLogIndexHeader* header = (const FlightLogIndexHeader*)index_map_;
+  if (memcmp(header->magic, FLIGHT_LOG_INDEX_MAGIC, 4) != 0 ||
+      header->version != FLIGHT_LOG_INDEX_VERSION ||
+      header->entry_size != sizeof(FlightLogIndexEntry))
+  {
+    munmap(index_map_, index_map_size_);
+    index_map_ = MAP_FAILED;
+    return;
+  }
+  index_ = (const FlightLogIndexEntry*)((const char*)index_map_ + sizeof(FlightLogIndexHeader));
+  index_count_ = (index_map_size_ - sizeof(FlightLogIndexHeader)) / sizeof(FlightLogIndexEntry);
+}
+
+static bool entryBefore(const FlightLogIndexEntry& entry, uint64_t t_ns)
+{
+  return entry.t_ns < t_ns;
+}
+
+// an entry is only trusted if the record it names is in the log and
+// carries its timestamp (the index may be newer or older than a log that
+// was cut short)
+static bool entryValid(const FlightLogIndexEntry& entry, const FlightLogReader& log)
+{
+  return entry.record < log.size() && log[entry.record].t_ns == entry.t_ns;
+}
+
+size_t FlightLogReader::lowerBound(uint64_t t_ns) const
+{
+  size_t lo = 0, hi = count_;
+  if (index_count_ > 0)
+  {
+    // entry k is the first at or after t_ns, so the answer lies after
+    // entry k-1's record and at or before entry k's
+    size_t k = std::lower_bound(index_, index_ + index_count_, t_ns, entryBefore) - index_;
+    bool valid = true;
+    if (k < index_count_)
+    {
+      valid = entryValid(index_[k], *this);
+      hi = index_[k].record + 1;
+    }
+    if (k > 0 && valid)
+    {
+      valid = entryValid(index_[k - 1], *this);
+      lo = index_[k - 1].record + 1;
+    }
+    if (!valid || lo > hi)
+    {
+      lo = 0;
+      hi = count_;
+    }
+  }
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if ((*this)[mid].t_ns < t_ns) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+void FlightLogReader::close()
+{
+  if (map_ != MAP_FAILED) munmap(map_, map_size_);
+  map_ = MAP_FAILED;
+  map_size_ = 0;
+  header_ = 0;
+  blocks_ = 0;
+  block_count_ = 0;
+  count_ = 0;
+  torn_bytes_ = 0;
+  if (index_map_ != MAP_FAILED) munmap(index_map_, index_map_size_);
+  index_map_ = MAP_FAILED;
+  index_map_size_ = 0;
+  index_ = 0;
+  index_count_ = 0;
+}
+
+void FlightLogReader::accel(size_t i, float& x, float& y, float& z) const
+{
+  x = (*this)[i].accel[0] * header_->accel_scale;
+  y = (*this)[i].accel[1] * header_->accel_scale;
+  z = (*this)[i].accel[2] * header_->accel_scale;
+}
+
+void FlightLogReader::gyro(size_t i, float& x, float& y, float& z) const
+{
+  x = (*this)[i].gyro[0] * header_->gyro_scale;
+  y = (*this)[i].gyro[1] * header_->gyro_scale;
+  z = (*this)[i].gyro[2] * header_->gyro_scale;
+}
+
+float FlightLogReader::temperature(size_t i) const
+{
+  return (*this)[i].temp * header_->temp_scale + header_->temp_offset;
+}
+
+double FlightLogReader::time(size_t i) const
+{
+  return (*this)[i].t_ns * 1e-9;
+}
+
+bool isFlightLog(const char* path)
+{
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+  char magic[4];
+  bool is_log = read(fd, magic, 4) == 4 && memcmp(magic, FLIGHT_LOG_MAGIC, 4) == 0;
+  ::close(fd);
+  return is_log;
+}
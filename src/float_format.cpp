@@ -0,0 +1,336 @@
+#include <stdint.h>
+#include <string.h>
+#include "../include/float_format.h"
+
+// Grisu2 as described in the paper, with the boundaries computed for the
+// precision of the value (float or double) so that floats get the
+// shortest digits of a float, not of the double they widen to.
+
+#define ALPHA (-60)
+#define GAMMA (-32)
+
+namespace
+{
+
+// f * 2^e
+struct DiyFp
+{
+  uint64_t f;
+  int e;
+
+  DiyFp(uint64_t f_, int e_) : f(f_), e(e_) {}
+};
+
+struct CachedPower
+{
+  uint64_t f;
+  int e;
+  int k;
+};
+
+}
+
+static DiyFp sub(const DiyFp& x, const DiyFp& y)
+{
+  return DiyFp(x.f - y.f, x.e);
+}
+
+// upper 64 bits of the 128-bit product, rounded
+static DiyFp mul(const DiyFp& x, const DiyFp& y)
+{
+  uint64_t a = x.f >> 32, b = x.f & 0xFFFFFFFF;
+  uint64_t c = y.f >> 32, d = y.f & 0xFFFFFFFF;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t mid = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF) + (1u << 31);
+  return DiyFp(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+static DiyFp normalize(DiyFp x)
+{
+  while (!(x.f >> 63))
+  {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+static DiyFp normalizeTo(const DiyFp& x, int e)
+{
+  return DiyFp(x.f << (x.e - e), e);
+}
+
+// 10^k for k = -300, -292, ..., 324, normalized and rounded to 64 bits
+static const CachedPower kCachedPowers[] =
+{
+{ 0xAB70FE17C79AC6CA, -1060, -300 },
+  { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+  { 0xBE5691EF416BD60C, -1007, -284 },
+  { 0x8DD01FAD907FFC3C,  -980, -276 },
+  { 0xD3515C2831559A83,  -954, -268 },
+  { 0x9D71AC8FADA6C9B5,  -927, -260 },
+  { 0xEA9C227723EE8BCB,  -901, -252 },
+  { 0xAECC49914078536D,  -874, -244 },
+  { 0x823C12795DB6CE57,  -847, -236 },
+  { 0xC21094364DFB5637,  -821, -228 },
+  { 0x9096EA6F3848984F,  -794, -220 },
+  { 0xD77485CB25823AC7,  -768, -212 },
+  { 0xA086CFCD97BF97F4,  -741, -204 },
+  { 0xEF340A98172AACE5,  -715, -196 },
+  { 0xB23867FB2A35B28E,  -688, -188 },
+  { 0x84C8D4DFD2C63F3B,  -661, -180 },
+  { 0xC5DD44271AD3CDBA,  -635, -172 },
+  { 0x936B9FCEBB25C996,  -608, -164 },
+  { 0xDBAC6C247D62A584,  -582, -156 },
+  { 0xA3AB66580D5FDAF6,  -555, -148 },
+  { 0xF3E2F893DEC3F126,  -529, -140 },
+  { 0xB5B5ADA8AAFF80B8,  -502, -132 },
+  { 0x87625F056C7C4A8B,  -475, -124 },
+  { 0xC9BCFF6034C13053,  -449, -116 },
+  { 0x964E858C91BA2655,  -422, -108 },
+  { 0xDFF9772470297EBD,  -396, -100 },
+  { 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+  { 0xF8A95FCF88747D94,  -343,  -84 },
+  { 0xB94470938FA89BCF,  -316,  -76 },
+  { 0x8A08F0F8BF0F156B,  -289,  -68 },
+  { 0xCDB02555653131B6,  -263,  -60 },
+  { 0x993FE2C6D07B7FAC,  -236,  -52 },
+  { 0xE45C10C42A2B3B06,  -210,  -44 },
+  { 0xAA242499697392D3,  -183,  -36 },
+  { 0xFD87B5F28300CA0E,  -157,  -28 },
+  { 0xBCE5086492111AEB,  -130,  -20 },
+  { 0x8CBCCC096F5088CC,  -103,  -12 },
+  { 0xD1B71758E219652C,   -77,   -4 },
+  { 0x9C40000000000000,   -50,    4 },
+  { 0xE8D4A51000000000,   -24,   12 },
+  { 0xAD78EBC5AC620000,     3,   20 },
+  { 0x813F3978F8940984,    30,   28 },
+  { 0xC097CE7BC90715B3,    56,   36 },
+  { 0x8F7E32CE7BEA5C70,    83,   44 },
+  { 0xD5D238A4ABE98068,   109,   52 },
+  { 0x9F4F2726179A2245,   136,   60 },
+  { 0xED63A231D4C4FB27,   162,   68 },
+  { 0xB0DE65388CC8ADA8,   189,   76 },
+  { 0x83C7088E1AAB65DB,   216,   84 },
+  { 0xC45D1DF942711D9A,   242,   92 },
+  { 0x924D692CA61BE758,   269,  100 },
+  { 0xDA01EE641A708DEA,   295,  108 },
+  { 0xA26DA3999AEF774A,   322,  116 },
+  { 0xF209787BB47D6B85,   348,  124 },
+  { 0xB454E4A179DD1877,   375,  132 },
+  { 0x865B86925B9BC5C2,   402,  140 },
+  { 0xC83553C5C8965D3D,   428,  148 },
+  { 0x952AB45CFA97A0B3,   455,  156 },
+  { 0xDE469FBD99A05FE3,   481,  164 },
+  { 0xA59BC234DB398C25,   508,  172 },
+  { 0xF6C69A72A3989F5C,   534,  180 },
+  { 0xB7DCBF5354E9BECE,   561,  188 },
+  { 0x88FCF317F22241E2,   588,  196 },
+  { 0xCC20CE9BD35C78A5,   614,  204 },
+  { 0x98165AF37B2153DF,   641,  212 },
+  { 0xE2A0B5DC971F303A,   667,  220 },
+  { 0xA8D9D1535CE3B396,   694,  228 },
+  { 0xFB9B7CD9A4A7443C,   720,  236 },
+  { 0xBB764C4CA7A44410,   747,  244 },
+  { 0x8BAB8EEFB6409C1A,   774,  252 },
+  { 0xD01FEF10A657842C,   800,  260 },
+  { 0x9B10A4E5E9913129,   827,  268 },
+  { 0xE7109BFBA19C0C9D,   853,  276 },
+  { 0xAC2820D9623BF429,   880,  284 },
+  { 0x80444B5E7AA7CF85,   907,  292 },
+  { 0xBF21E44003ACDD2D,   933,  300 },
+  { 0x8E679C2F5E44FF8F,   960,  308 },
+  { 0xD433179D9C8CB841,   986,  316 },
+  { 0x9E19DB92B4E31BA9,  1013,  324 },
+};
+
+// a cached 10^k whose product with a normalized w of exponent e has an
+// exponent in [ALPHA, GAMMA]
+static const CachedPower& cachedPower(int e)
+{
+  int f = ALPHA - e - 1;
+  int k = (f * 78913) / (1 << 18) + (f > 0);        // ceil(f * log10(2))
+  int index = (300 + k + 7) / 8;
+  return kCachedPowers[index];
+}
+
+static unsigned digitCount(uint32_t n)
+{
+  unsigned count = 1;
+  while (n >= 10)
+  {
+    n /= 10;
+    count++;
+  }
+  return count;
+}
+
+// moves the last digit towards w while the result stays in the interval
+static void roundWeed(char* buf, int len, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k)
+{
+  while (rest < dist && delta - rest >= ten_k &&
+         (rest + ten_k < dist || dist - rest > rest + ten_k - dist))
+  {
+    buf[len - 1]--;
+    rest += ten_k;
+  }
+}
+
+// digits of a number in (m_minus, m_plus) close to w, all scaled so that
+// the exponent is in [ALPHA, GAMMA]; value = digits * 10^exponent
+static void digitGen(char* buf, int& len, int& exponent, const DiyFp& m_minus, const DiyFp& w, const DiyFp& m_plus)
+{
+  uint64_t delta = sub(m_plus, m_minus).f;
+  uint64_t dist = sub(m_plus, w).f;
+  DiyFp one((uint64_t)1 << -m_plus.e, m_plus.e);
+
+  uint32_t p1 = (uint32_t)(m_plus.f >> -one.e);     // integral part, < 2^32 as e >= ALPHA
+  uint64_t p2 = m_plus.f & (one.f - 1);
+
+  unsigned n = digitCount(p1);
+  uint32_t pow10 = 1;
+  for (unsigned i = 1; i < n; i++) pow10 *= 10;
+
+  while (n > 0)
+  {
+    buf[len++] = (char)('0' + p1 / pow10);
+    p1 %= pow10;
+    n--;
+    uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+    if (rest <= delta)
+    {
+      exponent += n;
+      roundWeed(buf, len, dist, delta, rest, (uint64_t)pow10 << -one.e);
+      return;
+    }
+    pow10 /= 10;
+  }
+
+  int m = 0;
+  for (;;)
+  {
+    p2 *= 10;
+    buf[len++] = (char)('0' + (p2 >> -one.e));
+    p2 &= one.f - 1;
+    m++;
+    delta *= 10;
+    dist *= 10;
+    if (p2 <= delta) break;
+  }
+  exponent -= m;
+  roundWeed(buf, len, dist, delta, p2, one.f);
+}
+
+// shortest digits of the positive finite value with significand bits
+// `mantissa` (without the hidden bit) and biased exponent `biased`
+static void grisu2(char* buf, int& len, int& exponent, uint64_t mantissa, int biased,
+                   int mantissa_bits, int bias)
+{
+  uint64_t hidden = (uint64_t)1 << mantissa_bits;
+  DiyFp v = biased == 0 ? DiyFp(mantissa, 1 - bias) : DiyFp(mantissa | hidden, biased - bias);
+
+  // the boundaries are halfway to the neighbours; the lower one is closer
+  // when v is a power of two
+  bool closer = mantissa == 0 && biased > 1;
+  DiyFp plus = normalize(DiyFp(2 * v.f + 1, v.e - 1));
+  DiyFp minus = normalizeTo(closer ? DiyFp(4 * v.f - 1, v.e - 2) : DiyFp(2 * v.f - 1, v.e - 1), plus.e);
+  DiyFp w = normalizeTo(v, plus.e);
+
+  const CachedPower& cached = cachedPower(plus.e);
+  DiyFp c(cached.f, cached.e);
+  DiyFp w_scaled = mul(w, c);
+  DiyFp minus_scaled = mul(minus, c);
+  DiyFp plus_scaled = mul(plus, c);
+
+  // the products are off by at most one unit; stay safely inside
+  DiyFp m_minus(minus_scaled.f + 1, minus_scaled.e);
+  DiyFp m_plus(plus_scaled.f - 1, plus_scaled.e);
+
+  len = 0;
+  exponent = -cached.k;
+  digitGen(buf, len, exponent, m_minus, w_scaled, m_plus);
+}
+
+// digits * 10^exponent in fixed or exponent notation
+static char* formatDigits(char* p, const char* digits, int len, int exponent)
+{
+  int point = len + exponent;                       // digits before the decimal point
+  if (len <= point && point <= 15)
+  {
+    memcpy(p, digits, len);
+    memset(p + len, '0', point - len);
+    return p + point;
+  }
+  if (0 < point && point <= 15)
+  {
+    memcpy(p, digits, point);
+    p[point] = '.';
+    memcpy(p + point + 1, digits + point, len - point);
+    return p + len + 1;
+  }
+  if (-4 < point && point <= 0)
+  {
+    p[0] = '0';
+    p[1] = '.';
+    memset(p + 2, '0', -point);
+    memcpy(p + 2 - point, digits, len);
+    return p + 2 - point + len;
+  }
+
+  *p++ = digits[0];
+  if (len > 1)
+  {
+    *p++ = '.';
+    memcpy(p, digits + 1, len - 1);
+    p += len - 1;
+  }
+  int e = point - 1;
+  *p++ = 'e';
+  *p++ = e < 0 ? '-' : '+';
+  if (e < 0) e = -e;
+  if (e >= 100) *p++ = (char)('0' + e / 100);
+  *p++ = (char)('0' + e / 10 % 10);
+  *p++ = (char)('0' + e % 10);
+  return p;
+}
+
+static char* format(char* p, bool negative, uint64_t mantissa, int biased, int mantissa_bits,
+                    int max_biased, int bias)
+{
+  if (biased == max_biased)
+  {
+    if (mantissa != 0)
+    {
+      memcpy(p, "nan", 3);
+      return p + 3;
+    }
+    if (negative) *p++ = '-';
+    memcpy(p, "inf", 3);
+    return p + 3;
+  }
+  if (negative) *p++ = '-';
+  if (mantissa == 0 && biased == 0)
+  {
+    *p = '0';
+    return p + 1;
+  }
+
+  char digits[20];
+  int len, exponent;
+  grisu2(digits, len, exponent, mantissa, biased, mantissa_bits, bias);
+  return formatDigits(p, digits, len, exponent);
+}
+
+char* formatFloat(char* p, float v)
+{
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return format(p, bits >> 31, bits & 0x7FFFFF, (bits >> 23) & 0xFF, 23, 0xFF, 127 + 23);
+}
+
+char* formatDouble(char* p, double v)
+{
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return format(p, bits >> 63, bits & 0xFFFFFFFFFFFFFull, (int)((bits >> 52) & 0x7FF), 52, 0x7FF, 1023 + 52);
+}
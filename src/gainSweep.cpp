@@ -0,0 +1,364 @@
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "../include/dsp_kernels.h"
+#include "../include/imu_filter.h"
+#include "../include/imu_recording.h"
+#include "../include/work_stealing.h"
+
+using namespace std;
+
+#define DEFAULT_DT 0.01 // 100Hz, the IMU.cpp sample rate
+#define BANK_LANES 32 // configurations filtered side by side, see filterBankUpdateIMU
+#define RAD_TO_DEGREES 180/3.141592653589793238463
+
+// sweeps setAlgorithmGain / setDriftBiasGain / setWorldFrame over a recording
+// and ranks every combination by its attitude error against the truth
+// columns of the recording, or against a reference configuration if the
+// recording has no truth. Recordings with magnetometer columns run the MARG
+// update; without them the IMU update runs, which has no drift bias and
+// only sees whether gravity points up or down, so zeta is not swept and ENU
+// and NWU are one frame class.
+
+struct SweepConfig
+{
+	double gain;
+	double zeta;
+	WorldFrame::WorldFrame frame;
+};
+
+struct SweepResult
+{
+	SweepConfig config;
+	double mean_err;  // degrees
+	double rms_err;   // degrees
+	double max_err;   // degrees
+	double final_err; // degrees
+};
+
+// parses "min:max:steps" or "min:max:steps:log" into a list of values
+static bool parseRange(const char* arg, vector<double>& values)
+{
+	double lo, hi;
+	int steps;
+	char scale[4] = "";
+	int n = sscanf(arg, "%lf:%lf:%d:%3s", &lo, &hi, &steps, scale);
+	if (n == 1)
+	{
+		values.push_back(lo);
+		return true;
+	}
+	if (n < 3 || steps < 1) return false;
+	bool log_scale = strcmp(scale, "log") == 0;
+	if (log_scale && (lo <= 0 || hi <= 0)) return false;
+	for (int i = 0; i < steps; i++)
+	{
+		double f = steps == 1 ? 0.0 : (double)i / (steps - 1);
+		values.push_back(log_scale ? lo * pow(hi / lo, f) : lo + (hi - lo) * f);
+	}
+	return true;
+}
+
+static bool parseFrames(const char* arg, vector<WorldFrame::WorldFrame>& frames)
+{
+	string list(arg);
+	size_t start = 0;
+	for (;;)
+	{
+		size_t comma = list.find(',', start);
+		string name = list.substr(start, comma - start);
+		if (name == "ENU") frames.push_back(WorldFrame::ENU);
+		else if (name == "NED") frames.push_back(WorldFrame::NED);
+		else if (name == "NWU") frames.push_back(WorldFrame::NWU);
+		else return false;
+		if (comma == string::npos) return true;
+		start = comma + 1;
+	}
+}
+
+// the IMU update of ENU and NWU is the same
+static WorldFrame::WorldFrame imuFrameClass(WorldFrame::WorldFrame frame)
+{
+	return frame == WorldFrame::NWU ? WorldFrame::ENU : frame;
+}
+
+static const char* frameName(WorldFrame::WorldFrame frame, bool marg)
+{
+	if (!marg && frame != WorldFrame::NED) return "ENU/NWU";
+	switch (frame)
+	{
+	case WorldFrame::NED: return "NED";
+	case WorldFrame::NWU: return "NWU";
+	default: return "ENU";
+	}
+}
+
+// angle between two unit quaternions, in degrees
+static double quatAngle(double a0, double a1, double a2, double a3,
+	double b0, double b1, double b2, double b3)
+{
+	double dot = fabs(a0 * b0 + a1 * b1 + a2 * b2 + a3 * b3);
+	if (dot > 1.0) dot = 1.0;
+	return 2.0 * acos(dot) * RAD_TO_DEGREES;
+}
+
+// Runs one configuration over the recording. If out is non-null the
+// orientation after every sample is stored there (4 values per sample).
+static void runFilter(const ImuRecording& rec, const SweepConfig& config, float dt,
+	vector<double>* out, const vector<double>* ref, size_t skip, SweepResult* result)
+{
+	ImuFilter filter;
+	filter.setAlgorithmGain(config.gain);
+	filter.setDriftBiasGain(config.zeta);
+	filter.setWorldFrame(config.frame);
+	if (rec.hasTruth())
+		filter.setOrientation(rec.q0[0], rec.q1[0], rec.q2[0], rec.q3[0]);
+
+	double sum = 0, sum_sq = 0, max_err = 0, err = 0;
+	size_t scored = 0;
+	for (size_t i = 0; i < rec.size(); i++)
+	{
+		if (rec.hasMag())
+			filter.madgwickAHRSupdate(rec.gx[i], rec.gy[i], rec.gz[i],
+				rec.ax[i], rec.ay[i], rec.az[i], rec.mx[i], rec.my[i], rec.mz[i], rec.dt(i, dt));
+		else
+			filter.madgwickAHRSupdateIMU(rec.gx[i], rec.gy[i], rec.gz[i],
+				rec.ax[i], rec.ay[i], rec.az[i], rec.dt(i, dt));
+
+		double q0, q1, q2, q3;
+		filter.getOrientation(q0, q1, q2, q3);
+		if (out)
+		{
+			out->push_back(q0);
+			out->push_back(q1);
+			out->push_back(q2);
+			out->push_back(q3);
+		}
+		if (!result || i < skip) continue;
+
+		if (rec.hasTruth())
+			err = quatAngle(q0, q1, q2, q3, rec.q0[i], rec.q1[i], rec.q2[i], rec.q3[i]);
+		else
+			err = quatAngle(q0, q1, q2, q3, (*ref)[4 * i], (*ref)[4 * i + 1], (*ref)[4 * i + 2], (*ref)[4 * i + 3]);
+		if (!std::isfinite(err)) err = 180.0;
+
+		sum += err;
+		sum_sq += err * err;
+		if (err > max_err) max_err = err;
+		scored++;
+	}
+
+	if (result)
+	{
+		result->config = config;
+		result->mean_err = scored ? sum / scored : 0;
+		result->rms_err = scored ? sqrt(sum_sq / scored) : 0;
+		result->max_err = max_err;
+		result->final_err = err;
+	}
+}
+
+// Runs count configurations of a recording without magnetometer that
+// share a frame class over it as one filter bank, the lanes differing only
+// in their gain, and scores them like runFilter.
+static void runBank(const ImuRecording& rec, const SweepConfig* configs, size_t count, float dt,
+	const vector<double>* ref, size_t skip, SweepResult* results)
+{
+	vector<double> q0(count, 1.0), q1(count, 0.0), q2(count, 0.0), q3(count, 0.0), gain(count);
+	vector<double> sum(count, 0.0), sum_sq(count, 0.0), max_err(count, 0.0), err(count, 0.0);
+	for (size_t k = 0; k < count; k++)
+	{
+		gain[k] = configs[k].gain;
+		if (rec.hasTruth())
+		{
+			q0[k] = rec.q0[0];
+			q1[k] = rec.q1[0];
+			q2[k] = rec.q2[0];
+			q3[k] = rec.q3[0];
+		}
+	}
+
+	for (size_t i = 0; i < rec.size(); i++)
+	{
+		filterBankUpdateIMU(count, &q0[0], &q1[0], &q2[0], &q3[0], &gain[0], configs[0].frame,
+			rec.gx[i], rec.gy[i], rec.gz[i], rec.ax[i], rec.ay[i], rec.az[i], rec.dt(i, dt));
+		if (i < skip) continue;
+		if (rec.hasTruth())
+			accumulateAngleError(count, &q0[0], &q1[0], &q2[0], &q3[0],
+				rec.q0[i], rec.q1[i], rec.q2[i], rec.q3[i], &sum[0], &sum_sq[0], &max_err[0], &err[0]);
+		else
+			accumulateAngleError(count, &q0[0], &q1[0], &q2[0], &q3[0],
+				(*ref)[4 * i], (*ref)[4 * i + 1], (*ref)[4 * i + 2], (*ref)[4 * i + 3],
+				&sum[0], &sum_sq[0], &max_err[0], &err[0]);
+	}
+
+	size_t scored = rec.size() > skip ? rec.size() - skip : 0;
+	for (size_t k = 0; k < count; k++)
+	{
+		SweepResult& result = results[k];
+		result.config = configs[k];
+		result.mean_err = scored ? sum[k] / scored : 0;
+		result.rms_err = scored ? sqrt(sum_sq[k] / scored) : 0;
+		result.max_err = max_err[k];
+		result.final_err = err[k];
+	}
+}
+
+static bool byRmsError(const SweepResult& a, const SweepResult& b)
+{
+	return a.rms_err < b.rms_err;
+}
+
+static void usage(const char* name)
+{
+	printf("usage: %s <recording.csv> [options]\n"
+		"  --gain min:max:steps[:log]   algorithm gain values (default 0.1)\n"
+		"  --zeta min:max:steps[:log]   drift bias gain values (default 0), needs magnetometer columns\n"
+		"  --frames ENU,NED,NWU         world frames (default ENU); ENU and NWU are one without magnetometer\n"
+		"  --ref-gain g --ref-zeta z    reference solution when the recording has no truth\n"
+		"  --ref-frame F                (default 0.1, 0, ENU)\n"
+		"  --dt s                       time step without a Time column (default %g)\n"
+		"  --skip n                     samples excluded from scoring (default 0)\n"
+		"  --gyro-scale k               gyro column to rad/s (default deg/s)\n"
+		"  --threads n                  worker threads (default: all cores)\n"
+		"  --out file                   ranked table (default stdout)\n", name, DEFAULT_DT);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	vector<double> gains, zetas;
+	vector<WorldFrame::WorldFrame> frames, ref_frame;
+	SweepConfig ref = { 0.1, 0.0, WorldFrame::ENU };
+	float dt = DEFAULT_DT;
+	float gyro_scale = 3.14159265358979f / 180.0f;
+	size_t skip = 0;
+	unsigned threads = 0;
+	const char* out_path = 0;
+
+	for (int i = 2; i < argc; i++)
+	{
+		const char* opt = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : 0;
+		bool ok = val != 0;
+		if (ok && !strcmp(opt, "--gain")) ok = parseRange(val, gains);
+		else if (ok && !strcmp(opt, "--zeta")) ok = parseRange(val, zetas);
+		else if (ok && !strcmp(opt, "--frames")) ok = parseFrames(val, frames);
+		else if (ok && !strcmp(opt, "--ref-gain")) ref.gain = atof(val);
+		else if (ok && !strcmp(opt, "--ref-zeta")) ref.zeta = atof(val);
+		else if (ok && !strcmp(opt, "--ref-frame")) ok = parseFrames(val, ref_frame) && ref_frame.size() == 1;
+		else if (ok && !strcmp(opt, "--dt")) dt = atof(val);
+		else if (ok && !strcmp(opt, "--skip")) skip = strtoul(val, 0, 10);
+		else if (ok && !strcmp(opt, "--gyro-scale")) gyro_scale = atof(val);
+		else if (ok && !strcmp(opt, "--threads")) threads = strtoul(val, 0, 10);
+		else if (ok && !strcmp(opt, "--out")) out_path = val;
+		else ok = false;
+		if (!ok)
+		{
+			printf("bad option %s\n", opt);
+			usage(argv[0]);
+			return 1;
+		}
+		i++;
+	}
+	if (gains.empty()) gains.push_back(0.1);
+	if (zetas.empty()) zetas.push_back(0.0);
+	if (frames.empty()) frames.push_back(WorldFrame::ENU);
+	if (!ref_frame.empty()) ref.frame = ref_frame[0];
+
+	// the recording is loaded once and shared read-only by every worker
+	ImuRecording rec;
+	if (!loadImuRecording(argv[1], rec, gyro_scale))
+	{
+		printf("could not read %s\n", argv[1]);
+		return 1;
+	}
+
+	// without a magnetometer zeta does nothing and ENU and NWU filter alike,
+	// so they would only fill the table with duplicates
+	bool marg = rec.hasMag();
+	if (!marg)
+	{
+		if (zetas.size() > 1 || zetas[0] != 0.0)
+		{
+			printf("%s has no magnetometer columns: the IMU update has no drift bias, --zeta cannot be swept\n", argv[1]);
+			return 1;
+		}
+		vector<WorldFrame::WorldFrame> classes;
+		for (size_t f = 0; f < frames.size(); f++)
+			if (find(classes.begin(), classes.end(), imuFrameClass(frames[f])) == classes.end())
+				classes.push_back(imuFrameClass(frames[f]));
+		frames = classes;
+		ref.frame = imuFrameClass(ref.frame);
+	}
+
+	vector<double> reference;
+	if (!rec.hasTruth())
+	{
+		reference.reserve(4 * rec.size());
+		runFilter(rec, ref, dt, &reference, 0, 0, 0);
+	}
+
+	vector<SweepConfig> configs;
+	for (size_t f = 0; f < frames.size(); f++)
+		for (size_t g = 0; g < gains.size(); g++)
+			for (size_t z = 0; z < zetas.size(); z++)
+			{
+				SweepConfig c = { gains[g], zetas[z], frames[f] };
+				configs.push_back(c);
+			}
+
+	if (threads == 0) threads = defaultThreadCount();
+	fprintf(stderr, "%zu samples, %zu configurations, %u threads, %s update, scoring against %s\n",
+		rec.size(), configs.size(), threads, marg ? "MARG" : "IMU", rec.hasTruth() ? "truth" : "reference");
+
+	vector<SweepResult> results(configs.size());
+	if (marg)
+	{
+		parallelFor(configs.size(), threads, [&](size_t i) {
+			runFilter(rec, configs[i], dt, 0, &reference, skip, &results[i]);
+		});
+	}
+	else
+	{
+		// configs are grouped by frame, so a bank is a run of at most
+		// BANK_LANES configurations with the same frame
+		vector<size_t> banks;
+		for (size_t i = 0; i < configs.size(); i++)
+			if (banks.empty() || i - banks.back() == BANK_LANES || configs[i].frame != configs[i - 1].frame)
+				banks.push_back(i);
+		banks.push_back(configs.size());
+
+		parallelFor(banks.size() - 1, threads, [&](size_t b) {
+			runBank(rec, &configs[banks[b]], banks[b + 1] - banks[b], dt, &reference, skip, &results[banks[b]]);
+		});
+	}
+
+	stable_sort(results.begin(), results.end(), byRmsError);
+
+	FILE* out = out_path ? fopen(out_path, "w") : stdout;
+	if (!out)
+	{
+		printf("could not open %s\n", out_path);
+		return 1;
+	}
+	fprintf(out, "rank,gain,zeta,frame,rms_err_deg,mean_err_deg,max_err_deg,final_err_deg\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const SweepResult& r = results[i];
+		fprintf(out, "%zu,%.9g,%.9g,%s,%.6f,%.6f,%.6f,%.6f\n", i + 1,
+			r.config.gain, r.config.zeta, frameName(r.config.frame, marg),
+			r.rms_err, r.mean_err, r.max_err, r.final_err);
+	}
+	if (out != stdout) fclose(out);
+	return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/imu_device.h"
+
+#define RAD_TO_DEGREES (180 / 3.141592653589793238463)
+#define INTERNAL_RATE_HZ 1000 // ICM-20602 output rate with the DLPF on
+
+EmulatedDevice::EmulatedDevice() : finished_(false), valid_(false)
+{
+  memset(registers_, 0, sizeof(registers_));
+}
+
+// the next sample into the output registers, big endian like the sensor;
+// a failed sample leaves the previous values and fails the reads
+void EmulatedDevice::latch()
+{
+  FlightLogRecord record;
+  valid_ = !finished_ && nextSample(record);
+  if (!valid_) return;
+  const int16_t out[7] = { record.accel[0], record.accel[1], record.accel[2], record.temp,
+                           record.gyro[0], record.gyro[1], record.gyro[2] };
+  for (int k = 0; k < 7; k++)
+  {
+    registers_[ICM_ACCEL_XOUT_H + 2 * k] = (uint16_t)out[k] >> 8;
+    registers_[ICM_ACCEL_XOUT_H + 2 * k + 1] = (uint16_t)out[k] & 0xff;
+  }
+}
+
+bool EmulatedDevice::readRegisters(uint8_t reg, uint8_t* data, size_t len)
+{
+  if (reg <= ICM_ACCEL_XOUT_H && reg + len > ICM_ACCEL_XOUT_H) latch();
+  for (size_t i = 0; i < len; i++) data[i] = registers_[(reg + i) & (ICM_REGISTERS - 1)];
+  bool output = reg <= ICM_GYRO_ZOUT_L && reg + len > ICM_ACCEL_XOUT_H;
+  return valid_ || !output;
+}
+
+bool EmulatedDevice::writeRegisters(uint8_t reg, const uint8_t* data, size_t len)
+{
+  for (size_t i = 0; i < len; i++) setRegister(reg + i, data[i]);
+  return true;
+}
+
+bool ReplayDevice::open()
+{
+  if (!log_.open(path_)) return false;
+  const FlightLogHeader& header = log_.header();
+  setRegister(ICM_SMPLRT_DIV, header.smplrt_div);
+  setRegister(ICM_CONFIG, header.config);
+  setRegister(ICM_GYRO_CONFIG, header.gyro_config);
+  setRegister(ICM_ACCEL_CONFIG, header.accel_config);
+  setRegister(ICM_ACCEL_CONFIG2, header.accel_config2);
+  next_ = 0;
+  finished_ = false;
+  return true;
+}
+
+void ReplayDevice::close()
+{
+  log_.close();
+}
+
+bool ReplayDevice::nextSample(FlightLogRecord& record)
+{
+  if (next_ >= log_.size())
+  {
+    finished_ = true;
+    return false;
+  }
+  record = log_[next_++];
+  finished_ = next_ >= log_.size();
+  return !(record.flags & FLIGHT_LOG_FLAG_READ_ERROR);
+}
+
+// the FS_SEL / AFS_SEL field of the smallest range that covers full_scale
+static uint8_t rangeField(double full_scale, double smallest)
+{
+  uint8_t field = 0;
+  while (field < 3 && full_scale > smallest * (1 << field) + 0.5) field++;
+  return field << 3;
+}
+
+SyntheticDevice::~SyntheticDevice()
+{
+  close();
+}
+
+bool SyntheticDevice::open()
+{
+  close();
+  sim_ = new TumbleSim(config_);
+  double div = config_.sample_hz > 0 ? INTERNAL_RATE_HZ / config_.sample_hz - 1 : 0;
+  setRegister(ICM_SMPLRT_DIV, div < 0 ? 0 : div > 255 ? 255 : (uint8_t)(div + 0.5));
+  setRegister(ICM_CONFIG, 1);
+  setRegister(ICM_GYRO_CONFIG, rangeField(config_.gyro.full_scale * RAD_TO_DEGREES, 250));
+  setRegister(ICM_ACCEL_CONFIG, rangeField(config_.accel.full_scale, 2));
+  return true;
+}
+
+void SyntheticDevice::close()
+{
+  delete sim_;
+  sim_ = 0;
+}
+
+// temperature stays at the 25 degC of a zero reading
+bool SyntheticDevice::nextSample(FlightLogRecord& record)
+{
+  if (!sim_) return false;
+  TumbleSample s;
+  sim_->next(s);
+  memcpy(record.accel, s.accel_raw, sizeof(record.accel));
+  memcpy(record.gyro, s.gyro_raw, sizeof(record.gyro));
+  record.temp = 0;
+  return true;
+}
+
+ImuDevice* createHostDevice(const char* spec)
+{
+  if (!strncmp(spec, "replay:", 7) && spec[7]) return new ReplayDevice(spec + 7);
+  if (!strcmp(spec, "synthetic") || !strncmp(spec, "synthetic:", 10))
+  {
+    TumbleConfig config;
+    initTumbleConfig(config);
+    if (spec[9] == ':') config.seed = strtoull(spec + 10, 0, 10);
+    return new SyntheticDevice(config);
+  }
+  return 0;
+}
@@ -24,6 +24,7 @@
 
 #include <cmath>
 #include "../include/imu_filter.h"
+#include "../include/stage_probe.h"
 
 // Fast inverse square-root
 // See: http://en.wikipedia.org/wiki/Methods_of_computing_square_roots#Reciprocal_of_the_square_root
@@ -178,6 +179,7 @@ void ImuFilter::madgwickAHRSupdate(
     float mx, float my, float mz,
     float dt)
 {
+  STAGE_PROBE(PROBE_FILTER_MARG);
   float s0, s1, s2, s3;
   float qDot1, qDot2, qDot3, qDot4;
   float _2bz, _2bxy;
@@ -260,6 +262,7 @@ void ImuFilter::madgwickAHRSupdateIMU(
     float ax, float ay, float az,
     float dt)
 {
+  STAGE_PROBE(PROBE_FILTER_IMU);
   float s0, s1, s2, s3;
   float qDot1, qDot2, qDot3, qDot4;
 
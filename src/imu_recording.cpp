@@ -0,0 +1,112 @@
+#include "../include/csv_reader.h"
+#include "../include/dsp_kernels.h"
+#include "../include/flight_log.h"
+#include "../include/imu_recording.h"
+
+enum Column { T, AX, AY, AZ, GX, GY, GZ, MX, MY, MZ, Q0, Q1, Q2, Q3, COLUMN_COUNT };
+
+// Accepted header names for every column. An entry starting with '*' matches
+// any header ending in the rest of the string (Shimmer prefixes the device id).
+static const char* const kColumnNames[COLUMN_COUNT][4] = {
+  { "Time", "Time (s)", 0 },
+  { "Median Accel X", "Accel X", "*_Accel_LN_X_CAL", 0 },
+  { "Median Accel Y", "Accel Y", "*_Accel_LN_Y_CAL", 0 },
+  { "Median Accel Z", "Accel Z", "*_Accel_LN_Z_CAL", 0 },
+  { "Raw Gyro X", "Gyro X", "*_Gyro_X_CAL", 0 },
+  { "Raw Gyro Y", "Gyro Y", "*_Gyro_Y_CAL", 0 },
+  { "Raw Gyro Z", "Gyro Z", "*_Gyro_Z_CAL", 0 },
+  { "Mag X", "*_Mag_X_CAL", 0 },
+  { "Mag Y", "*_Mag_Y_CAL", 0 },
+  { "Mag Z", "*_Mag_Z_CAL", 0 },
+  { "Truth Q0", 0 },
+  { "Truth Q1", 0 },
+  { "Truth Q2", 0 },
+  { "Truth Q3", 0 },
+};
+
+// flight logs carry their own scale factors: accel in g, gyro in deg/s
+static bool loadFlightLog(const char* path, ImuRecording& rec, float gyro_scale)
+{
+  FlightLogReader log;
+  if (!log.open(path)) return false;
+
+  // records are converted a run at a time; a run ends at a read error or
+  // at the end of a block, where the records stop being adjacent
+  size_t n = log.size(), kept = 0;
+  rec = ImuRecording();
+  rec.t.resize(n);
+  rec.ax.resize(n);
+  rec.ay.resize(n);
+  rec.az.resize(n);
+  rec.gx.resize(n);
+  rec.gy.resize(n);
+  rec.gz.resize(n);
+  for (size_t i = 0; i < n;)
+  {
+    size_t end = i;
+    while (end < n && !(log[end].flags & FLIGHT_LOG_FLAG_READ_ERROR) &&
+           (end == i || &log[end] == &log[end - 1] + 1))
+      end++;
+    if (end == i)
+    {
+      i++;
+      continue;
+    }
+    convertRecords(end - i, &log[i], log.header(), gyro_scale, &rec.t[kept],
+                   &rec.ax[kept], &rec.ay[kept], &rec.az[kept],
+                   &rec.gx[kept], &rec.gy[kept], &rec.gz[kept]);
+    kept += end - i;
+    i = end;
+  }
+  rec.t.resize(kept);
+  rec.ax.resize(kept);
+  rec.ay.resize(kept);
+  rec.az.resize(kept);
+  rec.gx.resize(kept);
+  rec.gy.resize(kept);
+  rec.gz.resize(kept);
+  return rec.size() > 0;
+}
+
+bool loadImuRecording(const char* path, ImuRecording& rec, float gyro_scale)
+{
+  if (isFlightLog(path)) return loadFlightLog(path, rec, gyro_scale);
+
+  CsvReader csv;
+  if (!csv.open(path)) return false;
+
+  rec = ImuRecording();
+  std::vector<float>* out[COLUMN_COUNT] = {
+    0, &rec.ax, &rec.ay, &rec.az, &rec.gx, &rec.gy, &rec.gz, &rec.mx, &rec.my, &rec.mz,
+    &rec.q0, &rec.q1, &rec.q2, &rec.q3
+  };
+  CsvColumn columns[COLUMN_COUNT];
+  for (int c = 0; c < COLUMN_COUNT; c++)
+  {
+    columns[c].names = kColumnNames[c];
+    columns[c].required = c >= AX && c <= GZ;
+    columns[c].out = out[c];
+    columns[c].out_double = c == T ? &rec.t : 0;
+  }
+
+  // the header is the first line naming all six sensor columns; this skips
+  // the "sep=," preamble some exporters write
+  if (!csv.findHeader(columns, COLUMN_COUNT)) return false;
+
+  bool truth = columns[Q0].field >= 0 && columns[Q1].field >= 0 &&
+               columns[Q2].field >= 0 && columns[Q3].field >= 0;
+  if (!truth) columns[Q0].field = columns[Q1].field = columns[Q2].field = columns[Q3].field = -1;
+  bool mag = columns[MX].field >= 0 && columns[MY].field >= 0 && columns[MZ].field >= 0;
+  if (!mag) columns[MX].field = columns[MY].field = columns[MZ].field = -1;
+
+  // rows that are not numeric (e.g. the Shimmer units line) are skipped
+  if (csv.readRows(columns, COLUMN_COUNT) == 0) return false;
+
+  for (size_t i = 0; i < rec.size(); i++)
+  {
+    rec.gx[i] *= gyro_scale;
+    rec.gy[i] *= gyro_scale;
+    rec.gz[i] *= gyro_scale;
+  }
+  return true;
+}
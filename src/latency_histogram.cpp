@@ -0,0 +1,65 @@
+#include "../include/latency_histogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+void LatencyHistogram::reset()
+{
+  for (size_t b = 0; b < LATENCY_BUCKETS; b++) counts_[b].store(0, std::memory_order_relaxed);
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::bucketTop(size_t b)
+{
+  if (b < 2 * LATENCY_SUB_BUCKETS) return b;
+  unsigned shift = (unsigned)(b / LATENCY_SUB_BUCKETS) - 1;
+  uint64_t m = b - (uint64_t)shift * LATENCY_SUB_BUCKETS;
+  return ((m + 1) << shift) - 1;
+}
+
+double LatencyHistogram::mean() const
+{
+  uint64_t n = count();
+  return n ? (double)sum_.load(std::memory_order_relaxed) / n : 0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+  uint64_t n = count();
+  if (n == 0) return 0;
+  uint64_t rank = (uint64_t)(p * n + 0.5);
+  if (rank < 1) rank = 1;
+  uint64_t seen = 0;
+  for (size_t b = 0; b < LATENCY_BUCKETS; b++)
+  {
+    seen += counts_[b].load(std::memory_order_relaxed);
+    if (seen >= rank)
+    {
+      // the top of the bucket, but never above the largest value seen
+      uint64_t top = bucketTop(b), most = max();
+      return top < most ? top : most;
+    }
+  }
+  return max();
+}
+
+uint64_t LatencyHistogram::countAbove(uint64_t ns) const
+{
+  if (ns >= (1ull << LATENCY_MAX_BITS)) return 0;
+  uint64_t above = 0;
+  for (size_t b = bucket(ns) + 1; b < LATENCY_BUCKETS; b++)
+    above += counts_[b].load(std::memory_order_relaxed);
+  return above;
+}
+
+void LatencyHistogram::print(FILE* out, const char* name) const
+{
+  fprintf(out, "%-12s n %-10llu p50 %9.1f  p99 %9.1f  p99.9 %9.1f  max %9.1f  mean %9.1f us\n",
+          name, (unsigned long long)count(),
+          percentile(0.5) * 1e-3, percentile(0.99) * 1e-3, percentile(0.999) * 1e-3,
+          max() * 1e-3, mean() * 1e-3);
+}
@@ -0,0 +1,153 @@
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../include/imu_filter.h"
+#include "../include/imu_recording.h"
+#include "../include/linear_accel.h"
+#include "../include/text_writer.h"
+
+using namespace std;
+
+#define DEFAULT_DT 0.01
+#define BATCH_SIZE 4096
+#define STANDARD_GRAVITY 9.80665
+
+// replays a recording through the attitude filter and writes gravity-free
+// linear acceleration in the body and world frames, plus the integrated
+// world-frame velocity and position
+
+static void usage(const char* name)
+{
+	printf("usage: %s <recording.csv> [options]\n"
+		"  --gain g             filter gain (default 0.1)\n"
+		"  --frame ENU|NED|NWU  world frame (default ENU)\n"
+		"  --dt s               sample spacing without a Time column (default %g)\n"
+		"  --accel-scale k      accel column to m/s^2 (default %g, i.e. column in g)\n"
+		"  --leak tau           velocity/position decay time constant in s (default off)\n"
+		"  --max-velocity v     velocity clamp in m/s (default off)\n"
+		"  --out file           output CSV (default stdout)\n", name, DEFAULT_DT, STANDARD_GRAVITY);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	double gain = 0.1;
+	WorldFrame::WorldFrame frame = WorldFrame::ENU;
+	float dt = DEFAULT_DT, accel_scale = STANDARD_GRAVITY, leak = 0, max_velocity = 0;
+	const char* out_path = 0;
+	for (int i = 2; i < argc; i += 2)
+	{
+		const char* opt = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : 0;
+		if (!val)
+		{
+			printf("option %s needs a value\n", opt);
+			usage(argv[0]);
+			return 1;
+		}
+		if (!strcmp(opt, "--gain")) gain = atof(val);
+		else if (!strcmp(opt, "--frame") && !strcmp(val, "ENU")) frame = WorldFrame::ENU;
+		else if (!strcmp(opt, "--frame") && !strcmp(val, "NED")) frame = WorldFrame::NED;
+		else if (!strcmp(opt, "--frame") && !strcmp(val, "NWU")) frame = WorldFrame::NWU;
+		else if (!strcmp(opt, "--dt")) dt = atof(val);
+		else if (!strcmp(opt, "--accel-scale")) accel_scale = atof(val);
+		else if (!strcmp(opt, "--leak")) leak = atof(val);
+		else if (!strcmp(opt, "--max-velocity")) max_velocity = atof(val);
+		else if (!strcmp(opt, "--out")) out_path = val;
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	ImuRecording rec;
+	if (!loadImuRecording(argv[1], rec))
+	{
+		printf("could not read %s\n", argv[1]);
+		return 1;
+	}
+	TextWriter out;
+	if (!out.open(out_path))
+	{
+		printf("could not open %s\n", out_path);
+		return 1;
+	}
+
+	ImuFilter filter;
+	filter.setAlgorithmGain(gain);
+	filter.setWorldFrame(frame);
+	if (rec.hasTruth())
+		filter.setOrientation(rec.q0[0], rec.q1[0], rec.q2[0], rec.q3[0]);
+	LinearAccelIntegrator integrator(leak, max_velocity);
+
+	// one batch of every column, reused for the whole recording
+	vector<float> q[4], a[3], body[3], world[3], v[3], p[3], step(BATCH_SIZE);
+	for (int k = 0; k < 4; k++) q[k].resize(BATCH_SIZE);
+	for (int k = 0; k < 3; k++)
+	{
+		a[k].resize(BATCH_SIZE);
+		body[k].resize(BATCH_SIZE);
+		world[k].resize(BATCH_SIZE);
+		v[k].resize(BATCH_SIZE);
+		p[k].resize(BATCH_SIZE);
+	}
+
+	out.put("Linear Accel X, Linear Accel Y, Linear Accel Z, World Accel X, World Accel Y, World Accel Z, Velocity X, Velocity Y, Velocity Z, Position X, Position Y, Position Z\n");
+	for (size_t start = 0; start < rec.size(); start += BATCH_SIZE)
+	{
+		size_t n = min((size_t)BATCH_SIZE, rec.size() - start);
+
+		// attitude is inherently sequential; the stages after it run on the batch
+		for (size_t i = 0; i < n; i++)
+		{
+			size_t s = start + i;
+			step[i] = rec.dt(s, dt);
+			filter.madgwickAHRSupdateIMU(rec.gx[s], rec.gy[s], rec.gz[s],
+				rec.ax[s], rec.ay[s], rec.az[s], step[i]);
+			double q0, q1, q2, q3;
+			filter.getOrientation(q0, q1, q2, q3);
+			q[0][i] = q0;
+			q[1][i] = q1;
+			q[2][i] = q2;
+			q[3][i] = q3;
+			a[0][i] = rec.ax[s] * accel_scale;
+			a[1][i] = rec.ay[s] * accel_scale;
+			a[2][i] = rec.az[s] * accel_scale;
+		}
+
+		LinearAccelBatch batch = { n, &q[0][0], &q[1][0], &q[2][0], &q[3][0],
+			&a[0][0], &a[1][0], &a[2][0],
+			&body[0][0], &body[1][0], &body[2][0],
+			&world[0][0], &world[1][0], &world[2][0] };
+		removeGravity(batch, frame);
+		// the same measured spacing as the filter, not the nominal --dt
+		integrator.integrate(n, &world[0][0], &world[1][0], &world[2][0], &step[0],
+			&v[0][0], &v[1][0], &v[2][0], &p[0][0], &p[1][0], &p[2][0]);
+
+		// shortest round-trip digits; the columns read back bit-exactly
+		const vector<float>* columns[12] = { &body[0], &body[1], &body[2], &world[0], &world[1], &world[2],
+			&v[0], &v[1], &v[2], &p[0], &p[1], &p[2] };
+		for (size_t i = 0; i < n; i++)
+		{
+			for (int c = 0; c < 12; c++)
+			{
+				out.put((*columns[c])[i]);
+				out.put(c < 11 ? ',' : '\n');
+			}
+		}
+	}
+	if (!out.close())
+	{
+		printf("error writing %s\n", out_path ? out_path : "output");
+		return 1;
+	}
+	return 0;
+}
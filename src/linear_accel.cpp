@@ -0,0 +1,151 @@
+#include <cmath>
+#include "../include/linear_accel.h"
+
+// The loops below are written so that GCC vectorizes them at -O3: unit
+// stride, no branches, and __restrict so the compiler knows the outputs
+// do not alias the inputs. One quaternion is turned into the rotation
+// matrix terms it needs and applied to one sample per lane.
+
+// body = a - R * g_world, with g_world = [0, 0, gz] so only the third
+// column of R is needed (the same terms rotateAndScaleVector uses)
+static void removeGravityBody(size_t n, float gz,
+    const float* __restrict q0, const float* __restrict q1,
+    const float* __restrict q2, const float* __restrict q3,
+    const float* __restrict ax, const float* __restrict ay, const float* __restrict az,
+    float* __restrict bx, float* __restrict by, float* __restrict bz)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    float rx = 2.0f * (q1[i] * q3[i] - q0[i] * q2[i]);
+    float ry = 2.0f * (q0[i] * q1[i] + q2[i] * q3[i]);
+    float rz = 1.0f - 2.0f * (q1[i] * q1[i] + q2[i] * q2[i]);
+    bx[i] = ax[i] - gz * rx;
+    by[i] = ay[i] - gz * ry;
+    bz[i] = az[i] - gz * rz;
+  }
+}
+
+// world = R^T * a - g_world
+static void removeGravityWorld(size_t n, float gz,
+    const float* __restrict q0, const float* __restrict q1,
+    const float* __restrict q2, const float* __restrict q3,
+    const float* __restrict ax, const float* __restrict ay, const float* __restrict az,
+    float* __restrict wx, float* __restrict wy, float* __restrict wz)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    float a = q0[i], b = q1[i], c = q2[i], d = q3[i];
+    float x = ax[i], y = ay[i], z = az[i];
+    wx[i] = x * (1.0f - 2.0f * (c * c + d * d))
+          + y * 2.0f * (b * c - a * d)
+          + z * 2.0f * (a * c + b * d);
+    wy[i] = x * 2.0f * (a * d + b * c)
+          + y * (1.0f - 2.0f * (b * b + d * d))
+          + z * 2.0f * (c * d - a * b);
+    wz[i] = x * 2.0f * (b * d - a * c)
+          + y * 2.0f * (a * b + c * d)
+          + z * (1.0f - 2.0f * (b * b + c * c))
+          - gz;
+  }
+}
+
+void removeGravity(const LinearAccelBatch& batch, WorldFrame::WorldFrame frame,
+                   float gravity)
+{
+  // gravity as the accelerometer sees it at rest, in world coordinates
+  float gz;
+  switch (frame) {
+    case WorldFrame::NED:
+      gz = -gravity;
+      break;
+    case WorldFrame::NWU:
+    default:
+    case WorldFrame::ENU:
+      gz = gravity;
+      break;
+  }
+
+  if (batch.body_x && batch.body_y && batch.body_z)
+    removeGravityBody(batch.count, gz, batch.q0, batch.q1, batch.q2, batch.q3,
+        batch.ax, batch.ay, batch.az, batch.body_x, batch.body_y, batch.body_z);
+
+  if (batch.world_x && batch.world_y && batch.world_z)
+    removeGravityWorld(batch.count, gz, batch.q0, batch.q1, batch.q2, batch.q3,
+        batch.ax, batch.ay, batch.az, batch.world_x, batch.world_y, batch.world_z);
+}
+
+LinearAccelIntegrator::LinearAccelIntegrator(float time_constant, float max_velocity) :
+    time_constant_(time_constant), max_velocity_(max_velocity)
+{
+  reset();
+}
+
+void LinearAccelIntegrator::reset()
+{
+  for (int k = 0; k < 3; k++)
+  {
+    v_[k] = 0.0f;
+    p_[k] = 0.0f;
+  }
+}
+
+static inline float clampAbs(float v, float limit)
+{
+  if (limit <= 0.0f) return v;
+  return v > limit ? limit : (v < -limit ? -limit : v);
+}
+
+void LinearAccelIntegrator::integrate(size_t count,
+    const float* wx, const float* wy, const float* wz, float dt,
+    float* vx, float* vy, float* vz,
+    float* px, float* py, float* pz)
+{
+  // the leak factor is constant for a fixed dt, so it is computed once
+  float leak = time_constant_ > 0.0f ? expf(-dt / time_constant_) : 1.0f;
+  const float* a[3] = { wx, wy, wz };
+  float* v_out[3] = { vx, vy, vz };
+  float* p_out[3] = { px, py, pz };
+
+  // the recurrence is serial in time, so the three axes are run one after
+  // the other to keep each loop's state in registers
+  for (int k = 0; k < 3; k++)
+  {
+    float v = v_[k], p = p_[k];
+    const float* ak = a[k];
+    for (size_t i = 0; i < count; i++)
+    {
+      float v_new = clampAbs(v * leak + ak[i] * dt, max_velocity_);
+      p = p * leak + 0.5f * (v + v_new) * dt;
+      v = v_new;
+      if (v_out[k]) v_out[k][i] = v;
+      if (p_out[k]) p_out[k][i] = p;
+    }
+    v_[k] = v;
+    p_[k] = p;
+  }
+}
+
+void LinearAccelIntegrator::integrate(size_t count,
+    const float* wx, const float* wy, const float* wz, const float* dt,
+    float* vx, float* vy, float* vz,
+    float* px, float* py, float* pz)
+{
+  const float* a[3] = { wx, wy, wz };
+  float* v_out[3] = { vx, vy, vz };
+  float* p_out[3] = { px, py, pz };
+
+  // the leak factor changes with every step, so samples are the outer loop
+  // and each factor is computed once for the three axes
+  for (size_t i = 0; i < count; i++)
+  {
+    float leak = time_constant_ > 0.0f ? expf(-dt[i] / time_constant_) : 1.0f;
+    for (int k = 0; k < 3; k++)
+    {
+      float v_new = clampAbs(v_[k] * leak + a[k][i] * dt[i], max_velocity_);
+      p_[k] = p_[k] * leak + 0.5f * (v_[k] + v_new) * dt[i];
+      v_[k] = v_new;
+      if (v_out[k]) v_out[k][i] = v_[k];
+      if (p_out[k]) p_out[k][i] = p_[k];
+    }
+  }
+}
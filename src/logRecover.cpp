@@ -0,0 +1,75 @@
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/flight_log.h"
+
+using namespace std;
+
+// finds where a flight log cut short by a power loss really ends: the last
+// block whose CRC checks out, found by stepping back from the end of the
+// file so only the torn tail is read. --verify also checks every block
+// before it, --truncate cuts the torn tail off the file
+
+int main(int argc, char** argv)
+{
+	bool verify = false, truncate_tail = false;
+	for (int i = 2; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--verify")) verify = true;
+		else if (!strcmp(argv[i], "--truncate")) truncate_tail = true;
+		else argc = 0;
+	}
+	if (argc < 2)
+	{
+		printf("usage: %s <flight.log> [--verify] [--truncate]\n", argv[0]);
+		return 1;
+	}
+
+	struct stat st;
+	FlightLogReader log;
+	if (stat(argv[1], &st) != 0 || !log.open(argv[1]))
+	{
+		printf("could not read %s\n", argv[1]);
+		return 1;
+	}
+
+	printf("%zu records in %zu blocks", log.size(), log.blockCount());
+	if (log.blockCount() > 0) printf(", last block sequence %u", log.block(log.blockCount() - 1).sequence);
+	if (log.size() > 0) printf(", last sample at %.3f s", log.time(log.size() - 1));
+	printf("\n%zu bytes torn or unwritten at the end\n", log.tornBytes());
+
+	size_t bad = 0;
+	if (verify)
+	{
+		for (size_t k = 0; k < log.blockCount(); k++)
+		{
+			uint32_t expected = log.block(0).sequence + k;
+			if (!log.checkBlock(k))
+			{
+				printf("block %zu: bad CRC\n", k);
+				bad++;
+			}
+			else if (log.block(k).sequence != expected)
+			{
+				printf("block %zu: sequence %u, expected %u\n", k, log.block(k).sequence, expected);
+				bad++;
+			}
+		}
+		printf("%zu bad blocks\n", bad);
+	}
+
+	if (truncate_tail && log.tornBytes() > 0)
+	{
+		off_t end = st.st_size - log.tornBytes();
+		log.close();
+		if (truncate(argv[1], end) != 0)
+		{
+			printf("could not truncate %s\n", argv[1]);
+			return 1;
+		}
+		printf("truncated to %lld bytes\n", (long long)end);
+	}
+	return bad > 0 ? 2 : 0;
+}
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/flight_log.h"
+
+using namespace std;
+
+// copies the records of a time window out of a flight log into a new log
+// with the same header; the window is found through the log's time index,
+// so pulling a few seconds out of a multi-day capture reads only those
+// records
+
+int main(int argc, char** argv)
+{
+	if (argc != 5)
+	{
+		printf("usage: %s <flight.log> <from_s> <to_s> <out.log>\n"
+			"  times are seconds since the start of the log\n", argv[0]);
+		return 1;
+	}
+
+	FlightLogReader log;
+	if (!log.open(argv[1]))
+	{
+		printf("could not read %s\n", argv[1]);
+		return 1;
+	}
+	double from = atof(argv[2]), to = atof(argv[3]);
+	if (from < 0) from = 0;
+	if (to < from) to = from;
+
+	size_t begin, end;
+	log.range((uint64_t)(from * 1e9), (uint64_t)(to * 1e9), begin, end);
+
+	FlightLogWriter out;
+	if (!out.open(argv[4], log.header()))
+	{
+		printf("could not open %s\n", argv[4]);
+		return 1;
+	}
+	bool ok = true;
+	for (size_t i = begin; ok && i < end; i++)
+		ok = out.appendWaiting(log[i]);	// wait for the writer rather than drop records
+	if (!out.close() || !ok)
+	{
+		printf("error writing %s\n", argv[4]);
+		return 1;
+	}
+	printf("%zu records (%s index)\n", end - begin, log.hasIndex() ? "with" : "no");
+	return 0;
+}
@@ -0,0 +1,51 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../include/log_sink.h"
+
+bool writeAll(int fd, const void* data, size_t len)
+{
+  const char* p = (const char*)data;
+  while (len > 0)
+  {
+    ssize_t n = ::write(fd, p, len);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+FileSink::FileSink() :
+    fd_(-1)
+{
+}
+
+FileSink::~FileSink()
+{
+  close();
+}
+
+bool FileSink::open(const char* path)
+{
+  close();
+  fd_ = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  return fd_ >= 0;
+}
+
+bool FileSink::write(const void* data, size_t len)
+{
+  return fd_ >= 0 && writeAll(fd_, data, len);
+}
+
+bool FileSink::close()
+{
+  if (fd_ < 0) return true;
+  bool ok = ::close(fd_) == 0;
+  fd_ = -1;
+  return ok;
+}
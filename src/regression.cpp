@@ -0,0 +1,875 @@
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <time.h>
+#include <dirent.h>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../include/alloc_guard.h"
+#include "../include/attitude_resample.h"
+#include "../include/cpu_dispatch.h"
+#include "../include/dsp_kernels.h"
+#include "../include/float_format.h"
+#include "../include/imu_filter.h"
+#include "../include/imu_recording.h"
+#include "../include/test_helpers.h"
+#include "../include/tumble_sim.h"
+
+using namespace std;
+
+// replays every recording under data/, a set of synthetic trajectories and
+// a simulated CubeSat tumble (tumble_sim.h), all with known truth, through
+// each filter configuration, measures attitude error and compares it with a
+// stored baseline. With --timing it measures throughput as well, so that a
+// faster filter that is less accurate fails as surely as a slower one;
+// timings only mean something against a baseline from the same machine,
+// so they are opt-in and the committed baseline carries none. The well
+// known sensor states of test_helpers.h are checked against their expected
+// orientations as well, AttitudeResampler is checked against tf2 slerp on
+// the truth of every dataset that has one, the filter bank of
+// dsp_kernels.h against ImuFilter, and the vector code of
+// tf2/LinearMath/Simd.h against the scalar code it replaces.
+
+#define DEFAULT_DATA "data"
+#define DEFAULT_BASELINE "data/baseline/regression.csv"
+#define DEFAULT_DT 0.01 // 100Hz, the IMU.cpp sample rate
+#define RAD_TO_DEGREES 180/3.141592653589793238463
+#define ERR_TOLERANCE_DEG 0.01 // accuracy may worsen by this much plus ERR_TOLERANCE_REL
+#define ERR_TOLERANCE_REL 0.02
+#define TIME_TOLERANCE 0.30 // ns/sample may grow by this fraction
+#define TIME_BATCH_NS 2000000LL // each timed batch replays a dataset for at least this long
+#define TIME_BATCHES 9 // the fastest batch is the result
+#define KNOWN_STATE_STEPS 10000
+#define KNOWN_STATE_DT 0.1
+#define TUMBLE_SECONDS 600 // of the simulated CubeSat
+#define RESAMPLE_TOLERANCE_RAD 1e-8 // AttitudeResampler against tf2 slerp; its nlerp path may deviate 1e-9
+#define RESAMPLE_COARSE_STRIDE 10 // a track of every 10th truth sample takes the slerp path
+#define FLOAT_FORMAT_SAMPLES 1000000 // random bit patterns of each width through formatFloat/formatDouble
+#define SIMD_SAMPLES 100000 // random vectors and quaternions through the tf2 vector helpers
+#define BANK_LANES 7 // gains of the filter bank check; not a multiple of any vector width, so the tail runs too
+
+enum Update { UPDATE_IMU, UPDATE_MARG };
+
+struct Config
+{
+	const char* name;
+	Update update;
+	double gain;
+	double zeta;
+};
+
+static const Config configs[] =
+{
+	{ "imu_g0.1", UPDATE_IMU, 0.1, 0.0 },
+	{ "imu_g0.033", UPDATE_IMU, 0.033, 0.0 },
+	{ "marg_g0.1", UPDATE_MARG, 0.1, 0.0 },
+	{ "marg_g0.1_z0.01", UPDATE_MARG, 0.1, 0.01 }, // zeta only acts in the MARG update
+};
+
+struct Dataset
+{
+	string name;
+	ImuRecording rec;
+};
+
+// one dataset through one configuration
+struct Result
+{
+	string dataset, config;
+	size_t samples;
+	double rms_err, max_err, final_err; // degrees, -1 without truth
+	double q[4];                        // final attitude
+	double ns_per_sample;               // 0 if not timed
+	bool normalized;                    // every output was a unit quaternion
+};
+
+static long long nanoseconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// keeps the compiler from dropping a replay whose result is unused
+template <typename T>
+static inline void keep(const T& value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+// angle between two unit quaternions, in degrees
+static double quatAngle(double a0, double a1, double a2, double a3,
+	double b0, double b1, double b2, double b3)
+{
+	double dot = fabs(a0 * b0 + a1 * b1 + a2 * b2 + a3 * b3);
+	if (dot > 1.0) dot = 1.0;
+	return 2.0 * acos(dot) * RAD_TO_DEGREES;
+}
+
+// A synthetic trajectory: body rates as a function of time from an initial
+// attitude, sampled at DEFAULT_DT in the ENU frame with gravity and an
+// earth-like field, plus sensor noise and a constant gyro bias.
+struct Trajectory
+{
+	const char* name;
+	double seconds;
+	double roll, pitch, yaw;            // initial attitude, degrees
+	double rate[3];                     // constant body rate, rad/s
+	double wobble[3];                   // sinusoidal body rate amplitude, rad/s
+	double wobble_hz;
+	double gyro_noise, gyro_bias;       // rad/s
+	double accel_noise;                 // g
+};
+
+static const Trajectory trajectories[] =
+{
+	{ "static_tilt", 60, 20, -10, 30, { 0, 0, 0 }, { 0, 0, 0 }, 0, 0.002, 0, 0.005 },
+	{ "slow_tumble", 60, 0, 0, 0, { 0.1, 0.05, 0.2 }, { 0, 0, 0 }, 0, 0.002, 0, 0.005 },
+	{ "coning", 60, 5, 5, 0, { 0, 0, 0.1 }, { 0.3, 0.3, 0 }, 0.2, 0.002, 0, 0.005 },
+	{ "fast_spin", 30, 10, 0, 0, { 0.05, 0, 3.0 }, { 0.05, 0.05, 0 }, 0.5, 0.005, 0, 0.01 },
+	{ "gyro_bias", 120, 15, 15, 0, { 0, 0, 0.05 }, { 0, 0, 0 }, 0, 0.002, 0.005, 0.005 },
+};
+
+static void quatFromRpy(double roll, double pitch, double yaw, double q[4])
+{
+	tf2::Quaternion t;
+	t.setRPY(roll / RAD_TO_DEGREES, pitch / RAD_TO_DEGREES, yaw / RAD_TO_DEGREES);
+	q[0] = t.getW();
+	q[1] = t.getX();
+	q[2] = t.getY();
+	q[3] = t.getZ();
+}
+
+// v in the world frame to the body frame of the body to world rotation q
+static void toBody(const double q[4], const double v[3], double out[3])
+{
+	tf2::Quaternion r(q[1], q[2], q[3], q[0]);
+	tf2::Vector3 b = tf2::quatRotate(r.inverse(), tf2::Vector3(v[0], v[1], v[2]));
+	out[0] = b.x();
+	out[1] = b.y();
+	out[2] = b.z();
+}
+
+static void synthesize(const Trajectory& traj, uint64_t seed, ImuRecording& rec)
+{
+	static const double gravity[3] = { 0, 0, 1 };        // g, ENU
+	static const double field[3] = { 0, 22, -42 };       // uT, ENU
+	GaussianNoise noise(seed);
+	double q[4];
+	quatFromRpy(traj.roll, traj.pitch, traj.yaw, q);
+	size_t n = (size_t)(traj.seconds / DEFAULT_DT);
+	for (size_t i = 0; i < n; i++)
+	{
+		// the rate is constant over the step that ends at sample i, and the
+		// truth is that rotation applied exactly
+		double t = i * DEFAULT_DT, w[3];
+		for (int k = 0; k < 3; k++)
+			w[k] = traj.rate[k] + traj.wobble[k] * sin(2 * M_PI * traj.wobble_hz * t + k);
+		if (i > 0)
+		{
+			double norm = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+			tf2::Quaternion dq(0, 0, 0, 1);
+			if (norm > 0) dq.setRotation(tf2::Vector3(w[0] / norm, w[1] / norm, w[2] / norm), norm * DEFAULT_DT);
+			tf2::Quaternion next = tf2::Quaternion(q[1], q[2], q[3], q[0]) * dq;
+			next.normalize();
+			q[0] = next.getW();
+			q[1] = next.getX();
+			q[2] = next.getY();
+			q[3] = next.getZ();
+		}
+		double a[3], m[3];
+		toBody(q, gravity, a);
+		toBody(q, field, m);
+		rec.ax.push_back(a[0] + noise.gauss(traj.accel_noise));
+		rec.ay.push_back(a[1] + noise.gauss(traj.accel_noise));
+		rec.az.push_back(a[2] + noise.gauss(traj.accel_noise));
+		rec.gx.push_back(w[0] + traj.gyro_bias + noise.gauss(traj.gyro_noise));
+		rec.gy.push_back(w[1] + traj.gyro_bias + noise.gauss(traj.gyro_noise));
+		rec.gz.push_back(w[2] + traj.gyro_bias + noise.gauss(traj.gyro_noise));
+		rec.mx.push_back(m[0]);
+		rec.my.push_back(m[1]);
+		rec.mz.push_back(m[2]);
+		rec.q0.push_back(q[0]);
+		rec.q1.push_back(q[1]);
+		rec.q2.push_back(q[2]);
+		rec.q3.push_back(q[3]);
+	}
+}
+
+static void initFilter(ImuFilter& filter, const Config& config, const ImuRecording& rec)
+{
+	filter.setAlgorithmGain(config.gain);
+	filter.setDriftBiasGain(config.zeta);
+	filter.setWorldFrame(WorldFrame::ENU);
+	if (rec.hasTruth())
+		filter.setOrientation(rec.q0[0], rec.q1[0], rec.q2[0], rec.q3[0]);
+}
+
+static inline void update(ImuFilter& filter, const Config& config, const ImuRecording& rec, size_t i)
+{
+	if (config.update == UPDATE_MARG)
+		filter.madgwickAHRSupdate(rec.gx[i], rec.gy[i], rec.gz[i], rec.ax[i], rec.ay[i], rec.az[i],
+			rec.mx[i], rec.my[i], rec.mz[i], rec.dt(i, DEFAULT_DT));
+	else
+		filter.madgwickAHRSupdateIMU(rec.gx[i], rec.gy[i], rec.gz[i], rec.ax[i], rec.ay[i], rec.az[i],
+			rec.dt(i, DEFAULT_DT));
+}
+
+static void run(const Dataset& data, const Config& config, bool timing, Result& r)
+{
+	const ImuRecording& rec = data.rec;
+	ImuFilter filter;
+	initFilter(filter, config, rec);
+
+	double sum_sq = 0, max_err = 0, err = -1;
+	r.normalized = true;
+	for (size_t i = 0; i < rec.size(); i++)
+	{
+		// the filter must not allocate once it has seen a sample
+		if (i == 1) ALLOC_GUARD_ARM();
+		update(filter, config, rec, i);
+		double q0, q1, q2, q3;
+		filter.getOrientation(q0, q1, q2, q3);
+		if (!is_normalized(q0, q1, q2, q3)) r.normalized = false;
+		if (!rec.hasTruth()) continue;
+		err = quatAngle(q0, q1, q2, q3, rec.q0[i], rec.q1[i], rec.q2[i], rec.q3[i]);
+		if (!std::isfinite(err)) err = 180.0;
+		sum_sq += err * err;
+		if (err > max_err) max_err = err;
+	}
+	if (rec.size() > 1) ALLOC_GUARD_DISARM();
+	r.dataset = data.name;
+	r.config = config.name;
+	r.samples = rec.size();
+	r.rms_err = rec.hasTruth() && rec.size() ? sqrt(sum_sq / rec.size()) : -1;
+	r.max_err = rec.hasTruth() ? max_err : -1;
+	r.final_err = err;
+	filter.getOrientation(r.q[0], r.q[1], r.q[2], r.q[3]);
+
+	// throughput: whole replays in batches of at least TIME_BATCH_NS, fastest batch
+	r.ns_per_sample = 0;
+	if (!timing || rec.size() == 0) return;
+	size_t replays = 1;
+	for (int b = 0; b < TIME_BATCHES; b++)
+	{
+		long long start = nanoseconds();
+		for (size_t k = 0; k < replays; k++)
+		{
+			ImuFilter replay;
+			initFilter(replay, config, rec);
+			for (size_t i = 0; i < rec.size(); i++) update(replay, config, rec, i);
+			keep(replay);
+		}
+		long long elapsed = nanoseconds() - start;
+		if (elapsed < TIME_BATCH_NS)
+		{
+			// too short to time; size the batch and start over
+			replays = max(replays * 2, (size_t)(replays * TIME_BATCH_NS / (elapsed + 1)));
+			b = -1;
+			continue;
+		}
+		double ns = (double)elapsed / (replays * rec.size());
+		if (r.ns_per_sample == 0 || ns < r.ns_per_sample) r.ns_per_sample = ns;
+	}
+}
+
+// A sensor state held still, from test_helpers.h, and the orientation the
+// filter must settle to in the given frame.
+struct KnownState
+{
+	const char* name;
+	WorldFrame::WorldFrame frame;
+	double am[6];
+	double q[4];
+};
+
+static const KnownState known_states[] =
+{
+	{ "east_north_up/ENU", WorldFrame::ENU, { AM_EAST_NORTH_UP }, { QUAT_IDENTITY } },
+	{ "south_up_west/ENU", WorldFrame::ENU, { AM_SOUTH_UP_WEST }, { QUAT_XMYMZ_120 } },
+	{ "west_north_down_rsd/ENU", WorldFrame::ENU, { AM_WEST_NORTH_DOWN_RSD }, { QUAT_WEST_NORTH_DOWN_RSD_ENU } },
+	{ "ne_nw_up_rsd/ENU", WorldFrame::ENU, { AM_NE_NW_UP_RSD }, { QUAT_NE_NW_UP_RSD_ENU } },
+	{ "north_east_down/NED", WorldFrame::NED, { AM_NORTH_EAST_DOWN }, { QUAT_IDENTITY } },
+	{ "west_north_down/NED", WorldFrame::NED, { AM_WEST_NORTH_DOWN }, { QUAT_MZ_90 } },
+	{ "west_north_down_rsd/NED", WorldFrame::NED, { AM_WEST_NORTH_DOWN_RSD }, { QUAT_WEST_NORTH_DOWN_RSD_NED } },
+	{ "ne_nw_up_rsd/NED", WorldFrame::NED, { AM_NE_NW_UP_RSD }, { QUAT_NE_NW_UP_RSD_NED } },
+	{ "north_west_up/NWU", WorldFrame::NWU, { AM_NORTH_WEST_UP }, { QUAT_IDENTITY } },
+	{ "west_north_down_rsd/NWU", WorldFrame::NWU, { AM_WEST_NORTH_DOWN_RSD }, { QUAT_WEST_NORTH_DOWN_RSD_NWU } },
+	{ "ne_nw_up_rsd/NWU", WorldFrame::NWU, { AM_NE_NW_UP_RSD }, { QUAT_NE_NW_UP_RSD_NWU } },
+};
+
+// Both updates from the identity: with the field the attitude must match,
+// from the accelerometer alone it must match but for the heading.
+static bool checkKnownState(const KnownState& s, bool marg)
+{
+	ImuFilter filter;
+	filter.setAlgorithmGain(0.1);
+	filter.setDriftBiasGain(0.0);
+	filter.setWorldFrame(s.frame);
+	const double* am = s.am;
+	for (int i = 0; i < KNOWN_STATE_STEPS; i++)
+	{
+		if (marg)
+			filter.madgwickAHRSupdate(0, 0, 0, am[0], am[1], am[2], am[3], am[4], am[5], KNOWN_STATE_DT);
+		else
+			filter.madgwickAHRSupdateIMU(0, 0, 0, am[0], am[1], am[2], KNOWN_STATE_DT);
+	}
+	double q0, q1, q2, q3;
+	filter.getOrientation(q0, q1, q2, q3);
+	if (!is_normalized(q0, q1, q2, q3)) return false;
+	if (marg) return quat_equal(q0, q1, q2, q3, s.q[0], s.q[1], s.q[2], s.q[3]);
+	return quat_eq_ex_z(q0, q1, q2, q3, s.q[0], s.q[1], s.q[2], s.q[3]);
+}
+
+// Resamples every stride-th truth sample of rec, in two consecutive chunks,
+// onto a grid that is offset from the samples and runs past both ends, and
+// returns the largest difference in radians from tf2::Quaternion::slerp
+// between the bracketing samples.
+static double checkResample(const ImuRecording& rec, size_t stride)
+{
+	vector<double> t, q[4];
+	for (size_t i = 0; i < rec.size(); i += stride)
+	{
+		// the truth is stored in float; slerp keeps its inputs' norm, nlerp
+		// does not
+		double w = rec.q0[i], x = rec.q1[i], y = rec.q2[i], z = rec.q3[i];
+		double recipNorm = 1 / sqrt(w * w + x * x + y * y + z * z);
+		t.push_back(rec.hasTime() ? rec.t[i] : i * DEFAULT_DT);
+		q[0].push_back(w * recipNorm);
+		q[1].push_back(x * recipNorm);
+		q[2].push_back(y * recipNorm);
+		q[3].push_back(z * recipNorm);
+	}
+	AttitudeTrack track = { t.size(), &t[0], &q[0][0], &q[1][0], &q[2][0], &q[3][0] };
+
+	size_t n = 3 * t.size();
+	double first = t.front() - 1, step = (t.back() + 1 - first) / n;
+	vector<double> t_out(n), out[4];
+	for (size_t k = 0; k < n; k++) t_out[k] = first + k * step;
+	for (int c = 0; c < 4; c++) out[c].resize(n);
+	AttitudeResampler resampler;
+	size_t half = n / 2;
+	resampler.resample(track, half, &t_out[0], &out[0][0], &out[1][0], &out[2][0], &out[3][0]);
+	resampler.resample(track, n - half, &t_out[half], &out[0][half], &out[1][half], &out[2][half], &out[3][half]);
+
+	double max_err = 0;
+	for (size_t k = 0; k < n; k++)
+	{
+		size_t b = upper_bound(t.begin(), t.end(), t_out[k]) - t.begin();
+		size_t a = b > 0 ? b - 1 : 0;
+		if (b >= t.size()) b = t.size() - 1;
+		double u = t[b] > t[a] ? (t_out[k] - t[a]) / (t[b] - t[a]) : 0;
+		tf2::Quaternion qa(q[1][a], q[2][a], q[3][a], q[0][a]), qb(q[1][b], q[2][b], q[3][b], q[0][b]);
+		tf2::Quaternion ref = qa.slerp(qb, u);
+		double r[4] = { ref.w(), ref.x(), ref.y(), ref.z() }, d_minus = 0, d_plus = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			d_minus += (out[c][k] - r[c]) * (out[c][k] - r[c]);
+			d_plus += (out[c][k] + r[c]) * (out[c][k] + r[c]);
+		}
+		// for small angles the rotation angle is twice the chord
+		double err = 2 * sqrt(min(d_minus, d_plus));
+		if (!(err <= max_err)) max_err = err;
+	}
+	return max_err;
+}
+
+static uint64_t xorshift(uint64_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+// Formats v and reads it back with strtof; nan must come back as nan,
+// everything else bit for bit.
+static bool roundTrip(float v)
+{
+	char buf[FLOAT_FORMAT_MAX + 1];
+	char* end = formatFloat(buf, v);
+	if (end - buf > FLOAT_FORMAT_MAX) return false;
+	*end = 0;
+	char* parsed;
+	float back = strtof(buf, &parsed);
+	if (parsed != end) return false;
+	if (v != v) return back != back;
+	return memcmp(&v, &back, sizeof(v)) == 0;
+}
+
+static bool roundTrip(double v)
+{
+	char buf[FLOAT_FORMAT_MAX + 1];
+	char* end = formatDouble(buf, v);
+	if (end - buf > FLOAT_FORMAT_MAX) return false;
+	*end = 0;
+	char* parsed;
+	double back = strtod(buf, &parsed);
+	if (parsed != end) return false;
+	if (v != v) return back != back;
+	return memcmp(&v, &back, sizeof(v)) == 0;
+}
+
+static const double bank_gains[BANK_LANES] = { 0.005, 0.01, 0.033, 0.1, 0.2, 0.5, 1.0 };
+
+// Replays rec through filterBankUpdateIMU at the current cpuIsa() and
+// through one ImuFilter per lane, which the gain sweep relies on being the
+// same filter. Returns the number of samples after which any lane's
+// orientation differs from its ImuFilter's.
+static size_t checkFilterBank(const ImuRecording& rec, WorldFrame::WorldFrame frame)
+{
+	double q0[BANK_LANES], q1[BANK_LANES], q2[BANK_LANES], q3[BANK_LANES];
+	ImuFilter filters[BANK_LANES];
+	for (int k = 0; k < BANK_LANES; k++)
+	{
+		q0[k] = 1;
+		q1[k] = q2[k] = q3[k] = 0;
+		if (rec.hasTruth())
+		{
+			q0[k] = rec.q0[0];
+			q1[k] = rec.q1[0];
+			q2[k] = rec.q2[0];
+			q3[k] = rec.q3[0];
+		}
+		filters[k].setAlgorithmGain(bank_gains[k]);
+		filters[k].setDriftBiasGain(0.0);
+		filters[k].setWorldFrame(frame);
+		filters[k].setOrientation(q0[k], q1[k], q2[k], q3[k]);
+	}
+
+	size_t bad = 0;
+	for (size_t i = 0; i < rec.size(); i++)
+	{
+		float dt = rec.dt(i, DEFAULT_DT);
+		filterBankUpdateIMU(BANK_LANES, q0, q1, q2, q3, bank_gains, frame,
+			rec.gx[i], rec.gy[i], rec.gz[i], rec.ax[i], rec.ay[i], rec.az[i], dt);
+		bool same = true;
+		for (int k = 0; k < BANK_LANES; k++)
+		{
+			filters[k].madgwickAHRSupdateIMU(rec.gx[i], rec.gy[i], rec.gz[i], rec.ax[i], rec.ay[i], rec.az[i], dt);
+			// normalised like getOrientation(), so equal states compare equal
+			double f[4], b[4] = { q0[k], q1[k], q2[k], q3[k] };
+			filters[k].getOrientation(f[0], f[1], f[2], f[3]);
+			double recipNorm = 1 / sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2] + b[3] * b[3]);
+			for (int c = 0; c < 4; c++) b[c] *= recipNorm;
+			if (memcmp(f, b, sizeof(f)) != 0) same = false;
+		}
+		if (!same) bad++;
+	}
+	return bad;
+}
+
+// The edge cases and FLOAT_FORMAT_SAMPLES random bit patterns of each
+// width through format and parse. Returns how many did not round-trip.
+static size_t checkFloatFormat()
+{
+	size_t bad = 0;
+	const double special[] = { 0.0, -0.0, 1.0, -1.0, 0.1, 1e-5, 1e15, 1e16, 123456789.0,
+		FLT_MIN, FLT_MAX, FLT_EPSILON, DBL_MIN, DBL_MAX, DBL_EPSILON, 4.9406564584124654e-324,
+		1.4e-45, INFINITY, -INFINITY, NAN };
+	for (size_t i = 0; i < sizeof(special) / sizeof(special[0]); i++)
+	{
+		if (!roundTrip((float)special[i])) bad++;
+		if (!roundTrip(special[i])) bad++;
+	}
+
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	for (size_t i = 0; i < FLOAT_FORMAT_SAMPLES; i++)
+	{
+		uint64_t bits = xorshift(state);
+		uint32_t bits32 = (uint32_t)(bits >> 32);
+		float f;
+		double d;
+		memcpy(&f, &bits32, sizeof(f));
+		memcpy(&d, &bits, sizeof(d));
+		if (!roundTrip(f)) bad++;
+		if (!roundTrip(d)) bad++;
+	}
+	return bad;
+}
+
+// the vector unit tf2/LinearMath/Simd.h compiled Vector3 and Quaternion for
+#if defined(TF2_USE_AVX2)
+#define TF2_SIMD_NAME "tf2_avx2"
+#elif defined(TF2_USE_SSE2)
+#define TF2_SIMD_NAME "tf2_sse2"
+#elif defined(TF2_USE_NEON)
+#define TF2_SIMD_NAME "tf2_neon"
+#else
+#define TF2_SIMD_NAME "tf2_scalar"
+#endif
+
+// The scalar code the helpers of Simd.h replace, which they have to match
+// bit for bit, so it must not be contracted into FMAs either.
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+static void scalarCross3(const double* a, const double* b, double* r)
+{
+	r[0] = a[1] * b[2] - a[2] * b[1];
+	r[1] = a[2] * b[0] - a[0] * b[2];
+	r[2] = a[0] * b[1] - a[1] * b[0];
+	r[3] = 0;
+}
+
+static void scalarQuatMul(const double* a, const double* b, double* r)
+{
+	r[0] = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+	r[1] = a[3] * b[1] + a[1] * b[3] + a[2] * b[0] - a[0] * b[2];
+	r[2] = a[3] * b[2] + a[2] * b[3] + a[0] * b[1] - a[1] * b[0];
+	r[3] = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+}
+
+static void scalarQuatRotate(const double* q, const double* v, double* r)
+{
+	double uxv[4];
+	scalarCross3(q, v, uxv);
+	double sv = q[3] * q[3] - (q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+	double su = 2 * (q[0] * v[0] + q[1] * v[1] + q[2] * v[2]);
+	double sc = 2 * q[3];
+	for (int i = 0; i < 3; i++) r[i] = sv * v[i] + su * q[i] + sc * uxv[i];
+	r[3] = 0;
+}
+
+#pragma GCC pop_options
+
+static bool sameBits(const double* a, const double* b, int n)
+{
+	return memcmp(a, b, n * sizeof(double)) == 0;
+}
+
+// SIMD_SAMPLES random inputs through every helper of Simd.h that Vector3
+// and Quaternion use, or, with avx2, through the AVX2 helpers. Returns the
+// number of results that differ from the scalar code.
+static size_t checkSimd(bool avx2)
+{
+	size_t bad = 0;
+	uint64_t state = 0x2545F4914F6CDD1Dull;
+	for (size_t i = 0; i < SIMD_SAMPLES; i++)
+	{
+		double a[4], b[4], r[4], ref[4];
+		for (int k = 0; k < 4; k++)
+		{
+			a[k] = (double)(int64_t)xorshift(state) / 4611686018427387904.0;
+			b[k] = (double)(int64_t)xorshift(state) / 4611686018427387904.0;
+		}
+		if (avx2)
+		{
+#if defined(TF2_HAVE_AVX2)
+			tf2SimdCross3Avx2(a, b, r);
+			scalarCross3(a, b, ref);
+			if (!sameBits(r, ref, 4)) bad++;
+			tf2SimdQuatMulAvx2(a, b, r);
+			scalarQuatMul(a, b, ref);
+			if (!sameBits(r, ref, 4)) bad++;
+#endif
+			continue;
+		}
+
+		double dot3 = tf2SimdDot3(a, b), dot4 = tf2SimdDot4(a, b);
+		double ref3 = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		double ref4 = ref3 + a[3] * b[3];
+		if (!sameBits(&dot3, &ref3, 1)) bad++;
+		if (!sameBits(&dot4, &ref4, 1)) bad++;
+
+		tf2SimdCross3(a, b, r);
+		scalarCross3(a, b, ref);
+		if (!sameBits(r, ref, 4)) bad++;
+
+		memcpy(r, a, sizeof(r));
+		tf2SimdScale3(r, b[0]);
+		for (int k = 0; k < 3; k++) ref[k] = a[k] * b[0];
+		ref[3] = a[3];
+		if (!sameBits(r, ref, 4)) bad++;
+
+		tf2SimdQuatMul(a, b, r);
+		scalarQuatMul(a, b, ref);
+		if (!sameBits(r, ref, 4)) bad++;
+		memcpy(r, a, sizeof(r));
+		tf2SimdQuatMul(r, b, r);            // in place, as operator*= does
+		if (!sameBits(r, ref, 4)) bad++;
+
+		tf2SimdQuatRotate(a, b, r);
+		scalarQuatRotate(a, b, ref);
+		if (!sameBits(r, ref, 4)) bad++;
+	}
+	return bad;
+}
+
+static bool endsWith(const string& s, const char* suffix)
+{
+	size_t n = strlen(suffix);
+	return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// every .csv and .log file directly in dir, in name order
+static bool loadDataDir(const char* dir, float gyro_scale, vector<Dataset>& datasets)
+{
+	DIR* d = opendir(dir);
+	if (!d) return false;
+	vector<string> names;
+	while (struct dirent* e = readdir(d))
+	{
+		string name = e->d_name;
+		if (endsWith(name, ".csv") || endsWith(name, ".log")) names.push_back(name);
+	}
+	closedir(d);
+	sort(names.begin(), names.end());
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		Dataset data;
+		data.name = names[i];
+		string path = string(dir) + "/" + names[i];
+		if (!loadImuRecording(path.c_str(), data.rec, gyro_scale))
+		{
+			fprintf(stderr, "could not read %s, skipped\n", path.c_str());
+			continue;
+		}
+		datasets.push_back(data);
+	}
+	return true;
+}
+
+static bool loadBaseline(const char* path, vector<Result>& baseline)
+{
+	FILE* in = fopen(path, "r");
+	if (!in) return false;
+	char line[1024];
+	while (fgets(line, sizeof(line), in))
+	{
+		char dataset[256], config[256];
+		Result r;
+		unsigned long samples;
+		if (sscanf(line, "%255[^,],%255[^,],%lu,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf",
+			dataset, config, &samples, &r.rms_err, &r.max_err, &r.final_err,
+			&r.q[0], &r.q[1], &r.q[2], &r.q[3], &r.ns_per_sample) != 11)
+			continue; // the header
+		r.dataset = dataset;
+		r.config = config;
+		r.samples = samples;
+		r.normalized = true;
+		baseline.push_back(r);
+	}
+	fclose(in);
+	return true;
+}
+
+static bool saveBaseline(const char* path, const vector<Result>& results)
+{
+	FILE* out = fopen(path, "w");
+	if (!out) return false;
+	fprintf(out, "dataset,config,samples,rms_err_deg,max_err_deg,final_err_deg,q0,q1,q2,q3,ns_per_sample\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		fprintf(out, "%s,%s,%zu,%.6f,%.6f,%.6f,%.9f,%.9f,%.9f,%.9f,%.2f\n",
+			r.dataset.c_str(), r.config.c_str(), r.samples, r.rms_err, r.max_err, r.final_err,
+			r.q[0], r.q[1], r.q[2], r.q[3], r.ns_per_sample);
+	}
+	return fclose(out) == 0;
+}
+
+static bool worse(double err, double base)
+{
+	return base >= 0 && err > base * (1 + ERR_TOLERANCE_REL) + ERR_TOLERANCE_DEG;
+}
+
+// the problems of r against its baseline entry, empty if none
+static string compare(const Result& r, const Result* base, double time_tolerance)
+{
+	string problems;
+	if (!r.normalized) problems += " not-normalized";
+	if (!base) return problems;
+	if (r.samples != base->samples) return problems + " samples-changed";
+
+	bool less_accurate = worse(r.rms_err, base->rms_err) || worse(r.max_err, base->max_err);
+	if (less_accurate) problems += " accuracy";
+	if (!quat_equal(r.q[0], r.q[1], r.q[2], r.q[3], base->q[0], base->q[1], base->q[2], base->q[3]))
+		problems += " final-attitude";
+	if (time_tolerance >= 0 && base->ns_per_sample > 0 && r.ns_per_sample > 0)
+	{
+		if (r.ns_per_sample > base->ns_per_sample * (1 + time_tolerance)) problems += " throughput";
+		else if (less_accurate && r.ns_per_sample < base->ns_per_sample) problems += " (faster but less accurate)";
+	}
+	return problems;
+}
+
+static void usage(const char* name)
+{
+	printf("usage: %s [options]\n"
+		"  --data dir              recordings to replay (default %s)\n"
+		"  --baseline file         (default %s)\n"
+		"  --update                write the results as the new baseline\n"
+		"  --timing                measure ns/sample too, against a baseline from this machine\n"
+		"  --time-tolerance f      allowed ns/sample growth (default %g)\n"
+		"  --no-timing             compare accuracy only (the default)\n"
+		"  --gyro-scale k          gyro column to rad/s (default deg/s)\n",
+		name, DEFAULT_DATA, DEFAULT_BASELINE, TIME_TOLERANCE);
+}
+
+int main(int argc, char** argv)
+{
+	const char* data_dir = DEFAULT_DATA;
+	const char* baseline_path = DEFAULT_BASELINE;
+	bool update = false, timing = false;
+	double time_tolerance = TIME_TOLERANCE;
+	float gyro_scale = 3.14159265358979f / 180.0f;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* opt = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : 0;
+		if (!strcmp(opt, "--update")) update = true;
+		else if (!strcmp(opt, "--timing")) timing = true;
+		else if (!strcmp(opt, "--no-timing")) timing = false;
+		else if (val && !strcmp(opt, "--data")) data_dir = argv[++i];
+		else if (val && !strcmp(opt, "--baseline")) baseline_path = argv[++i];
+		else if (val && !strcmp(opt, "--time-tolerance")) time_tolerance = atof(argv[++i]);
+		else if (val && !strcmp(opt, "--gyro-scale")) gyro_scale = atof(argv[++i]);
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!timing) time_tolerance = -1;
+
+	vector<Dataset> datasets;
+	if (!loadDataDir(data_dir, gyro_scale, datasets))
+	{
+		printf("could not read %s\n", data_dir);
+		return 1;
+	}
+	for (size_t t = 0; t < sizeof(trajectories) / sizeof(trajectories[0]); t++)
+	{
+		Dataset data;
+		data.name = string("synthetic/") + trajectories[t].name;
+		synthesize(trajectories[t], t + 1, data.rec);
+		datasets.push_back(data);
+	}
+	{
+		// a torque-free tumble with the ICM-20602 error model
+		TumbleConfig config;
+		initTumbleConfig(config);
+		TumbleSim sim(config);
+		Dataset data;
+		data.name = "synthetic/cubesat_tumble";
+		sim.generate((size_t)(TUMBLE_SECONDS * config.sample_hz), data.rec);
+		datasets.push_back(data);
+	}
+
+	vector<Result> baseline;
+	bool have_baseline = !update && loadBaseline(baseline_path, baseline);
+	if (!update && !have_baseline)
+		printf("no baseline at %s; run with --update to create it\n", baseline_path);
+
+	int failures = 0;
+	printf("%-28s %-16s %10s %10s %10s %9s  %s\n", "dataset", "config", "rms_deg", "max_deg", "final_deg", "ns/sample", "result");
+	vector<Result> results;
+	for (size_t d = 0; d < datasets.size(); d++)
+		for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+		{
+			if (configs[c].update == UPDATE_MARG && !datasets[d].rec.hasMag()) continue;
+			Result r;
+			run(datasets[d], configs[c], timing, r);
+			results.push_back(r);
+
+			const Result* base = 0;
+			for (size_t b = 0; b < baseline.size(); b++)
+				if (baseline[b].dataset == r.dataset && baseline[b].config == r.config) base = &baseline[b];
+			string problems = compare(r, base, time_tolerance);
+			if (!problems.empty()) failures++;
+			printf("%-28s %-16s %10.4f %10.4f %10.4f %9.1f  %s\n", r.dataset.c_str(), r.config.c_str(),
+				r.rms_err, r.max_err, r.final_err, r.ns_per_sample,
+				!problems.empty() ? ("FAIL" + problems).c_str() : (base || !have_baseline ? "ok" : "new"));
+		}
+	for (size_t b = 0; b < baseline.size(); b++)
+	{
+		bool found = false;
+		for (size_t i = 0; i < results.size() && !found; i++)
+			found = results[i].dataset == baseline[b].dataset && results[i].config == baseline[b].config;
+		if (!found)
+		{
+			printf("%-28s %-16s missing from this run\n", baseline[b].dataset.c_str(), baseline[b].config.c_str());
+			failures++;
+		}
+	}
+
+	for (size_t s = 0; s < sizeof(known_states) / sizeof(known_states[0]); s++)
+		for (int marg = 1; marg >= 0; marg--)
+		{
+			bool ok = checkKnownState(known_states[s], marg);
+			if (!ok) failures++;
+			printf("%-28s %-16s %s\n", known_states[s].name, marg ? "marg_known" : "imu_known", ok ? "ok" : "FAIL");
+		}
+
+	for (size_t d = 0; d < datasets.size(); d++)
+	{
+		if (!datasets[d].rec.hasTruth()) continue;
+		for (size_t stride = 1; stride <= RESAMPLE_COARSE_STRIDE; stride *= RESAMPLE_COARSE_STRIDE)
+		{
+			double err = checkResample(datasets[d].rec, stride);
+			bool ok = err <= RESAMPLE_TOLERANCE_RAD;
+			if (!ok) failures++;
+			printf("%-28s %-16s %10.3g rad  %s\n", datasets[d].name.c_str(),
+				stride == 1 ? "resample" : "resample_coarse", err, ok ? "ok" : "FAIL");
+		}
+	}
+
+	// the bank at every level this machine can run, in a frame with each
+	// sign of the gravity reference; compared exactly where ImuFilter is
+	// built without multiply-add contraction, as the bank is
+	CpuIsa selected_isa = cpuIsa();
+	for (int isa = 0; isa < ISA_COUNT; isa++)
+	{
+		if (!setCpuIsa((CpuIsa)isa)) continue;
+		size_t bad = 0;
+		for (size_t d = 0; d < datasets.size(); d++)
+		{
+			bad += checkFilterBank(datasets[d].rec, WorldFrame::ENU);
+			bad += checkFilterBank(datasets[d].rec, WorldFrame::NED);
+		}
+#if defined(__x86_64__) || defined(__i386__)
+		if (bad) failures++;
+		const char* result = bad ? "FAIL" : "ok";
+#else
+		const char* result = "not compared";
+#endif
+		printf("%-28s %-16s %10zu bad  %s\n", "filter_bank", (string("bank_") + cpuIsaName((CpuIsa)isa)).c_str(),
+			bad, result);
+	}
+	setCpuIsa(selected_isa);
+
+	size_t bad = checkFloatFormat();
+	if (bad) failures++;
+	printf("%-28s %-16s %10zu bad  %s\n", "float_format", "round_trip", bad, bad ? "FAIL" : "ok");
+
+	// the AVX2 helpers are compiled into every x86 build; they are checked
+	// wherever the CPU can run them
+	for (int avx2 = 0; avx2 <= 1; avx2++)
+	{
+#if defined(TF2_HAVE_AVX2)
+		if (avx2 && !cpuSupports(ISA_AVX2)) continue;
+#else
+		if (avx2) continue;
+#endif
+		bad = checkSimd(avx2);
+		if (bad) failures++;
+		printf("%-28s %-16s %10zu bad  %s\n", avx2 ? "tf2_avx2_helpers" : TF2_SIMD_NAME, "vs_scalar", bad, bad ? "FAIL" : "ok");
+	}
+
+	if (update)
+	{
+		if (!saveBaseline(baseline_path, results))
+		{
+			printf("could not write %s\n", baseline_path);
+			return 1;
+		}
+		printf("baseline written to %s\n", baseline_path);
+	}
+	printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
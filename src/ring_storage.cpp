@@ -0,0 +1,182 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/flight_log.h"
+#include "../include/ring_storage.h"
+
+// Reserves the blocks of a whole segment without changing the file size,
+// so readers still see only what was written. Not every filesystem
+// supports it; the ring then works without the preallocation.
+static void preallocate(int fd, size_t bytes)
+{
+#ifdef FALLOC_FL_KEEP_SIZE
+  fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, bytes);
+#else
+  (void)fd;
+  (void)bytes;
+#endif
+}
+
+RingStorage::RingStorage() :
+    segment_bytes_(0), next_sequence_(0), sequence_(0), current_(0), fd_(-1), refusing_(false),
+    refused_(0), rejected_pins_(0), pin_request_(0)
+{
+}
+
+RingStorage::~RingStorage()
+{
+  close();
+}
+
+bool RingStorage::open(const char* dir, unsigned segments, size_t segment_bytes)
+{
+  close();
+  if (segments == 0 || (mkdir(dir, 0755) != 0 && errno != EEXIST)) return false;
+
+  paths_.clear();
+  pinned_.assign(segments, false);
+  sequences_.assign(segments, -1);
+  segment_bytes_ = segment_bytes;
+  next_sequence_ = 0;
+  refusing_ = false;
+  refused_ = 0;
+  rejected_pins_.store(0);
+  pin_request_.store(0);
+
+  // the segment written last has the highest sequence number
+  bool any = false;
+  unsigned newest = segments - 1;
+  for (unsigned i = 0; i < segments; i++)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "/seg_%03u.log", i);
+    paths_.push_back(std::string(dir) + name);
+    pinned_[i] = access((paths_[i] + ".pin").c_str(), F_OK) == 0;
+
+    int fd = ::open(paths_[i].c_str(), O_RDONLY);
+    if (fd < 0) continue;
+    FlightLogHeader header;
+    if (pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+        memcmp(header.magic, FLIGHT_LOG_MAGIC, 4) == 0)
+    {
+      sequences_[i] = header.segment;
+      if (!any || header.segment >= next_sequence_)
+      {
+        any = true;
+        newest = i;
+        next_sequence_ = header.segment + 1;
+      }
+    }
+    ::close(fd);
+  }
+
+  // the first write starts the segment after the newest
+  current_ = newest;
+  sequence_ = next_sequence_ - 1;
+  return true;
+}
+
+bool RingStorage::startSegment(unsigned segment)
+{
+  // O_TRUNC is avoided on purpose: the truncate below releases the old
+  // blocks and the preallocation takes them back in one step
+  int fd = ::open(paths_[segment].c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd < 0) return false;
+  if (ftruncate(fd, 0) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  preallocate(fd, segment_bytes_);
+  fd_ = fd;
+  current_ = segment;
+  sequences_[segment] = sequence_;
+  return true;
+}
+
+bool RingStorage::nextSegment()
+{
+  applyPin();
+  if (fd_ >= 0) ::close(fd_);
+  fd_ = -1;
+  sequence_++;
+
+  // the oldest segment that is not pinned; the current one last
+  std::lock_guard<std::mutex> guard(lock_);
+  unsigned n = (unsigned)paths_.size();
+  for (unsigned k = 1; k <= n; k++)
+  {
+    unsigned segment = (current_ + k) % n;
+    if (!pinned_[segment])
+    {
+      refusing_ = false;
+      return startSegment(segment);
+    }
+  }
+  // not a write error: this segment is dropped and the next change tries
+  // again
+  refusing_ = true;
+  refused_++;
+  return true;
+}
+
+// Called on the writer thread. A request for a later segment stays
+// pending; one for a segment already started pins it while it is still in
+// the ring, otherwise it is rejected.
+void RingStorage::applyPin()
+{
+  uint64_t request = pin_request_.load(std::memory_order_relaxed);
+  if (request == 0) return;
+  uint32_t sequence = (uint32_t)(request - 1);
+  if ((int32_t)(sequence - sequence_) > 0 || (sequence == sequence_ && fd_ < 0 && !refusing_)) return;
+  pin_request_.compare_exchange_strong(request, 0, std::memory_order_relaxed);
+
+  unsigned n = (unsigned)paths_.size(), segment = n;
+  for (unsigned i = 0; i < n; i++)
+    if (sequences_[i] == (int64_t)sequence) segment = i;
+  if (segment == n || (sequence == sequence_ && fd_ < 0))
+  {
+    rejected_pins_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  if (pinned_[segment]) return;
+  int fd = ::open((paths_[segment] + ".pin").c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd >= 0) ::close(fd);
+  pinned_[segment] = true;
+}
+
+bool RingStorage::unpin(unsigned segment)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  if (segment >= paths_.size()) return false;
+  if (unlink((paths_[segment] + ".pin").c_str()) != 0 && errno != ENOENT) return false;
+  pinned_[segment] = false;
+  return true;
+}
+
+bool RingStorage::isPinned(unsigned segment)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  return segment < pinned_.size() && pinned_[segment];
+}
+
+bool RingStorage::write(const void* data, size_t len)
+{
+  applyPin();
+  if (refusing_) return true;       // the dropped segment, see nextSegment()
+  return fd_ >= 0 && writeAll(fd_, data, len);
+}
+
+bool RingStorage::close()
+{
+  bool ok = true;
+  if (fd_ >= 0) ok = ::close(fd_) == 0;
+  fd_ = -1;
+  refusing_ = false;
+  return ok;
+}
@@ -0,0 +1,146 @@
+#include <alloca.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "../include/rt_profile.h"
+
+#define RT_RUNTIME_PATH "/proc/sys/kernel/sched_rt_runtime_us"
+
+static void printLimit(FILE* report, const char* name, int resource, unsigned long long unit, const char* suffix)
+{
+  struct rlimit limit;
+  if (getrlimit(resource, &limit) != 0) return;
+  if (limit.rlim_cur == RLIM_INFINITY)
+    fprintf(report, "rt: %s unlimited\n", name);
+  else
+    fprintf(report, "rt: %s %llu%s\n", name, (unsigned long long)limit.rlim_cur / unit, suffix);
+}
+
+void rtReportLimits(FILE* report)
+{
+  printLimit(report, "RLIMIT_RTPRIO", RLIMIT_RTPRIO, 1, "");
+  printLimit(report, "RLIMIT_MEMLOCK", RLIMIT_MEMLOCK, 1024, " KiB");
+
+  // with throttling on, SCHED_FIFO threads are stopped for the rest of
+  // every period once they have used their runtime
+  long runtime = -1;
+  FILE* f = fopen(RT_RUNTIME_PATH, "r");
+  if (f)
+  {
+    if (fscanf(f, "%ld", &runtime) != 1) runtime = -1;
+    fclose(f);
+  }
+  if (runtime >= 0)
+    fprintf(report, "rt: kernel throttles SCHED_FIFO to %ld us per period (%s)\n", runtime, RT_RUNTIME_PATH);
+}
+
+bool rtLockMemory(FILE* report)
+{
+  // keep freed heap memory in the process, and serve large blocks from the
+  // locked heap rather than from fresh mappings
+#ifdef M_TRIM_THRESHOLD
+  mallopt(M_TRIM_THRESHOLD, -1);
+#endif
+#ifdef M_MMAP_MAX
+  mallopt(M_MMAP_MAX, 0);
+#endif
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+  {
+    fprintf(report, "rt: mlockall refused: %s\n", strerror(errno));
+    return false;
+  }
+  fprintf(report, "rt: memory locked\n");
+  return true;
+}
+
+// a frame of the given size, written so that every page of it is faulted
+// in; noinline so the frame is really below the caller's
+__attribute__((noinline)) void rtPrefaultStack(size_t bytes)
+{
+  char* stack = (char*)alloca(bytes);
+  memset(stack, 0, bytes);
+  asm volatile("" : : "r"(stack) : "memory");
+}
+
+void rtPrefault(void* buffer, size_t bytes)
+{
+  volatile char* p = (volatile char*)buffer;
+  size_t page = sysconf(_SC_PAGESIZE);
+  for (size_t offset = 0; offset < bytes; offset += page) p[offset] = p[offset];
+  if (bytes > 0) p[bytes - 1] = p[bytes - 1];
+}
+
+bool rtApplyThread(const char* name, const RtThreadProfile& profile, FILE* report)
+{
+  bool ok = true;
+  pthread_t self = pthread_self();
+
+  if (profile.cpu >= 0)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(profile.cpu, &set);
+    int err = pthread_setaffinity_np(self, sizeof(set), &set);
+    if (err != 0)
+    {
+      fprintf(report, "rt: %s: cpu %d refused: %s\n", name, profile.cpu, strerror(err));
+      ok = false;
+    }
+  }
+  if (profile.priority > 0)
+  {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = profile.priority;
+    int err = pthread_setschedparam(self, SCHED_FIFO, &param);
+    if (err != 0)
+    {
+      fprintf(report, "rt: %s: SCHED_FIFO %d refused: %s\n", name, profile.priority, strerror(err));
+      ok = false;
+    }
+  }
+
+  // what the kernel actually applied
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  int cpus = 0, cpu = -1;
+  if (pthread_getaffinity_np(self, sizeof(set), &set) == 0)
+    for (int c = 0; c < CPU_SETSIZE; c++)
+      if (CPU_ISSET(c, &set))
+      {
+        cpus++;
+        cpu = c;
+      }
+  int policy = SCHED_OTHER;
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  pthread_getschedparam(self, &policy, &param);
+  if (profile.cpu >= 0 && (cpus != 1 || cpu != profile.cpu)) ok = false;
+  if (profile.priority > 0 && (policy != SCHED_FIFO || param.sched_priority != profile.priority)) ok = false;
+
+  if (cpus == 1)
+    fprintf(report, "rt: %s on cpu %d", name, cpu);
+  else
+    fprintf(report, "rt: %s on %d cpus", name, cpus);
+  if (policy == SCHED_FIFO)
+    fprintf(report, ", SCHED_FIFO %d\n", param.sched_priority);
+  else
+    fprintf(report, ", %s\n", policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER");
+  return ok;
+}
+
+uint64_t rtPageFaults()
+{
+  struct rusage usage;
+#ifdef RUSAGE_THREAD
+  if (getrusage(RUSAGE_THREAD, &usage) != 0) return 0;
+#else
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#endif
+  return (uint64_t)usage.ru_minflt + usage.ru_majflt;
+}
@@ -0,0 +1,400 @@
+#include <string.h>
+#include "../include/sample_codec.h"
+
+#define SYNC0 0xEB
+#define SYNC1 0x90
+#define HEADER_SIZE 26
+#define CRC_SIZE 2
+
+// Rice quotients from this value on are written as this many ones followed
+// by the raw 16-bit value, which bounds the code length of outliers
+#define RICE_ESCAPE 16
+
+static uint16_t crc16(const uint8_t* data, size_t len)
+{
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++)
+  {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int k = 0; k < 8; k++)
+      crc = (crc << 1) ^ (0x1021 & (0u - (crc >> 15)));
+  }
+  return crc;
+}
+
+static inline void put16(uint8_t* p, uint16_t v)
+{
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static inline uint16_t get16(const uint8_t* p)
+{
+  return p[0] | (uint16_t)p[1] << 8;
+}
+
+static inline unsigned bitWidth(unsigned v)
+{
+  return v ? 32 - __builtin_clz(v) : 0;
+}
+
+// The prediction and transform loops are branch free over one axis so
+// that GCC vectorizes them (unit stride int16, __restrict).
+
+// zigzag(x[i] - x[i-1]) for i in [1, n); differences wrap modulo 2^16,
+// which the decoder undoes with the same wrapping add
+static void zigzagDeltas(size_t n, const int16_t* __restrict x, uint16_t* __restrict d)
+{
+  for (size_t i = 1; i < n; i++)
+  {
+    int16_t delta = (int16_t)(uint16_t)(x[i] - x[i - 1]);
+    d[i - 1] = (uint16_t)(((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15));
+  }
+}
+
+static unsigned maxValue(size_t n, const uint16_t* __restrict d)
+{
+  unsigned m = 0;
+  for (size_t i = 0; i < n; i++) m = d[i] > m ? d[i] : m;
+  return m;
+}
+
+static unsigned long sumValues(size_t n, const uint16_t* __restrict d)
+{
+  unsigned long s = 0;
+  for (size_t i = 0; i < n; i++) s += d[i];
+  return s;
+}
+
+// bits used by the Rice code of d with parameter k
+static unsigned long riceBits(size_t n, const uint16_t* __restrict d, unsigned k)
+{
+  unsigned long bits = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    unsigned q = d[i] >> k;
+    bits += q < RICE_ESCAPE ? q + 1 + k : RICE_ESCAPE + 16;
+  }
+  return bits;
+}
+
+// Rice parameter for one axis: the optimum lies next to log2 of the mean
+static unsigned riceParameter(size_t n, const uint16_t* d)
+{
+  if (n == 0) return 0;
+  unsigned mean = (unsigned)(sumValues(n, d) / n);
+  unsigned guess = bitWidth(mean);
+  unsigned best = guess;
+  unsigned long best_bits = riceBits(n, d, guess);
+  for (unsigned k = guess > 0 ? guess - 1 : 0; k <= guess + 1 && k < 16; k++)
+  {
+    unsigned long bits = riceBits(n, d, k);
+    if (bits < best_bits)
+    {
+      best = k;
+      best_bits = bits;
+    }
+  }
+  return best;
+}
+
+namespace
+{
+
+// LSB-first bit stream
+class BitWriter
+{
+  public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out), acc_(0), bits_(0) {}
+
+    // n <= 32
+    void put(uint32_t value, unsigned n)
+    {
+      acc_ |= (uint64_t)value << bits_;
+      bits_ += n;
+      while (bits_ >= 8)
+      {
+        out_.push_back((uint8_t)acc_);
+        acc_ >>= 8;
+        bits_ -= 8;
+      }
+    }
+
+    void finish()
+    {
+      if (bits_ > 0) out_.push_back((uint8_t)acc_);
+      acc_ = 0;
+      bits_ = 0;
+    }
+
+  private:
+    std::vector<uint8_t>& out_;
+    uint64_t acc_;
+    unsigned bits_;
+};
+
+class BitReader
+{
+  public:
+    BitReader(const uint8_t* p, const uint8_t* end) :
+        p_(p), end_(end), acc_(0), bits_(0), used_(0), avail_((end - p) * 8) {}
+
+    // n <= 32; reading past the end yields zero bits and sets overrun()
+    uint32_t get(unsigned n)
+    {
+      refill();
+      uint32_t v = (uint32_t)(acc_ & ((1ull << n) - 1));
+      consume(n);
+      return v;
+    }
+
+    // number of consecutive one bits, at most limit (< 56); the
+    // terminating zero is consumed if the run is shorter than limit
+    unsigned ones(unsigned limit)
+    {
+      refill();
+      // ctz of 0 is undefined; a full accumulator is a run of 64
+      uint64_t zeros = ~acc_;
+      unsigned run = zeros == 0 ? 64 : __builtin_ctzll(zeros);
+      if (run >= limit)
+      {
+        consume(limit);
+        return limit;
+      }
+      consume(run + 1);
+      return run;
+    }
+
+    bool overrun() const
+    {
+      return used_ > avail_;
+    }
+
+  private:
+    void refill()
+    {
+      while (bits_ <= 56)
+      {
+        uint64_t byte = p_ < end_ ? *p_++ : 0;
+        acc_ |= byte << bits_;
+        bits_ += 8;
+      }
+    }
+
+    void consume(unsigned n)
+    {
+      acc_ >>= n;
+      bits_ -= n;
+      used_ += n;
+    }
+
+    const uint8_t* p_;
+    const uint8_t* end_;
+    uint64_t acc_;
+    unsigned bits_;
+    size_t used_;
+    size_t avail_;
+};
+
+}
+
+SampleEncoder::SampleEncoder(SampleCoding coding, size_t block_samples) :
+    coding_(coding), count_(0)
+{
+  block_samples_ = block_samples < 2 ? 2 : (block_samples > SAMPLE_BLOCK_MAX ? SAMPLE_BLOCK_MAX : block_samples);
+  for (int a = 0; a < SAMPLE_AXES; a++) axes_[a].resize(block_samples_);
+  deltas_.resize(block_samples_);
+}
+
+void SampleEncoder::write(const int16_t* samples, size_t count, std::vector<uint8_t>& out)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    for (int a = 0; a < SAMPLE_AXES; a++) axes_[a][count_] = samples[i * SAMPLE_AXES + a];
+    if (++count_ == block_samples_) encodeBlock(out);
+  }
+}
+
+void SampleEncoder::writeFifo(const uint8_t* fifo, size_t bytes, bool has_temp,
+                              std::vector<uint8_t>& out)
+{
+  size_t stride = has_temp ? 14 : 12;
+  for (size_t off = 0; off + stride <= bytes; off += stride)
+  {
+    const uint8_t* p = fifo + off;
+    for (int a = 0; a < SAMPLE_AXES; a++)
+    {
+      // the gyro follows the temperature when it is in the FIFO
+      const uint8_t* v = p + 2 * a + (has_temp && a >= 3 ? 2 : 0);
+      axes_[a][count_] = (int16_t)(uint16_t)(v[0] << 8 | v[1]);
+    }
+    if (++count_ == block_samples_) encodeBlock(out);
+  }
+}
+
+void SampleEncoder::flush(std::vector<uint8_t>& out)
+{
+  if (count_ > 0) encodeBlock(out);
+}
+
+void SampleEncoder::encodeBlock(std::vector<uint8_t>& out)
+{
+  size_t start = out.size();
+  out.resize(start + HEADER_SIZE);
+  uint8_t* h = &out[start];
+  h[0] = SYNC0;
+  h[1] = SYNC1;
+  h[2] = (uint8_t)coding_;
+  h[3] = SAMPLE_AXES;
+  put16(h + 4, (uint16_t)count_);
+  for (int a = 0; a < SAMPLE_AXES; a++) put16(h + 8 + 2 * a, (uint16_t)axes_[a][0]);
+
+  size_t n = count_ - 1;
+  uint8_t params[SAMPLE_AXES];
+  BitWriter bits(out);
+  for (int a = 0; a < SAMPLE_AXES; a++)
+  {
+    const uint16_t* d = &deltas_[0];
+    zigzagDeltas(count_, &axes_[a][0], &deltas_[0]);
+    switch (coding_)
+    {
+      case SAMPLE_CODING_VARINT:
+        params[a] = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+          unsigned v = d[i];
+          while (v >= 0x80)
+          {
+            out.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+          }
+          out.push_back((uint8_t)v);
+        }
+        break;
+      case SAMPLE_CODING_BITPACK:
+      {
+        unsigned width = bitWidth(maxValue(n, d));
+        params[a] = width;
+        for (size_t i = 0; i < n; i++) bits.put(d[i], width);
+        break;
+      }
+      case SAMPLE_CODING_RICE:
+      default:
+      {
+        unsigned k = riceParameter(n, d);
+        params[a] = k;
+        for (size_t i = 0; i < n; i++)
+        {
+          unsigned q = d[i] >> k;
+          if (q < RICE_ESCAPE)
+          {
+            bits.put((1u << q) - 1, q + 1);
+            bits.put(d[i] & ((1u << k) - 1), k);
+          }
+          else
+          {
+            bits.put((1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+            bits.put(d[i], 16);
+          }
+        }
+        break;
+      }
+    }
+  }
+  bits.finish();
+
+  // out may have been reallocated while the payload was written
+  h = &out[start];
+  memcpy(h + 20, params, SAMPLE_AXES);
+  put16(h + 6, (uint16_t)(out.size() - start - HEADER_SIZE));
+  uint16_t crc = crc16(h, out.size() - start);
+  out.push_back(crc & 0xFF);
+  out.push_back(crc >> 8);
+  count_ = 0;
+}
+
+// running sum of the zigzag deltas, wrapping like the encoder's differences
+static inline int16_t undelta(int16_t prev, unsigned zz)
+{
+  int16_t delta = (int16_t)((zz >> 1) ^ (0u - (zz & 1)));
+  return (int16_t)(uint16_t)(prev + delta);
+}
+
+size_t decodeSampleBlock(const uint8_t* in, size_t len, std::vector<int16_t>& samples)
+{
+  if (len < HEADER_SIZE + CRC_SIZE || in[0] != SYNC0 || in[1] != SYNC1) return 0;
+  unsigned coding = in[2];
+  size_t count = get16(in + 4);
+  size_t payload = get16(in + 6);
+  if (in[3] != SAMPLE_AXES || coding > SAMPLE_CODING_RICE ||
+      count == 0 || count > SAMPLE_BLOCK_MAX)
+    return 0;
+  size_t size = HEADER_SIZE + payload + CRC_SIZE;
+  if (size > len || crc16(in, HEADER_SIZE + payload) != get16(in + HEADER_SIZE + payload))
+    return 0;
+
+  size_t base = samples.size();
+  samples.resize(base + count * SAMPLE_AXES);
+  int16_t* out = &samples[base];
+  const uint8_t* p = in + HEADER_SIZE;
+  const uint8_t* end = p + payload;
+  BitReader bits(p, end);
+  for (int a = 0; a < SAMPLE_AXES; a++)
+  {
+    unsigned param = in[20 + a];
+    int16_t x = (int16_t)get16(in + 8 + 2 * a);
+    out[a] = x;
+    for (size_t i = 1; i < count; i++)
+    {
+      unsigned zz;
+      if (coding == SAMPLE_CODING_VARINT)
+      {
+        zz = 0;
+        for (int shift = 0; p < end && shift < 21; shift += 7)
+        {
+          uint8_t byte = *p++;
+          zz |= (unsigned)(byte & 0x7F) << shift;
+          if (!(byte & 0x80)) break;
+        }
+      }
+      else if (coding == SAMPLE_CODING_BITPACK)
+      {
+        zz = param ? bits.get(param) : 0;
+      }
+      else
+      {
+        unsigned q = bits.ones(RICE_ESCAPE);
+        zz = q < RICE_ESCAPE ? (q << param) | bits.get(param) : bits.get(16);
+      }
+      x = undelta(x, zz);
+      out[i * SAMPLE_AXES + a] = x;
+    }
+  }
+  if (bits.overrun())
+  {
+    samples.resize(base);
+    return 0;
+  }
+  return size;
+}
+
+size_t decodeSampleStream(const uint8_t* in, size_t len, std::vector<int16_t>& samples)
+{
+  size_t skipped = 0;
+  size_t off = 0;
+  while (off < len)
+  {
+    size_t used = decodeSampleBlock(in + off, len - off, samples);
+    if (used > 0)
+    {
+      off += used;
+      continue;
+    }
+    // not a block here; look for the next sync word
+    const uint8_t* next = (const uint8_t*)memchr(in + off + 1, SYNC0, len - off - 1);
+    size_t to = next ? next - in : len;
+    skipped += to - off;
+    off = to;
+  }
+  return skipped;
+}
@@ -0,0 +1,24 @@
+#include "../include/sample_filters.h"
+#include "../include/stage_probe.h"
+
+double compFilter(double accel_data, double gyro_data)
+{
+  return COMP_GYRO_WEIGHT * gyro_data + COMP_ACCEL_WEIGHT * accel_data;
+}
+
+double MedianWindow::median() const
+{
+  STAGE_PROBE(PROBE_MEDIAN);
+  if (!ready()) return 0;
+  // insertion sort of a copy; the window is a handful of values
+  double v[MEDIAN_WINDOW];
+  for (unsigned i = 0; i < MEDIAN_WINDOW; i++)
+  {
+    double x = values_[i];
+    unsigned j = i;
+    for (; j > 0 && v[j - 1] > x; j--) v[j] = v[j - 1];
+    v[j] = x;
+  }
+  if (MEDIAN_WINDOW % 2 != 0) return v[MEDIAN_WINDOW / 2];
+  return (v[MEDIAN_WINDOW / 2 - 1] + v[MEDIAN_WINDOW / 2]) / 2;
+}
@@ -0,0 +1,196 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../include/sample_stream.h"
+
+// keeps a few frames in the kernel for each client; more only adds latency
+#define CLIENT_SEND_BUFFER (64 * 1024)
+
+static bool setNonBlocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+SampleStreamer::SampleStreamer(size_t batch) :
+    batch_(batch < 1 ? 1 : batch), listen_fd_(-1), sequence_(0), dropped_(0)
+{
+}
+
+SampleStreamer::~SampleStreamer()
+{
+  close();
+}
+
+bool SampleStreamer::openUnix(const char* path)
+{
+  close();
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) return false;
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  unlink(path);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  return listen(fd);
+}
+
+bool SampleStreamer::openTcp(uint16_t port)
+{
+  close();
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  return listen(fd);
+}
+
+bool SampleStreamer::listen(int fd)
+{
+  if (::listen(fd, 4) != 0 || !setNonBlocking(fd))
+  {
+    ::close(fd);
+    return false;
+  }
+  listen_fd_ = fd;
+  sequence_ = 0;
+  dropped_ = 0;
+  return true;
+}
+
+void SampleStreamer::accept()
+{
+  for (;;)
+  {
+    int fd = ::accept(listen_fd_, 0, 0);
+    if (fd < 0) return;
+    int size = CLIENT_SEND_BUFFER;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    if (!setNonBlocking(fd))
+    {
+      ::close(fd);
+      continue;
+    }
+    Client client;
+    client.fd = fd;
+    client.pending.reserve(sizeof(StreamFrameHeader) + batch_ * sizeof(RingSample));
+    client.sent = 0;
+    clients_.push_back(client);
+  }
+}
+
+// Sends what is left of the client's last frame. Returns false if the
+// client is gone.
+bool SampleStreamer::finish(Client& client)
+{
+  while (client.sent < client.pending.size())
+  {
+    ssize_t n = ::send(client.fd, &client.pending[client.sent], client.pending.size() - client.sent,
+                       MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    client.sent += n;
+  }
+  client.pending.clear();
+  client.sent = 0;
+  return true;
+}
+
+// Sends a frame straight from the ring slots; whatever the socket does not
+// take is kept for finish(). Returns false if the client is gone.
+bool SampleStreamer::send(Client& client, const StreamFrameHeader& header, const RingSample* samples)
+{
+  struct iovec iov[2];
+  iov[0].iov_base = (void*)&header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = (void*)samples;
+  iov[1].iov_len = header.count * sizeof(RingSample);
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+
+  ssize_t n = sendmsg(client.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+  if (n < 0)
+  {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return false;
+    dropped_++;
+    return true;
+  }
+  size_t sent = n;
+  for (int k = 0; k < 2; k++)
+  {
+    if (sent >= iov[k].iov_len)
+    {
+      sent -= iov[k].iov_len;
+      continue;
+    }
+    const uint8_t* p = (const uint8_t*)iov[k].iov_base;
+    client.pending.insert(client.pending.end(), p + sent, p + iov[k].iov_len);
+    sent = 0;
+  }
+  return true;
+}
+
+void SampleStreamer::drop(size_t i)
+{
+  ::close(clients_[i].fd);
+  clients_.erase(clients_.begin() + i);
+}
+
+void SampleStreamer::poll(SampleRing& ring)
+{
+  if (listen_fd_ < 0) return;
+  accept();
+  for (size_t i = clients_.size(); i-- > 0;)
+    if (!finish(clients_[i])) drop(i);
+
+  StreamFrameHeader header;
+  memcpy(header.magic, STREAM_MAGIC, 4);
+  header.version = STREAM_VERSION;
+  header.sample_size = sizeof(RingSample);
+  size_t n;
+  for (const RingSample* s = ring.peek(n); n > 0; s = ring.peek(n))
+  {
+    if (n > batch_) n = batch_;
+    header.sequence = sequence_++;
+    header.count = (uint32_t)n;
+    for (size_t i = clients_.size(); i-- > 0;)
+    {
+      // a client still busy with an earlier frame misses this one whole
+      if (!clients_[i].pending.empty()) dropped_++;
+      else if (!send(clients_[i], header, s)) drop(i);
+    }
+    ring.consume(n);
+  }
+}
+
+void SampleStreamer::close()
+{
+  for (size_t i = 0; i < clients_.size(); i++) ::close(clients_[i].fd);
+  clients_.clear();
+  if (listen_fd_ >= 0) ::close(listen_fd_);
+  listen_fd_ = -1;
+}
@@ -0,0 +1,29 @@
+#include "../include/imu_device.h"
+#include "../include/sidekiq_api.h"
+
+SidekiqDevice::~SidekiqDevice()
+{
+  close();
+}
+
+bool SidekiqDevice::open()
+{
+  if (!open_) open_ = skiq_init(skiq_xport_type_auto, skiq_xport_init_level_basic, &card_, 1) == 0;
+  return open_;
+}
+
+void SidekiqDevice::close()
+{
+  if (open_) skiq_exit();
+  open_ = false;
+}
+
+bool SidekiqDevice::readRegisters(uint8_t reg, uint8_t* data, size_t len)
+{
+  return skiq_read_accel_reg(card_, reg, data, len) == 0;
+}
+
+bool SidekiqDevice::writeRegisters(uint8_t reg, const uint8_t* data, size_t len)
+{
+  return skiq_write_accel_reg(card_, reg, const_cast<uint8_t*>(data), len) == 0;
+}
@@ -0,0 +1,195 @@
+#include "../include/stage_probe.h"
+
+#ifdef IMU_PROBES
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PROBE_EVENTS 3
+
+enum ProbeSource { SOURCE_NONE, SOURCE_PERF, SOURCE_CYCLES, SOURCE_NS };
+
+static const char* const stage_names[PROBE_STAGES] =
+{
+  "read_imu", "median", "filter_imu", "filter_marg", "log_append", "log_write"
+};
+
+static const char* const source_names[] = { "none", "perf", "cycles", "ns" };
+
+// calls, cycles, instructions, cache misses of each stage
+static std::atomic<uint64_t> totals[PROBE_STAGES][1 + PROBE_EVENTS];
+static std::atomic<int> report_source(SOURCE_NONE);
+
+static uint64_t monotonicNs()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+#if defined(__arm__) && defined(__ARM_ARCH_7A__)
+// PMCCNTR is usable from user space only if the kernel has set
+// PMUSERENR.EN and the counter is enabled (PMCR.E, PMCNTENSET.C)
+static bool cycleCounterUsable()
+{
+  uint32_t userenr, pmcr, cntenset;
+  asm volatile("mrc p15, 0, %0, c9, c14, 0" : "=r"(userenr));
+  if (!(userenr & 1)) return false;
+  asm volatile("mrc p15, 0, %0, c9, c12, 0" : "=r"(pmcr));
+  asm volatile("mrc p15, 0, %0, c9, c12, 1" : "=r"(cntenset));
+  return (pmcr & 1) && (cntenset & 0x80000000u);
+}
+#endif
+
+static bool readCycles(uint64_t& cycles)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  cycles = (uint64_t)hi << 32 | lo;
+  return true;
+#elif defined(__arm__) && defined(__ARM_ARCH_7A__)
+  static const bool usable = cycleCounterUsable();
+  if (!usable) return false;
+  uint32_t ccnt;
+  asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(ccnt));
+  cycles = ccnt;
+  return true;
+#else
+  (void)cycles;
+  return false;
+#endif
+}
+
+namespace
+{
+
+// the perf_event group of one thread, opened on its first probe
+struct ThreadCounters
+{
+  ThreadCounters() : source(SOURCE_NONE), events(0)
+  {
+    for (int e = 0; e < PROBE_EVENTS; e++) fds[e] = -1;
+  }
+
+  ~ThreadCounters()
+  {
+    for (int e = 0; e < PROBE_EVENTS; e++)
+      if (fds[e] >= 0) ::close(fds[e]);
+  }
+
+  void open()
+  {
+    static const uint64_t configs[PROBE_EVENTS] =
+    {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+    for (int e = 0; e < PROBE_EVENTS; e++)
+    {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[e];
+      attr.read_format = PERF_FORMAT_GROUP;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      int fd = syscall(__NR_perf_event_open, &attr, 0, -1, e == 0 ? -1 : fds[0], 0);
+      // without cycles there is no group; a missing later event only
+      // leaves its column empty
+      if (fd < 0 && e == 0) break;
+      fds[e] = fd;
+      if (fd >= 0) events++;
+    }
+    uint64_t cycles;
+    if (events > 0)
+    {
+      ::ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ::ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+      source = SOURCE_PERF;
+    }
+    else
+      source = readCycles(cycles) ? SOURCE_CYCLES : SOURCE_NS;
+    int none = SOURCE_NONE;
+    report_source.compare_exchange_strong(none, source);
+  }
+
+  void read(ProbeCounts& counts)
+  {
+    if (source == SOURCE_NONE) open();
+    counts.instructions = 0;
+    counts.cache_misses = 0;
+    if (source == SOURCE_PERF)
+    {
+      // nr, then the value of each event in the order they were opened
+      uint64_t values[1 + PROBE_EVENTS] = { 0 };
+      if (::read(fds[0], values, sizeof(values)) < (ssize_t)(2 * sizeof(uint64_t))) values[1] = 0;
+      uint64_t* v = values + 1;
+      counts.cycles = *v++;
+      if (fds[1] >= 0) counts.instructions = *v++;
+      if (fds[2] >= 0) counts.cache_misses = *v++;
+    }
+    else if (source != SOURCE_CYCLES || !readCycles(counts.cycles))
+      counts.cycles = monotonicNs();
+  }
+
+  int source;
+  int events;
+  int fds[PROBE_EVENTS];
+};
+
+}
+
+static thread_local ThreadCounters thread_counters;
+
+void stageProbeRead(ProbeCounts& counts)
+{
+  thread_counters.read(counts);
+}
+
+void stageProbeAdd(ProbeStage stage, const ProbeCounts& begin)
+{
+  ProbeCounts end;
+  thread_counters.read(end);
+#if defined(__arm__) && defined(__ARM_ARCH_7A__)
+  // PMCCNTR is 32 bits; a probe spanning a wrap still differences correctly
+  if (thread_counters.source == SOURCE_CYCLES)
+    end.cycles = begin.cycles + (uint32_t)(end.cycles - begin.cycles);
+#endif
+  std::atomic<uint64_t>* t = totals[stage];
+  t[0].fetch_add(1, std::memory_order_relaxed);
+  t[1].fetch_add(end.cycles - begin.cycles, std::memory_order_relaxed);
+  t[2].fetch_add(end.instructions - begin.instructions, std::memory_order_relaxed);
+  t[3].fetch_add(end.cache_misses - begin.cache_misses, std::memory_order_relaxed);
+}
+
+void stageProbeReport(FILE* out)
+{
+  int source = report_source.load();
+  fprintf(out, "stage probes (%s):\n%-12s %12s %12s", source_names[source],
+          "stage", "calls", source == SOURCE_NS ? "ns/call" : "cycles/call");
+  if (source == SOURCE_PERF)
+    fprintf(out, " %12s %6s %12s", "instr/call", "IPC", "misses/call");
+  fprintf(out, "\n");
+  for (int s = 0; s < PROBE_STAGES; s++)
+  {
+    uint64_t calls = totals[s][0].load(std::memory_order_relaxed);
+    if (calls == 0) continue;
+    double cycles = totals[s][1].load(std::memory_order_relaxed);
+    double instructions = totals[s][2].load(std::memory_order_relaxed);
+    double misses = totals[s][3].load(std::memory_order_relaxed);
+    fprintf(out, "%-12s %12llu %12.1f", stage_names[s], (unsigned long long)calls, cycles / calls);
+    if (source == SOURCE_PERF)
+      fprintf(out, " %12.1f %6.2f %12.2f\n", instructions / calls,
+              cycles > 0 ? instructions / cycles : 0.0, misses / calls);
+    else
+      fprintf(out, "\n");
+  }
+}
+
+#endif // IMU_PROBES
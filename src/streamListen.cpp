@@ -0,0 +1,122 @@
+#include <iostream>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "../include/sample_stream.h"
+
+using namespace std;
+
+// connects to the live sample stream of IMU.cpp and prints once a second
+// how many frames and samples arrived, how many frames were missed and the
+// latest attitude; a minimal ground-support client
+
+static int connectTo(const char* target)
+{
+	int fd;
+	if (target[0] == '/')
+	{
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, target, sizeof(addr.sun_path) - 1);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+	else
+	{
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(atoi(target));
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+	return fd;
+}
+
+// reads exactly len bytes; false at the end of the stream
+static bool readAll(int fd, void* data, size_t len)
+{
+	char* p = (char*)data;
+	while (len > 0)
+	{
+		ssize_t n = recv(fd, p, len, 0);
+		if (n <= 0) return false;
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+static double seconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		printf("usage: %s <socket path | port>\n", argv[0]);
+		return 1;
+	}
+	int fd = connectTo(argv[1]);
+	if (fd < 0)
+	{
+		printf("could not connect to %s\n", argv[1]);
+		return 1;
+	}
+
+	vector<RingSample> samples;
+	StreamFrameHeader header;
+	uint32_t expected = 0;
+	bool first = true;
+	unsigned long frames = 0, count = 0, missed = 0;
+	double next = seconds() + 1;
+	while (readAll(fd, &header, sizeof(header)))
+	{
+		if (memcmp(header.magic, STREAM_MAGIC, 4) != 0 || header.version != STREAM_VERSION ||
+			header.sample_size != sizeof(RingSample))
+		{
+			printf("not a sample stream\n");
+			return 1;
+		}
+		samples.resize(header.count);
+		if (!readAll(fd, samples.data(), header.count * sizeof(RingSample))) break;
+
+		if (!first) missed += header.sequence - expected;
+		first = false;
+		expected = header.sequence + 1;
+		frames++;
+		count += header.count;
+
+		if (seconds() >= next && header.count > 0)
+		{
+			const RingSample& s = samples.back();
+			printf("%lu frames, %lu samples, %lu missed | t %.3f s q %.4f %.4f %.4f %.4f\n",
+				frames, count, missed, s.raw.t_ns * 1e-9, s.q[0], s.q[1], s.q[2], s.q[3]);
+			fflush(stdout);
+			frames = count = missed = 0;
+			next += 1;
+		}
+	}
+	close(fd);
+	return 0;
+}
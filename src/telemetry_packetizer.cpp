@@ -0,0 +1,129 @@
+#include <math.h>
+#include "../include/telemetry_packetizer.h"
+
+#define HEADERS_SIZE (TM_PRIMARY_HEADER_SIZE + TM_SECONDARY_HEADER_SIZE)
+
+static inline void put16(uint8_t* p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v & 0xFF;
+}
+
+static inline void put32(uint8_t* p, uint32_t v)
+{
+  put16(p, v >> 16);
+  put16(p + 2, v & 0xFFFF);
+}
+
+// CUC time field with its P-field: seconds and 2^-24 s fractions since
+// the epoch
+static inline void putTime(uint8_t* p, uint64_t ns)
+{
+  uint64_t fraction = ((ns % 1000000000) << 24) / 1000000000;
+  p[0] = TM_TIME_PFIELD;
+  put32(p + 1, (uint32_t)(ns / 1000000000));
+  p[5] = fraction >> 16;
+  put16(p + 6, fraction & 0xFFFF);
+}
+
+// quaternion component in [-1, 1] as Q15
+static inline uint16_t q15(float v)
+{
+  long q = lrintf(v * 32767.0f);
+  return (uint16_t)(int16_t)(q > 32767 ? 32767 : (q < -32767 ? -32767 : q));
+}
+
+TelemetryPacketizer::TelemetryPacketizer(uint64_t start_ns, unsigned attitude_decimation,
+                                         unsigned raw_decimation, size_t packet_size) :
+    start_ns_(start_ns), packets_(0), failed_(false)
+{
+  init(attitude_, TM_APID_ATTITUDE, attitude_decimation, TM_ATTITUDE_ENTRY_SIZE, packet_size);
+  init(raw_, TM_APID_RAW, raw_decimation, TM_RAW_ENTRY_SIZE, packet_size);
+}
+
+void TelemetryPacketizer::init(Stream& stream, uint16_t apid, unsigned decimation,
+                               size_t entry_size, size_t packet_size)
+{
+  // at least one entry, at most what the 16-bit length field can describe
+  size_t max_size = TM_PRIMARY_HEADER_SIZE + 65536;
+  if (packet_size < HEADERS_SIZE + entry_size) packet_size = HEADERS_SIZE + entry_size;
+  if (packet_size > max_size) packet_size = max_size;
+
+  stream.apid = apid;
+  stream.decimation = decimation;
+  stream.phase = 0;
+  stream.entry_size = entry_size;
+  stream.packet.assign(packet_size, 0);
+  stream.fill = 0;
+  stream.sequence = 0;
+  stream.t0_ns = 0;
+}
+
+// Room for the next entry of stream, sending the packet first if it is
+// full. The packet time is that of its first entry.
+uint8_t* TelemetryPacketizer::entry(Stream& stream, uint64_t t_ns, LogSink& out)
+{
+  if (stream.fill + stream.entry_size > stream.packet.size()) send(stream, out);
+  if (stream.fill == 0)
+  {
+    stream.fill = HEADERS_SIZE;
+    stream.t0_ns = t_ns;
+  }
+  uint8_t* p = &stream.packet[stream.fill];
+  stream.fill += stream.entry_size;
+  put32(p, (uint32_t)((t_ns - stream.t0_ns) / 1000));
+  return p + 4;
+}
+
+bool TelemetryPacketizer::send(Stream& stream, LogSink& out)
+{
+  if (stream.fill == 0) return true;
+  uint8_t* h = &stream.packet[0];
+  put16(h, 0x0800 | stream.apid);                   // version 0, telemetry, secondary header
+  put16(h + 2, 0xC000 | stream.sequence);           // unsegmented
+  put16(h + 4, (uint16_t)(stream.fill - TM_PRIMARY_HEADER_SIZE - 1));
+  putTime(h + 6, start_ns_ + stream.t0_ns);
+  stream.sequence = (stream.sequence + 1) & 0x3FFF;
+
+  bool ok = out.write(h, stream.fill);
+  if (!ok) failed_ = true;
+  stream.fill = 0;
+  packets_++;
+  return ok;
+}
+
+bool TelemetryPacketizer::drain(SampleRing& ring, LogSink& out)
+{
+  failed_ = false;
+  size_t n;
+  for (const RingSample* s = ring.peek(n); n > 0; s = ring.peek(n))
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      const FlightLogRecord& raw = s[i].raw;
+      if (attitude_.decimation > 0 && attitude_.phase-- == 0)
+      {
+        attitude_.phase = attitude_.decimation - 1;
+        uint8_t* p = entry(attitude_, raw.t_ns, out);
+        for (int k = 0; k < 4; k++) put16(p + 2 * k, q15(s[i].q[k]));
+      }
+      if (raw_.decimation > 0 && raw_.phase-- == 0)
+      {
+        raw_.phase = raw_.decimation - 1;
+        uint8_t* p = entry(raw_, raw.t_ns, out);
+        for (int k = 0; k < 3; k++) put16(p + 2 * k, (uint16_t)raw.accel[k]);
+        for (int k = 0; k < 3; k++) put16(p + 6 + 2 * k, (uint16_t)raw.gyro[k]);
+        put16(p + 12, (uint16_t)raw.temp);
+        put16(p + 14, raw.flags);
+      }
+    }
+    ring.consume(n);
+  }
+  return !failed_;
+}
+
+bool TelemetryPacketizer::flush(LogSink& out)
+{
+  bool ok = send(attitude_, out);
+  return send(raw_, out) && ok;
+}
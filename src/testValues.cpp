@@ -4,8 +4,9 @@
 #include <algorithm>
 #include <string.h>
 #include <string>
-#include <fstream>
 #include "imu_filter.h"
+#include "imu_recording.h"
+#include "text_writer.h"
 #include "world_frame.h"
 
 using namespace std;
@@ -44,18 +45,6 @@ double compFilter(double accel_data, double gyro_data)
 	return KGYRO * gyro_data + KACCEL * accel_data;
 }
 
-float getLineAsFloat(ifstream& fileStream, string& outputVariable, const char* caption, char delimiter)
-{
-	getline(fileStream, outputVariable, delimiter);
-	printf(caption);
-
-	double result = atof(outputVariable.c_str());
-
-	printf(": %.9f\n", result);
-
-	return result;
-}
-
 int main()
 {
 	//double gyro_y;  //raw_value
@@ -65,46 +54,51 @@ int main()
 	double finalAngle_y = 0;
 	double dTheta = 0;
 
-	string nothing, fgyro_x, fgyro_y, fgyro_z, faccel_x, faccel_y, faccel_z;
-	ifstream inFile;
+	ImuRecording rec;
 
 	printf("Reading IMUv2.csv...");
 
-	inFile.open("IMUv2.csv");
-
-	if (inFile.fail())
+	// columns are found by name (Shimmer_B663_Accel_LN_X_CAL, Shimmer_B663_Gyro_X_CAL, ...);
+	// the gyro is kept in the recorded deg/s
+	if (!loadImuRecording("IMUv2.csv", rec, 1.0f))
 	{
 		printf("failure\n");
 		cin.get();
 	}
 	else
 	{
-		printf("success\n\n");
+		printf("success, %zu samples\n\n", rec.size());
 	}
 
+	//shortest round-trip numbers through one big buffer instead of printf per value;
+	//it writes to fd 1 directly, so what printf still holds goes out first
+	fflush(stdout);
+	TextWriter out;
+	out.open(0);
+
 	//fstream data("D:\\CubeSat\\IMUoutput.csv");
 	//data << "Accel Y, Accel Z, Gyro Y, Delta Theta Y, Accel Angle Y, Final Angle Y" << endl;
 
-	getline(inFile, nothing, '\n'); // skip header line one
-
-	for (int i = 0; i < 49; i++) // 49 samples from ashwins data
+	for (size_t i = 0; i < rec.size(); i++)
 	{
-		printf("\nIteration %d\n", (i + 1));
-
-		getline(inFile, nothing, '\n'); // skip header line two on first iteration, then move to the next line on all subsequent iteration
-		getline(inFile, nothing, ','); // skip Shimmer_B663_Timestamp_FormattedUnix_CAL
-
-		float accel_x = getLineAsFloat(inFile, faccel_x, "Accel X", ','); // Shimmer_B663_Accel_LN_X_CAL
-		float accel_y = getLineAsFloat(inFile, faccel_y, "Accel Y", ','); // Shimmer_B663_Accel_LN_Y_CAL
-		float accel_z = getLineAsFloat(inFile, faccel_z, "Accel Z", ','); // Shimmer_B663_Accel_LN_Z_CAL
-
-		getline(inFile, nothing, ','); // Shimmer_B663_Accel_WR_X_CAL
-		getline(inFile, nothing, ','); // Shimmer_B663_Accel_WR_Y_CAL
-		getline(inFile, nothing, ','); // Shimmer_B663_Accel_WR_Z_CAL
-
-		float gyro_x = getLineAsFloat(inFile, fgyro_x, "Gyro X", ','); // Shimmer_B663_Gyro_X_CAL
-		float gyro_y = getLineAsFloat(inFile, fgyro_y, "Gyro Y", ','); // Shimmer_B663_Gyro_Y_CAL
-		float gyro_z = getLineAsFloat(inFile, fgyro_z, "Gyro Z", ','); // Shimmer_B663_Gyro_Z_CAL
+		out.put("\nIteration ");
+		out.putInt(i + 1);
+
+		float accel_x = rec.ax[i], accel_y = rec.ay[i], accel_z = rec.az[i];
+		float gyro_x = rec.gx[i], gyro_y = rec.gy[i], gyro_z = rec.gz[i];
+		out.put("\nAccel: ");
+		out.put(accel_x);
+		out.put(' ');
+		out.put(accel_y);
+		out.put(' ');
+		out.put(accel_z);
+		out.put("\nGyro: ");
+		out.put(gyro_x);
+		out.put(' ');
+		out.put(gyro_y);
+		out.put(' ');
+		out.put(gyro_z);
+		out.put('\n');
 
 		//arctan A for accel
 		//angle_ay = (atan2(median_ay, median_az) * RAD_TO_DEGREES);
@@ -128,10 +122,18 @@ int main()
 
 		filterStationary<WorldFrame::ENU>(accel_x, accel_y, accel_z, gyro_x, gyro_y, gyro_z, q0, q1, q2, q3);
 
-		printf("Final Quaternion is < %.9f %.9f %.9f %.9f >\n", q0, q1, q2, q3);
+		out.put("Final Quaternion is < ");
+		out.put(q0);
+		out.put(' ');
+		out.put(q1);
+		out.put(' ');
+		out.put(q2);
+		out.put(' ');
+		out.put(q3);
+		out.put(" >\n");
 
 		//printf("final angle y is %.9f\n", finalAngle_y); //final angle
-		printf("------------------");
+		out.put("------------------");
 
 		//data << ("%.9f", median_ay);
 		//data << ",";
@@ -146,6 +148,7 @@ int main()
 		data << ("%.9f", finalAngle_y) << endl;*/
 	}
 	//data.close();
+	out.close();
 	cin.get();
 }
 /*
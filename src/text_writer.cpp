@@ -0,0 +1,97 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/float_format.h"
+#include "../include/log_sink.h"
+#include "../include/text_writer.h"
+
+TextWriter::TextWriter(size_t buffer_size) :
+    size_(buffer_size < 64 ? 64 : buffer_size), fill_(0), fd_(-1), owned_(false), failed_(false)
+{
+  buffer_ = new char[size_];
+}
+
+TextWriter::~TextWriter()
+{
+  close();
+  delete[] buffer_;
+}
+
+bool TextWriter::open(const char* path)
+{
+  close();
+  failed_ = false;
+  if (!path)
+  {
+    fd_ = STDOUT_FILENO;
+    owned_ = false;
+    return true;
+  }
+  fd_ = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  owned_ = true;
+  return fd_ >= 0;
+}
+
+void TextWriter::put(const char* text)
+{
+  size_t len = strlen(text);
+  while (len > 0)
+  {
+    if (fill_ == size_) flush();
+    size_t n = len < size_ - fill_ ? len : size_ - fill_;
+    memcpy(buffer_ + fill_, text, n);
+    fill_ += n;
+    text += n;
+    len -= n;
+  }
+}
+
+void TextWriter::put(char c)
+{
+  if (fill_ == size_) flush();
+  buffer_[fill_++] = c;
+}
+
+void TextWriter::put(float v)
+{
+  reserve();
+  fill_ = formatFloat(buffer_ + fill_, v) - buffer_;
+}
+
+void TextWriter::put(double v)
+{
+  reserve();
+  fill_ = formatDouble(buffer_ + fill_, v) - buffer_;
+}
+
+void TextWriter::putInt(long long v)
+{
+  reserve();
+  char digits[24];
+  int n = 0;
+  unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : (unsigned long long)v;
+  do
+  {
+    digits[n++] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u > 0);
+  if (v < 0) buffer_[fill_++] = '-';
+  while (n > 0) buffer_[fill_++] = digits[--n];
+}
+
+bool TextWriter::flush()
+{
+  if (fill_ > 0 && (fd_ < 0 || !writeAll(fd_, buffer_, fill_))) failed_ = true;
+  fill_ = 0;
+  return !failed_;
+}
+
+bool TextWriter::close()
+{
+  if (fd_ < 0 && fill_ == 0) return !failed_;
+  bool ok = flush();
+  if (owned_ && fd_ >= 0) ok = ::close(fd_) == 0 && ok;
+  fd_ = -1;
+  owned_ = false;
+  return ok;
+}
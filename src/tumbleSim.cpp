@@ -0,0 +1,191 @@
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cmath>
+#include "../include/flight_log.h"
+#include "../include/text_writer.h"
+#include "../include/tumble_sim.h"
+
+using namespace std;
+
+#define DEG_TO_RAD 3.141592653589793238463/180
+#define RAD_TO_DEGREES 180/3.141592653589793238463
+
+// simulates a tumbling CubeSat and writes the ICM-20602 outputs it would
+// see, with the truth attitude, as a CSV recording (loadImuRecording reads
+// it back, gainSweep and regression replay it) or as a flight log of raw
+// register values. Hours of data take seconds.
+
+static void usage(const char* name)
+{
+	printf("usage: %s <out.csv | out.log> [options]\n"
+		"  --seconds s                  length (default 600)\n"
+		"  --rate hz                    sample rate (default 100)\n"
+		"  --inertia xx,yy,zz[,xy,xz,yz]  kg m^2 (default 3U CubeSat)\n"
+		"  --spin x,y,z                 initial body rate, deg/s (default 6,-4,7)\n"
+		"  --rpy r,p,y                  initial attitude, deg (default 0,0,0)\n"
+		"  --gravity g                  1 on a ground test, 0 in orbit (default 1)\n"
+		"  --offset x,y,z               sensor position from the centre of mass, m\n"
+		"  --gyro-fsr dps               250, 500, 1000 or 2000 (default 1000)\n"
+		"  --accel-fsr g                2, 4, 8 or 16 (default 2)\n"
+		"  --gyro-noise dps/rtHz        (default 0.004)\n"
+		"  --accel-noise ug/rtHz        (default 100)\n"
+		"  --gyro-bias dps              bias instability, 1 sigma (default 0.005)\n"
+		"  --gyro-offset x,y,z          constant gyro bias, deg/s\n"
+		"  --seed n\n"
+		"flight logs hold the raw registers only; use CSV for the truth\n", name);
+}
+
+static bool parseVector(const char* arg, double* v, int min, int max)
+{
+	int n = sscanf(arg, "%lf,%lf,%lf,%lf,%lf,%lf", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+	return n >= min && n <= max;
+}
+
+// the AFS_SEL / FS_SEL register field of a full scale range
+static uint8_t rangeField(double full_scale, double smallest)
+{
+	uint8_t field = 0;
+	while (field < 3 && full_scale > smallest * (1 << field) + 0.5) field++;
+	return field << 3;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	TumbleConfig config;
+	initTumbleConfig(config);
+	double seconds = 600;
+	for (int i = 2; i < argc; i++)
+	{
+		const char* opt = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : 0;
+		double v[6] = { 0 };
+		bool ok = val != 0;
+		if (ok && !strcmp(opt, "--seconds")) seconds = atof(val);
+		else if (ok && !strcmp(opt, "--rate")) config.sample_hz = atof(val);
+		else if (ok && !strcmp(opt, "--inertia") && (ok = parseVector(val, v, 3, 6)))
+		{
+			for (int k = 0; k < 3; k++) config.inertia[k][k] = v[k];
+			config.inertia[0][1] = config.inertia[1][0] = v[3];
+			config.inertia[0][2] = config.inertia[2][0] = v[4];
+			config.inertia[1][2] = config.inertia[2][1] = v[5];
+		}
+		else if (ok && !strcmp(opt, "--spin") && (ok = parseVector(val, v, 3, 3)))
+			for (int k = 0; k < 3; k++) config.rate[k] = v[k] * DEG_TO_RAD;
+		else if (ok && !strcmp(opt, "--rpy") && (ok = parseVector(val, v, 3, 3)))
+		{
+			// ZYX: yaw, then pitch, then roll
+			double cr = cos(v[0] * DEG_TO_RAD / 2), sr = sin(v[0] * DEG_TO_RAD / 2);
+			double cp = cos(v[1] * DEG_TO_RAD / 2), sp = sin(v[1] * DEG_TO_RAD / 2);
+			double cy = cos(v[2] * DEG_TO_RAD / 2), sy = sin(v[2] * DEG_TO_RAD / 2);
+			config.q[0] = cr * cp * cy + sr * sp * sy;
+			config.q[1] = sr * cp * cy - cr * sp * sy;
+			config.q[2] = cr * sp * cy + sr * cp * sy;
+			config.q[3] = cr * cp * sy - sr * sp * cy;
+		}
+		else if (ok && !strcmp(opt, "--gravity")) config.gravity = atof(val);
+		else if (ok && !strcmp(opt, "--offset") && (ok = parseVector(val, v, 3, 3)))
+			for (int k = 0; k < 3; k++) config.offset[k] = v[k];
+		else if (ok && !strcmp(opt, "--gyro-fsr")) config.gyro.full_scale = atof(val) * DEG_TO_RAD;
+		else if (ok && !strcmp(opt, "--accel-fsr")) config.accel.full_scale = atof(val);
+		else if (ok && !strcmp(opt, "--gyro-noise")) config.gyro.noise_density = atof(val) * DEG_TO_RAD;
+		else if (ok && !strcmp(opt, "--accel-noise")) config.accel.noise_density = atof(val) * 1e-6;
+		else if (ok && !strcmp(opt, "--gyro-bias")) config.gyro.bias_instability = atof(val) * DEG_TO_RAD;
+		else if (ok && !strcmp(opt, "--gyro-offset") && (ok = parseVector(val, v, 3, 3)))
+			for (int k = 0; k < 3; k++) config.gyro.offset[k] = v[k] * DEG_TO_RAD;
+		else if (ok && !strcmp(opt, "--seed")) config.seed = strtoull(val, 0, 10);
+		else ok = false;
+		if (!ok)
+		{
+			printf("bad option %s\n", opt);
+			usage(argv[0]);
+			return 1;
+		}
+		i++;
+	}
+
+	const char* path = argv[1];
+	size_t len = strlen(path);
+	bool flight_log = len > 4 && !strcmp(path + len - 4, ".log");
+	uint64_t n = (uint64_t)(seconds * config.sample_hz);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	TumbleSim sim(config);
+	TumbleSample s;
+	uint64_t saturated = 0;
+	bool ok;
+	if (flight_log)
+	{
+		FlightLogHeader header;
+		initFlightLogHeader(header);
+		header.gyro_config = rangeField(config.gyro.full_scale * RAD_TO_DEGREES, 250);
+		header.accel_config = rangeField(config.accel.full_scale, 2);
+		header.accel_scale = config.accel.full_scale / config.accel.counts;
+		header.gyro_scale = config.gyro.full_scale * RAD_TO_DEGREES / config.gyro.counts;
+		header.temp_scale = 1 / 326.8;
+		header.temp_offset = 25;
+		FlightLogWriter log;
+		ok = log.open(path, header);
+		FlightLogRecord record;
+		memset(&record, 0, sizeof(record));
+		for (uint64_t i = 0; ok && i < n; i++)
+		{
+			sim.next(s);
+			saturated += s.saturated;
+			record.t_ns = (uint64_t)llround(s.t * 1e9);
+			memcpy(record.accel, s.accel_raw, sizeof(record.accel));
+			memcpy(record.gyro, s.gyro_raw, sizeof(record.gyro));
+			ok = log.appendWaiting(record);	// wait for the writer rather than drop records
+		}
+		ok = log.close() && ok;
+	}
+	else
+	{
+		TextWriter out;
+		ok = out.open(path);
+		out.put("Time,Accel X,Accel Y,Accel Z,Gyro X,Gyro Y,Gyro Z,Truth Q0,Truth Q1,Truth Q2,Truth Q3\n");
+		for (uint64_t i = 0; ok && i < n; i++)
+		{
+			sim.next(s);
+			saturated += s.saturated;
+			out.put(s.t);
+			for (int k = 0; k < 3; k++)
+			{
+				out.put(',');
+				out.put(s.accel[k]);
+			}
+			// deg/s, like our own recordings
+			for (int k = 0; k < 3; k++)
+			{
+				out.put(',');
+				out.put((float)(s.gyro_raw[k] * (config.gyro.full_scale * RAD_TO_DEGREES / config.gyro.counts)));
+			}
+			for (int k = 0; k < 4; k++)
+			{
+				out.put(',');
+				out.put(s.q[k]);
+			}
+			out.put('\n');
+		}
+		ok = out.close() && ok;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (!ok)
+	{
+		printf("error writing %s\n", path);
+		return 1;
+	}
+	double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+	printf("%llu samples (%.0f s simulated) in %.2f s, %llu saturated\n",
+		(unsigned long long)n, n / config.sample_hz, elapsed, (unsigned long long)saturated);
+	return 0;
+}
@@ -0,0 +1,205 @@
+#include <math.h>
+#include <string.h>
+#include "../include/flight_log.h"
+#include "../include/tumble_sim.h"
+
+#define STANDARD_GRAVITY 9.80665
+#define DEG_TO_RAD (M_PI / 180)
+
+double GaussianNoise::gauss(double sigma)
+{
+  if (has_spare_)
+  {
+    has_spare_ = false;
+    return spare_ * sigma;
+  }
+  double r = sqrt(-2 * log(uniform())), a = 2 * M_PI * uniform();
+  spare_ = r * sin(a);
+  has_spare_ = true;
+  return r * cos(a) * sigma;
+}
+
+void initTumbleConfig(TumbleConfig& config)
+{
+  memset(&config, 0, sizeof(config));
+  // 4 kg 3U: 10 x 10 x 34 cm
+  config.inertia[0][0] = 0.0418;
+  config.inertia[1][1] = 0.0418;
+  config.inertia[2][2] = 0.0067;
+  config.rate[0] = 6 * DEG_TO_RAD;
+  config.rate[1] = -4 * DEG_TO_RAD;
+  config.rate[2] = 7 * DEG_TO_RAD;
+  config.q[0] = 1;
+  config.gravity = 1;
+  config.sample_hz = 100;
+  config.substeps = 4;
+
+  // ICM-20602: 0.004 dps/rtHz, 100 ug/rtHz
+  config.gyro.noise_density = 0.004 * DEG_TO_RAD;
+  config.gyro.bias_instability = 0.005 * DEG_TO_RAD;
+  config.gyro.bias_tau = 300;
+  config.gyro.full_scale = 1000 * DEG_TO_RAD;
+  config.gyro.counts = FLIGHT_LOG_GYRO_COUNTS;
+  config.accel.noise_density = 100e-6;
+  config.accel.bias_instability = 50e-6;
+  config.accel.bias_tau = 300;
+  config.accel.full_scale = 2;
+  config.accel.counts = FLIGHT_LOG_ACCEL_COUNTS;
+  config.seed = 1;
+}
+
+static void invert3(const double m[3][3], double out[3][3])
+{
+  double c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+  double c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+  double c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+  double det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+  double k = det != 0 ? 1 / det : 0;
+  out[0][0] = c00 * k;
+  out[1][0] = c01 * k;
+  out[2][0] = c02 * k;
+  out[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * k;
+  out[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * k;
+  out[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * k;
+  out[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * k;
+  out[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * k;
+  out[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * k;
+}
+
+static inline void cross(const double a[3], const double b[3], double out[3])
+{
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static inline void multiply(const double m[3][3], const double v[3], double out[3])
+{
+  for (int i = 0; i < 3; i++) out[i] = m[i][0] * v[0] + m[i][1] * v[1] + m[i][2] * v[2];
+}
+
+TumbleSim::TumbleSim(const TumbleConfig& config) :
+    config_(config), noise_(config.seed), count_(0)
+{
+  if (config_.sample_hz <= 0) config_.sample_hz = 100;
+  if (config_.substeps == 0) config_.substeps = 1;
+  invert3(config_.inertia, inverse_);
+
+  double n = sqrt(config.q[0] * config.q[0] + config.q[1] * config.q[1] +
+                  config.q[2] * config.q[2] + config.q[3] * config.q[3]);
+  for (int i = 0; i < 4; i++) state_[i] = n > 0 ? config.q[i] / n : (i == 0);
+  for (int i = 0; i < 3; i++) state_[4 + i] = config.rate[i];
+
+  // the wandering biases start from their stationary distribution
+  for (int i = 0; i < 3; i++)
+  {
+    gyro_bias_[i] = noise_.gauss(config_.gyro.bias_instability);
+    accel_bias_[i] = noise_.gauss(config_.accel.bias_instability);
+  }
+}
+
+// d/dt of (q, w): q' = q (x) (0, w) / 2, I w' = -w x I w
+void TumbleSim::derivative(const double s[7], double out[7]) const
+{
+  const double* w = s + 4;
+  out[0] = 0.5 * (-s[1] * w[0] - s[2] * w[1] - s[3] * w[2]);
+  out[1] = 0.5 * (s[0] * w[0] + s[2] * w[2] - s[3] * w[1]);
+  out[2] = 0.5 * (s[0] * w[1] + s[3] * w[0] - s[1] * w[2]);
+  out[3] = 0.5 * (s[0] * w[2] + s[1] * w[1] - s[2] * w[0]);
+
+  double h[3], torque[3];
+  multiply(config_.inertia, w, h);
+  cross(w, h, torque);
+  for (int i = 0; i < 3; i++) torque[i] = -torque[i];
+  multiply(inverse_, torque, out + 4);
+}
+
+void TumbleSim::step(double h)
+{
+  double k1[7], k2[7], k3[7], k4[7], s[7];
+  derivative(state_, k1);
+  for (int i = 0; i < 7; i++) s[i] = state_[i] + 0.5 * h * k1[i];
+  derivative(s, k2);
+  for (int i = 0; i < 7; i++) s[i] = state_[i] + 0.5 * h * k2[i];
+  derivative(s, k3);
+  for (int i = 0; i < 7; i++) s[i] = state_[i] + h * k3[i];
+  derivative(s, k4);
+  for (int i = 0; i < 7; i++) state_[i] += h / 6 * (k1[i] + 2 * k2[i] + 2 * k3[i] + k4[i]);
+
+  double n = sqrt(state_[0] * state_[0] + state_[1] * state_[1] +
+                  state_[2] * state_[2] + state_[3] * state_[3]);
+  for (int i = 0; i < 4; i++) state_[i] /= n;
+}
+
+// value plus bias and noise, quantized and saturated like the registers
+void TumbleSim::sense(const double value[3], const SensorModel& model, double bias[3],
+                      int16_t raw[3], float out[3], bool& saturated)
+{
+  double dt = 1 / config_.sample_hz;
+  double sigma = model.noise_density * sqrt(config_.sample_hz / 2);
+  double decay = model.bias_tau > 0 ? exp(-dt / model.bias_tau) : 0;
+  double drive = model.bias_instability * sqrt(1 - decay * decay);
+  double lsb = model.full_scale > 0 ? model.full_scale / model.counts : 1;
+  for (int i = 0; i < 3; i++)
+  {
+    double v = (value[i] + model.offset[i] + bias[i] + noise_.gauss(sigma)) / lsb;
+    bias[i] = bias[i] * decay + noise_.gauss(drive);
+    long r = lround(v);
+    if (r > 32767 || r < -32768 || v != v)
+    {
+      r = v > 0 ? 32767 : -32768;
+      saturated = true;
+    }
+    raw[i] = (int16_t)r;
+    out[i] = (float)(r * lsb);
+  }
+}
+
+void TumbleSim::next(TumbleSample& sample)
+{
+  const double* q = state_;
+  const double* w = state_ + 4;
+  sample.t = count_ / config_.sample_hz;
+  for (int i = 0; i < 4; i++) sample.q[i] = q[i];
+  for (int i = 0; i < 3; i++) sample.rate[i] = w[i];
+
+  // specific force in the body frame: the reaction to gravity, rotated
+  // from world +Z, and the lever arm w' x r + w x (w x r)
+  double f[3], d[7], a[3], wr[3], c[3];
+  f[0] = 2 * (q[1] * q[3] - q[0] * q[2]) * config_.gravity;
+  f[1] = 2 * (q[2] * q[3] + q[0] * q[1]) * config_.gravity;
+  f[2] = (q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3]) * config_.gravity;
+  derivative(state_, d);
+  cross(d + 4, config_.offset, a);
+  cross(w, config_.offset, wr);
+  cross(w, wr, c);
+  for (int i = 0; i < 3; i++) f[i] += (a[i] + c[i]) / STANDARD_GRAVITY;
+
+  sample.saturated = false;
+  sense(w, config_.gyro, gyro_bias_, sample.gyro_raw, sample.gyro, sample.saturated);
+  sense(f, config_.accel, accel_bias_, sample.accel_raw, sample.accel, sample.saturated);
+
+  double h = 1 / (config_.sample_hz * config_.substeps);
+  for (unsigned k = 0; k < config_.substeps; k++) step(h);
+  count_++;
+}
+
+void TumbleSim::generate(size_t n, ImuRecording& rec)
+{
+  TumbleSample s;
+  for (size_t i = 0; i < n; i++)
+  {
+    next(s);
+    rec.t.push_back(s.t);
+    rec.ax.push_back(s.accel[0]);
+    rec.ay.push_back(s.accel[1]);
+    rec.az.push_back(s.accel[2]);
+    rec.gx.push_back(s.gyro[0]);
+    rec.gy.push_back(s.gyro[1]);
+    rec.gz.push_back(s.gyro[2]);
+    rec.q0.push_back(s.q[0]);
+    rec.q1.push_back(s.q[1]);
+    rec.q2.push_back(s.q[2]);
+    rec.q3.push_back(s.q[3]);
+  }
+}
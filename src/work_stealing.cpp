@@ -0,0 +1,95 @@
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../include/work_stealing.h"
+
+namespace
+{
+
+// Remaining slice of one worker. Padded to its own cache line so that the
+// owner taking tasks does not invalidate its neighbours' slices.
+struct alignas(64) Slice
+{
+  std::mutex lock;
+  size_t begin;
+  size_t end;
+};
+
+bool takeOwn(Slice& s, size_t& i)
+{
+  std::lock_guard<std::mutex> guard(s.lock);
+  if (s.begin >= s.end) return false;
+  i = s.begin++;
+  return true;
+}
+
+// Moves the back half of victim's slice into thief's slice.
+bool steal(Slice& victim, Slice& thief)
+{
+  size_t begin, end;
+  {
+    std::lock_guard<std::mutex> guard(victim.lock);
+    size_t left = victim.end - victim.begin;
+    if (victim.begin >= victim.end) return false;
+    end = victim.end;
+    begin = victim.end - (left + 1) / 2;
+    victim.end = begin;
+  }
+  std::lock_guard<std::mutex> guard(thief.lock);
+  thief.begin = begin;
+  thief.end = end;
+  return true;
+}
+
+void worker(std::vector<Slice>& slices, unsigned self,
+            const std::function<void(size_t)>& task)
+{
+  unsigned n = (unsigned)slices.size();
+  for (;;)
+  {
+    size_t i;
+    while (takeOwn(slices[self], i)) task(i);
+
+    // pick the victim with the most work left; tasks never spawn new tasks,
+    // so once every slice is empty the whole range has been handed out
+    unsigned victim = self;
+    size_t most = 0;
+    for (unsigned k = 1; k < n; k++)
+    {
+      unsigned v = (self + k) % n;
+      std::lock_guard<std::mutex> guard(slices[v].lock);
+      size_t left = slices[v].end > slices[v].begin ? slices[v].end - slices[v].begin : 0;
+      if (left > most) { most = left; victim = v; }
+    }
+    if (victim == self) return;
+    steal(slices[victim], slices[self]);
+  }
+}
+
+} // namespace
+
+unsigned defaultThreadCount()
+{
+  unsigned n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+void parallelFor(size_t count, unsigned threads,
+                 const std::function<void(size_t)>& task)
+{
+  if (threads == 0) threads = defaultThreadCount();
+  if (threads > count) threads = count ? (unsigned)count : 1;
+
+  std::vector<Slice> slices(threads);
+  for (unsigned w = 0; w < threads; w++)
+  {
+    slices[w].begin = count * w / threads;
+    slices[w].end = count * (w + 1) / threads;
+  }
+
+  std::vector<std::thread> pool;
+  for (unsigned w = 1; w < threads; w++)
+    pool.push_back(std::thread(worker, std::ref(slices), w, std::cref(task)));
+  worker(slices, 0, task);
+  for (size_t w = 0; w < pool.size(); w++) pool[w].join();
+}